@@ -0,0 +1,153 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// checked first, so allocations outside of a measurement never write the shared counter
+static std::atomic<bool> counting{ false };
+static std::atomic<uint64_t> allocationCount{ 0 };
+static thread_local uint32_t ignoreDepth = 0;
+
+static void count()
+{
+    if (counting.load(std::memory_order_relaxed) && ignoreDepth == 0) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+static void* allocate(std::size_t size)
+{
+    count();
+    return std::malloc(size > 0 ? size : 1);
+}
+
+static void* allocateAligned(std::size_t size, std::size_t alignment)
+{
+    count();
+#ifdef _WIN32
+    return _aligned_malloc(size > 0 ? size : 1, alignment);
+#else
+    // aligned_alloc wants a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+static void freeAligned(void* pointer)
+{
+#ifdef _WIN32
+    _aligned_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+
+void AllocationCounter::start()
+{
+    allocationCount = 0;
+    counting = true;
+}
+
+uint64_t AllocationCounter::stop()
+{
+    counting = false;
+    return allocationCount.load();
+}
+
+AllocationCounter::Ignore::Ignore()
+{
+    ignoreDepth++;
+}
+
+AllocationCounter::Ignore::~Ignore()
+{
+    ignoreDepth--;
+}
+
+void* operator new(std::size_t size)
+{
+    void* pointer = allocate(size);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    void* pointer = allocateAligned(size, (std::size_t)alignment);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, (std::size_t)alignment);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, (std::size_t)alignment);
+}
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    freeAligned(pointer);
+}
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+    freeAligned(pointer);
+}
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept
+{
+    freeAligned(pointer);
+}
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept
+{
+    freeAligned(pointer);
+}
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    freeAligned(pointer);
+}
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    freeAligned(pointer);
+}
\ No newline at end of file
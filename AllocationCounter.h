@@ -0,0 +1,20 @@
+#include <cstdint>
+
+#pragma once
+// Counts calls to the global operator new on every thread while counting is on. This file's translation unit replaces
+// the global operators new and delete; malloc from C code, like the Vulkan loader and drivers, is not seen.
+class AllocationCounter
+{
+public:
+	static void start();
+	// stops counting and returns the allocations since start
+	static uint64_t stop();
+	// Leaves the calling thread's allocations uncounted while it lives, for calls into code that allocates on its
+	// own behalf, like a driver compiling a pipeline.
+	class Ignore
+	{
+	public:
+		Ignore();
+		~Ignore();
+	};
+};
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+#include "VertexInput.h"
+#include <cstdint>
+
+// Skeleton of an animated stick figure: the hip is the root, every other joint ends one bone, see PoseEvaluator.h.
+enum class Joint : uint32_t {
+    Hip,
+    Neck,
+    LeftElbow,
+    LeftHand,
+    RightElbow,
+    RightHand,
+    LeftKnee,
+    LeftFoot,
+    RightKnee,
+    RightFoot,
+    Count
+};
+const uint32_t SKELETON_JOINT_COUNT = (uint32_t)Joint::Count;
+// bone b ends at joint b + 1
+const uint32_t SKELETON_BONE_COUNT = SKELETON_JOINT_COUNT - 1;
+// head circle as a line list plus one line per bone, see shaders/animatedfigure.vert
+const uint32_t ANIMATED_FIGURE_HEAD_SEGMENTS = 12;
+const uint32_t ANIMATED_FIGURE_VERTEX_COUNT = ANIMATED_FIGURE_HEAD_SEGMENTS * 2 + SKELETON_BONE_COUNT * 2;
+
+// One figure with its joints already placed on screen by PoseEvaluator; all of its vertices read the same instance.
+struct AnimatedFigureInstance {
+    float joints[SKELETON_JOINT_COUNT][2];
+    float headRadius;
+    // RGBA8, red in the lowest byte
+    uint32_t color;
+};
+template <>
+struct VertexLayout<AnimatedFigureInstance> {
+    static constexpr VkVertexInputBindingDescription binding = { 0, sizeof(AnimatedFigureInstance), VK_VERTEX_INPUT_RATE_INSTANCE };
+    // two joints per attribute
+    static constexpr VkVertexInputAttributeDescription attributes[] = {
+        { 0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(AnimatedFigureInstance, joints[0]) },
+        { 1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(AnimatedFigureInstance, joints[2]) },
+        { 2, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(AnimatedFigureInstance, joints[4]) },
+        { 3, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(AnimatedFigureInstance, joints[6]) },
+        { 4, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(AnimatedFigureInstance, joints[8]) },
+        { 5, 0, VK_FORMAT_R32_SFLOAT, offsetof(AnimatedFigureInstance, headRadius) },
+        { 6, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(AnimatedFigureInstance, color) },
+    };
+};
\ No newline at end of file
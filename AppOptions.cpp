@@ -0,0 +1,125 @@
+#include "AppOptions.h"
+#include <stdexcept>
+#include <string>
+
+static uint32_t parseCount(int argc, char** argv, int& argIndex)
+{
+    if (argIndex + 1 >= argc) {
+        std::string exceptionString = "missing value for ";
+        exceptionString.append(argv[argIndex]);
+        throw std::runtime_error(exceptionString);
+    }
+    argIndex++;
+    return (uint32_t)std::stoul(argv[argIndex]);
+}
+
+AppOptions parseOptions(int argc, char** argv)
+{
+    AppOptions options{};
+#ifdef NDEBUG
+    options.enableValidationLayers = false;
+#else
+    options.enableValidationLayers = true;
+#endif
+
+    for (int argIndex = 1; argIndex < argc; argIndex++) {
+        std::string arg = argv[argIndex];
+        if (arg == "--headless") {
+            options.headless = true;
+        }
+        else if (arg == "--no-validation") {
+            options.enableValidationLayers = false;
+        }
+        else if (arg == "--frames") {
+            options.frameLimit = parseCount(argc, argv, argIndex);
+        }
+        else if (arg == "--warmup") {
+            options.warmupFrames = parseCount(argc, argv, argIndex);
+        }
+        else if (arg == "--pipeline-cache") {
+            if (argIndex + 1 >= argc) {
+                throw std::runtime_error("missing value for --pipeline-cache");
+            }
+            options.pipelineCachePath = argv[++argIndex];
+        }
+        else if (arg == "--cold-pipeline-cache") {
+            options.coldPipelineCache = true;
+        }
+        else if (arg == "--threads") {
+            options.threadCount = parseCount(argc, argv, argIndex);
+        }
+        else if (arg == "--figures") {
+            options.figureCount = parseCount(argc, argv, argIndex);
+        }
+        else if (arg == "--animated-figures") {
+            options.animatedFigureCount = parseCount(argc, argv, argIndex);
+        }
+        else if (arg == "--collisions") {
+            options.collisions = true;
+        }
+        else if (arg == "--limb-width") {
+            options.limbWidth = parseCount(argc, argv, argIndex);
+        }
+        else if (arg == "--simulate") {
+            options.simulate = true;
+        }
+        else if (arg == "--tick-rate") {
+            options.tickRate = parseCount(argc, argv, argIndex);
+            if (options.tickRate == 0) {
+                throw std::runtime_error("--tick-rate has to be at least 1");
+            }
+        }
+        else if (arg == "--hot-reload") {
+            options.hotReload = true;
+        }
+        else if (arg == "--trace") {
+            if (argIndex + 1 >= argc) {
+                throw std::runtime_error("missing value for --trace");
+            }
+            options.tracePath = argv[++argIndex];
+        }
+        else if (arg == "--stats") {
+            if (argIndex + 1 >= argc) {
+                throw std::runtime_error("missing value for --stats");
+            }
+            options.statsPath = argv[++argIndex];
+        }
+        else if (arg == "--pacing") {
+            if (argIndex + 1 >= argc || !parsePacingPreset(argv[argIndex + 1], options.pacing)) {
+                throw std::runtime_error("--pacing needs gameplay or battery");
+            }
+            argIndex++;
+        }
+        else if (arg == "--present-mode") {
+            if (argIndex + 1 >= argc || !parsePresentMode(argv[argIndex + 1], options.pacing.presentMode)) {
+                throw std::runtime_error("--present-mode needs immediate, mailbox, fifo or fifo_relaxed");
+            }
+            argIndex++;
+        }
+        else if (arg == "--frames-in-flight") {
+            options.pacing.framesInFlight = parseCount(argc, argv, argIndex);
+            if (options.pacing.framesInFlight < 1 || options.pacing.framesInFlight > FramePacer::MAX_FRAMES_IN_FLIGHT) {
+                throw std::runtime_error("--frames-in-flight must be between 1 and " + std::to_string(FramePacer::MAX_FRAMES_IN_FLIGHT));
+            }
+        }
+        else if (arg == "--fps-limit") {
+            options.pacing.frameRateLimit = parseCount(argc, argv, argIndex);
+        }
+        else if (arg == "--bench") {
+            if (argIndex + 1 >= argc) {
+                throw std::runtime_error("missing value for --bench");
+            }
+            options.benchmark = argv[++argIndex];
+        }
+        else {
+            std::string exceptionString = "unknown option ";
+            exceptionString.append(arg);
+            throw std::runtime_error(exceptionString);
+        }
+    }
+    // Headless runs have no window to close, so they always stop after a fixed number of frames.
+    if (options.headless && options.frameLimit == 0) {
+        options.frameLimit = 1000;
+    }
+    return options;
+}
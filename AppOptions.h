@@ -0,0 +1,33 @@
+#include <cstdint>
+#include <string>
+#include "FramePacer.h"
+
+#pragma once
+struct AppOptions {
+	bool headless = false;
+	bool enableValidationLayers;
+	uint32_t frameLimit = 0;
+	uint32_t warmupFrames = 10;
+	std::string pipelineCachePath = "pipeline_cache.bin";
+	bool coldPipelineCache = false;
+	uint32_t threadCount = 0;
+	uint32_t figureCount = 0;
+	// stick figures walking in place, posed on the CPU every frame
+	uint32_t animatedFigureCount = 0;
+	// collide the animated figures with each other and the world every frame and draw the contacts
+	bool collisions = false;
+	// draw the animated figures' limbs this many pixels wide with the segment batcher, 0 for one pixel line lists
+	uint32_t limbWidth = 0;
+	// move the --figures figures from a simulation thread ticking tickRate times a second
+	bool simulate = false;
+	uint32_t tickRate = 60;
+	std::string benchmark;
+	// recompile shaders/ when it changes and swap the affected pipelines in while running
+	bool hotReload = false;
+	PacingSettings pacing;
+	// Chrome trace JSON of the GPU and CPU profiler scopes, written at exit; empty for no trace
+	std::string tracePath;
+	// turns the hot path counters on, prints them every second and writes them as JSON here at exit; empty for off
+	std::string statsPath;
+};
+AppOptions parseOptions(int argc, char** argv);
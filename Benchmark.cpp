@@ -0,0 +1,159 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <numeric>
+#include <iomanip>
+#include <cmath>
+
+SampleSeries::SampleSeries(const std::string name)
+{
+    this->name = name;
+}
+
+void SampleSeries::addSample(double value)
+{
+    this->samples.push_back(value);
+}
+
+void SampleSeries::clear()
+{
+    this->samples.clear();
+}
+
+size_t SampleSeries::size() const
+{
+    return this->samples.size();
+}
+
+double SampleSeries::percentile(double fraction) const
+{
+    if (this->samples.empty()) {
+        return 0.0;
+    }
+    std::vector<double> sorted = this->samples;
+    std::sort(sorted.begin(), sorted.end());
+    // nearest-rank percentile
+    size_t rank = (size_t)std::ceil(fraction * sorted.size());
+    if (rank > 0) {
+        rank--;
+    }
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+double SampleSeries::mean() const
+{
+    if (this->samples.empty()) {
+        return 0.0;
+    }
+    return std::accumulate(this->samples.begin(), this->samples.end(), 0.0) / this->samples.size();
+}
+
+double SampleSeries::max() const
+{
+    if (this->samples.empty()) {
+        return 0.0;
+    }
+    return *std::max_element(this->samples.begin(), this->samples.end());
+}
+
+void SampleSeries::report(std::ostream& out, const char* unit) const
+{
+    out << std::fixed << std::setprecision(3)
+        << this->name << " (" << unit << ", " << this->samples.size() << " samples):"
+        << " mean " << this->mean()
+        << " p50 " << this->percentile(0.50)
+        << " p99 " << this->percentile(0.99)
+        << " max " << this->max()
+        << '\n';
+    out << std::defaultfloat;
+}
+
+
+RollingHistogram::RollingHistogram(const std::string name, double bucketWidth, size_t bucketCount, size_t windowSize)
+{
+    this->name = name;
+    this->bucketWidth = bucketWidth;
+    // the last bucket collects everything from bucketCount * bucketWidth up
+    this->buckets.assign(bucketCount + 1, 0);
+    this->window.assign(std::max<size_t>(windowSize, 1), 0.0);
+}
+
+size_t RollingHistogram::bucketOf(double value) const
+{
+    if (value <= 0.0) {
+        return 0;
+    }
+    return std::min((size_t)(value / this->bucketWidth), this->buckets.size() - 1);
+}
+
+void RollingHistogram::addSample(double value)
+{
+    if (this->sampleCount == this->window.size()) {
+        this->buckets[this->bucketOf(this->window[this->nextSample])]--;
+    }
+    else {
+        this->sampleCount++;
+    }
+    this->window[this->nextSample] = value;
+    this->buckets[this->bucketOf(value)]++;
+    this->nextSample = (this->nextSample + 1) % this->window.size();
+}
+
+void RollingHistogram::clear()
+{
+    std::fill(this->buckets.begin(), this->buckets.end(), 0);
+    // mean sums the whole window
+    std::fill(this->window.begin(), this->window.end(), 0.0);
+    this->nextSample = 0;
+    this->sampleCount = 0;
+}
+
+size_t RollingHistogram::size() const
+{
+    return this->sampleCount;
+}
+
+double RollingHistogram::percentile(double fraction) const
+{
+    if (this->sampleCount == 0) {
+        return 0.0;
+    }
+    size_t rank = std::max<size_t>((size_t)std::ceil(fraction * this->sampleCount), 1);
+    size_t seen = 0;
+    for (size_t bucket = 0; bucket < this->buckets.size(); bucket++) {
+        seen += this->buckets[bucket];
+        if (seen >= rank) {
+            return (bucket + 1) * this->bucketWidth;
+        }
+    }
+    return this->buckets.size() * this->bucketWidth;
+}
+
+double RollingHistogram::mean() const
+{
+    if (this->sampleCount == 0) {
+        return 0.0;
+    }
+    // samples outside the filled part of the window are still 0
+    return std::accumulate(this->window.begin(), this->window.end(), 0.0) / this->sampleCount;
+}
+
+void RollingHistogram::report(std::ostream& out, const char* unit) const
+{
+    const size_t barWidth = 40;
+    out << std::fixed << std::setprecision(3)
+        << this->name << " (" << unit << ", last " << this->sampleCount << " samples):"
+        << " mean " << this->mean()
+        << " p50 " << this->percentile(0.50)
+        << " p99 " << this->percentile(0.99)
+        << '\n';
+    uint32_t largest = *std::max_element(this->buckets.begin(), this->buckets.end());
+    for (size_t bucket = 0; bucket < this->buckets.size() && largest > 0; bucket++) {
+        if (this->buckets[bucket] == 0) {
+            continue;
+        }
+        out << "  " << std::setw(8) << bucket * this->bucketWidth << (bucket + 1 < this->buckets.size() ? "  " : "+ ")
+            << std::string((size_t)std::ceil((double)this->buckets[bucket] * barWidth / largest), '#')
+            << ' ' << this->buckets[bucket] << '\n';
+    }
+    out << std::defaultfloat;
+}
\ No newline at end of file
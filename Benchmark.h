@@ -0,0 +1,45 @@
+#include <string>
+#include <vector>
+#include <ostream>
+
+#pragma once
+class SampleSeries
+{
+private:
+	std::string name;
+	std::vector<double> samples;
+public:
+	SampleSeries(const std::string name);
+	void addSample(double value);
+	void clear();
+	size_t size() const;
+	double percentile(double fraction) const;
+	double mean() const;
+	double max() const;
+	void report(std::ostream& out, const char* unit) const;
+};
+
+// Histogram over the last windowSize samples with fixed-width buckets starting at 0 and one overflow bucket,
+// for series that run as long as the app does. Adding a sample never allocates.
+class RollingHistogram
+{
+private:
+	std::string name;
+	double bucketWidth;
+	std::vector<uint32_t> buckets;
+	std::vector<double> window;
+	size_t nextSample = 0;
+	size_t sampleCount = 0;
+
+	size_t bucketOf(double value) const;
+public:
+	RollingHistogram(const std::string name, double bucketWidth, size_t bucketCount, size_t windowSize);
+	void addSample(double value);
+	void clear();
+	size_t size() const;
+	// upper edge of the bucket holding the percentile, so at most one bucket width above the exact value
+	double percentile(double fraction) const;
+	double mean() const;
+	// summary line followed by one bar per non-empty bucket
+	void report(std::ostream& out, const char* unit) const;
+};
\ No newline at end of file
@@ -1,10 +1,15 @@
 #pragma once
 #include "VertexInput.h"
-struct CircleVertexInput:
-    public VertexInput
-{
-    VkVertexInputBindingDescription getBindingDescription();
-    std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
-    size_t getDataSize();
-};
+#include <cstdint>
 
+// The circle's only vertex data: its number of lines, read by every vertex through a stride of 0.
+struct CircleVertex {
+    int32_t lineCount;
+};
+template <>
+struct VertexLayout<CircleVertex> {
+    static constexpr VkVertexInputBindingDescription binding = { 0, 0, VK_VERTEX_INPUT_RATE_VERTEX };
+    static constexpr VkVertexInputAttributeDescription attributes[] = {
+        { 0, 0, VK_FORMAT_R32_SINT, offsetof(CircleVertex, lineCount) },
+    };
+};
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "CommandRecorder.h"
+#include "CreateCommandPool.h"
+#include <stdexcept>
+#include <algorithm>
+
+CommandRecorder::CommandRecorder(VkDevice device, uint32_t graphicsFamilyIndex, ThreadPool* threadPool, uint32_t framesInFlight, size_t maxChunkCount)
+{
+    this->device = device;
+    this->threadPool = threadPool;
+    this->maxChunkCount = std::max<size_t>(maxChunkCount, 1);
+    this->frames.resize(framesInFlight);
+
+    for (auto& chunks : this->frames) {
+        chunks.resize(this->maxChunkCount);
+        for (auto& chunk : chunks) {
+            createCommandPool(this->device, graphicsFamilyIndex, &chunk.commandPool, VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = chunk.commandPool;
+            allocInfo.level = VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(this->device, &allocInfo, &chunk.commandBuffer) != VkResult::VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate command buffers!");
+            }
+        }
+    }
+}
+
+CommandRecorder::~CommandRecorder()
+{
+    for (auto& chunks : this->frames) {
+        for (auto& chunk : chunks) {
+            vkDestroyCommandPool(this->device, chunk.commandPool, nullptr);
+        }
+    }
+}
+
+size_t CommandRecorder::getMaxChunkCount()
+{
+    return this->maxChunkCount;
+}
+
+size_t CommandRecorder::record(uint32_t frameIndex, PipelineManager* pipelineManager, VkExtent2D extent, size_t drawCount, const DrawCommand* draws, size_t chunkCount, VkCommandBuffer* secondaries, const GpuScopeTarget& scopes)
+{
+    if (drawCount == 0) {
+        return 0;
+    }
+    chunkCount = std::min({ chunkCount, this->maxChunkCount, (drawCount + MIN_DRAWS_PER_CHUNK - 1) / MIN_DRAWS_PER_CHUNK });
+    chunkCount = std::max<size_t>(chunkCount, 1);
+    std::vector<ChunkCommands>& chunks = this->frames[frameIndex];
+
+    auto recordChunk = [&](size_t chunkIndex) {
+        size_t firstDraw = drawCount * chunkIndex / chunkCount;
+        size_t lastDraw = drawCount * (chunkIndex + 1) / chunkCount;
+        ChunkCommands& chunk = chunks[chunkIndex];
+
+        if (vkResetCommandPool(this->device, chunk.commandPool, 0) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to reset command pool!");
+        }
+        pipelineManager->beginSecondary(chunk.commandBuffer, VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        pipelineManager->writeCommands(chunk.commandBuffer, extent, lastDraw - firstDraw, draws + firstDraw, scopes);
+        if (vkEndCommandBuffer(chunk.commandBuffer) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+    };
+    if (chunkCount > 1 && this->threadPool) {
+        // a std::function keeps a lambda holding one reference in place, one with all of recordChunk's captures
+        // would be allocated on every frame
+        this->threadPool->parallelFor(chunkCount, [&recordChunk](size_t chunkIndex) { recordChunk(chunkIndex); });
+    }
+    else {
+        for (size_t chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++) {
+            recordChunk(chunkIndex);
+        }
+    }
+
+    // executed in chunk order, so the draws keep their order
+    for (size_t chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++) {
+        secondaries[chunkIndex] = chunks[chunkIndex].commandBuffer;
+    }
+    return chunkCount;
+}
@@ -0,0 +1,31 @@
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "PipelineManager.h"
+#include "ThreadPool.h"
+
+#pragma once
+// Records a draw list into several secondary command buffers in parallel on the thread pool.
+// Every chunk of the list has its own command pool per frame in flight, so no pool is ever touched by two threads at once.
+class CommandRecorder
+{
+private:
+	struct ChunkCommands {
+		VkCommandPool commandPool;
+		VkCommandBuffer commandBuffer;
+	};
+	VkDevice device;
+	ThreadPool* threadPool;
+	size_t maxChunkCount;
+	// frames[frameIndex][chunkIndex]
+	std::vector<std::vector<ChunkCommands>> frames;
+public:
+	// draws below this count stay in one chunk, splitting them costs more than it saves
+	static const size_t MIN_DRAWS_PER_CHUNK = 64;
+
+	CommandRecorder(VkDevice device, uint32_t graphicsFamilyIndex, ThreadPool* threadPool, uint32_t framesInFlight, size_t maxChunkCount);
+	~CommandRecorder();
+	size_t getMaxChunkCount();
+	// Records the draws in order into at most chunkCount secondaries and writes them to secondaries, returns how many were used.
+	// The frame's previous submit must have completed. Every chunk writes its own GPU scopes into scopes.
+	size_t record(uint32_t frameIndex, PipelineManager* pipelineManager, VkExtent2D extent, size_t drawCount, const DrawCommand* draws, size_t chunkCount, VkCommandBuffer* secondaries, const GpuScopeTarget& scopes = GpuScopeTarget());
+};
@@ -0,0 +1,107 @@
+#include "Counters.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+bool Counters::enabled = false;
+std::atomic<Counters::ThreadCounters*> Counters::threads{ nullptr };
+
+static const char* COUNTER_NAMES[] = {
+    "draws",
+    "pipeline binds",
+    "vertex buffer binds",
+    "uploaded bytes",
+    "vkAllocateMemory calls",
+    "fence waits",
+    "fence wait us",
+    "swapchain recreations",
+};
+static_assert(sizeof(COUNTER_NAMES) / sizeof(COUNTER_NAMES[0]) == Counters::COUNTER_COUNT, "every counter needs a name");
+
+Counters::ThreadCounters* Counters::registerThread()
+{
+    ThreadCounters* counters = new ThreadCounters();
+    for (auto& value : counters->values) {
+        value.store(0, std::memory_order_relaxed);
+    }
+    counters->next = threads.load(std::memory_order_relaxed);
+    while (!threads.compare_exchange_weak(counters->next, counters, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    return counters;
+}
+
+void Counters::setEnabled(bool enabled)
+{
+    Counters::enabled = enabled;
+}
+
+bool Counters::isEnabled()
+{
+    return enabled;
+}
+
+const char* Counters::getName(Counter counter)
+{
+    return COUNTER_NAMES[(size_t)counter];
+}
+
+void CounterStats::endFrame()
+{
+    if (!Counters::isEnabled()) {
+        return;
+    }
+    uint64_t newTotals[Counters::COUNTER_COUNT] = {};
+    for (Counters::ThreadCounters* counters = Counters::threads.load(std::memory_order_acquire); counters; counters = counters->next) {
+        for (size_t i = 0; i < Counters::COUNTER_COUNT; i++) {
+            newTotals[i] += counters->values[i].load(std::memory_order_relaxed);
+        }
+    }
+    for (size_t i = 0; i < Counters::COUNTER_COUNT; i++) {
+        this->frameValues[i] = newTotals[i] - this->totals[i];
+        this->maxFrameValues[i] = std::max(this->maxFrameValues[i], this->frameValues[i]);
+        this->totals[i] = newTotals[i];
+    }
+    this->frameCount++;
+}
+
+uint64_t CounterStats::getFrameValue(Counter counter) const
+{
+    return this->frameValues[(size_t)counter];
+}
+
+uint64_t CounterStats::getTotal(Counter counter) const
+{
+    return this->totals[(size_t)counter];
+}
+
+std::string CounterStats::takeIntervalLine()
+{
+    uint64_t frames = std::max<uint64_t>(this->frameCount - this->intervalStartFrame, 1);
+    std::ostringstream line;
+    line << "per frame:";
+    for (size_t i = 0; i < Counters::COUNTER_COUNT; i++) {
+        line << (i == 0 ? " " : ", ") << Counters::getName((Counter)i) << " " << (double)(this->totals[i] - this->intervalStart[i]) / frames;
+        this->intervalStart[i] = this->totals[i];
+    }
+    this->intervalStartFrame = this->frameCount;
+    return line.str();
+}
+
+void CounterStats::writeJson(const std::string& path) const
+{
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("failed to open stats file " + path + "!");
+    }
+    out << "{\n  \"frames\": " << this->frameCount << ",\n  \"counters\": {\n";
+    for (size_t i = 0; i < Counters::COUNTER_COUNT; i++) {
+        out << "    \"" << Counters::getName((Counter)i) << "\": { \"total\": " << this->totals[i]
+            << ", \"perFrameMean\": " << (this->frameCount > 0 ? (double)this->totals[i] / this->frameCount : 0.0)
+            << ", \"perFrameMax\": " << this->maxFrameValues[i] << " }"
+            << (i + 1 < Counters::COUNTER_COUNT ? ",\n" : "\n");
+    }
+    out << "  }\n}\n";
+    std::cout << "wrote counters of " << this->frameCount << " frames to " << path << "\n";
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <ostream>
+
+#pragma once
+enum class Counter : uint32_t {
+	Draws,
+	PipelineBinds,
+	VertexBufferBinds,
+	UploadedBytes,
+	DeviceAllocations,
+	FenceWaits,
+	FenceWaitMicroseconds,
+	SwapchainRecreations,
+	Count
+};
+// Event counters for the hot paths, off unless setEnabled(true) was called before the threads using them started.
+// Every thread adds to its own block of counters that only it writes, so adding is a plain relaxed load and store;
+// CounterStats merges all blocks once per frame by reading them, with no locks on either side.
+// Disabled, add costs one predictable branch.
+class Counters
+{
+public:
+	static const size_t COUNTER_COUNT = (size_t)Counter::Count;
+private:
+	struct ThreadCounters {
+		std::atomic<uint64_t> values[COUNTER_COUNT];
+		ThreadCounters* next;
+	};
+	static bool enabled;
+	// every thread's block, pushed once per thread and never removed, blocks outlive their threads
+	static std::atomic<ThreadCounters*> threads;
+	static ThreadCounters* registerThread();
+	static ThreadCounters* getThreadCounters() {
+		thread_local ThreadCounters* counters = registerThread();
+		return counters;
+	}
+	friend class CounterStats;
+public:
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+	static const char* getName(Counter counter);
+	static void add(Counter counter, uint64_t amount = 1) {
+		if (!enabled) {
+			return;
+		}
+		std::atomic<uint64_t>& value = getThreadCounters()->values[(size_t)counter];
+		value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
+};
+// Per-frame values of the counters, merged from every thread's block at the end of each frame.
+// Draws and binds count what was recorded, so the cached static commands count only in the frames that re-record them.
+class CounterStats
+{
+private:
+	uint64_t frameCount = 0;
+	uint64_t totals[Counters::COUNTER_COUNT] = {};
+	uint64_t frameValues[Counters::COUNTER_COUNT] = {};
+	uint64_t maxFrameValues[Counters::COUNTER_COUNT] = {};
+	// totals and frame count when the last line was printed
+	uint64_t intervalStart[Counters::COUNTER_COUNT] = {};
+	uint64_t intervalStartFrame = 0;
+public:
+	void endFrame();
+	uint64_t getFrameValue(Counter counter) const;
+	uint64_t getTotal(Counter counter) const;
+	// per-frame means since the last call, on one line
+	std::string takeIntervalLine();
+	void writeJson(const std::string& path) const;
+};
\ No newline at end of file
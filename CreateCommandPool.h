@@ -1,3 +1,3 @@
 #include <vulkan/vulkan.h>
 #pragma once
-void createCommandPool(VkDevice device, uint32_t familyIndex, VkCommandPool* commandPool);
\ No newline at end of file
+void createCommandPool(VkDevice device, uint32_t familyIndex, VkCommandPool* commandPool, VkCommandPoolCreateFlags flags = 0);
\ No newline at end of file
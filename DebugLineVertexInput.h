@@ -0,0 +1,19 @@
+#pragma once
+#include "VertexInput.h"
+#include <cstdint>
+
+// One end of a debug overlay line, already on screen.
+struct DebugLineVertex {
+    float x;
+    float y;
+    // RGBA8, red in the lowest byte
+    uint32_t color;
+};
+template <>
+struct VertexLayout<DebugLineVertex> {
+    static constexpr VkVertexInputBindingDescription binding = { 0, sizeof(DebugLineVertex), VK_VERTEX_INPUT_RATE_VERTEX };
+    static constexpr VkVertexInputAttributeDescription attributes[] = {
+        { 0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(DebugLineVertex, x) },
+        { 1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(DebugLineVertex, color) },
+    };
+};
\ No newline at end of file
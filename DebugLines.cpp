@@ -0,0 +1,82 @@
+#include "DebugLines.h"
+
+DebugLines::DebugLines(VkDevice device, PipelineManager* pipelineManager, GpuAllocator* allocator, uint32_t maxLines, uint32_t framesInFlight)
+{
+    this->device = device;
+    this->allocator = allocator;
+    this->maxLines = maxLines;
+    VkDeviceSize bufferSize = (VkDeviceSize)maxLines * 2 * sizeof(DebugLineVertex);
+    this->vertexBuffers.resize(framesInFlight);
+    this->vertexMemories.resize(framesInFlight);
+    for (uint32_t frameIndex = 0; frameIndex < framesInFlight; frameIndex++) {
+        pipelineManager->createBuffer(bufferSize,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            this->vertexBuffers[frameIndex], this->vertexMemories[frameIndex], 0, nullptr);
+    }
+    this->begin(0);
+}
+
+DebugLines::~DebugLines()
+{
+    for (size_t frameIndex = 0; frameIndex < this->vertexBuffers.size(); frameIndex++) {
+        vkDestroyBuffer(this->device, this->vertexBuffers[frameIndex], nullptr);
+        this->allocator->free(this->vertexMemories[frameIndex]);
+    }
+}
+
+void DebugLines::begin(uint32_t frameIndex)
+{
+    this->frameIndex = frameIndex;
+    this->vertices = static_cast<DebugLineVertex*>(this->vertexMemories[frameIndex].mappedData);
+    this->lineCount = 0;
+    this->droppedLines = 0;
+}
+
+void DebugLines::addLine(float x0, float y0, float x1, float y1, uint32_t color)
+{
+    if (this->lineCount == this->maxLines) {
+        this->droppedLines++;
+        return;
+    }
+    DebugLineVertex* line = this->vertices + this->lineCount * 2;
+    line[0] = { x0, y0, color };
+    line[1] = { x1, y1, color };
+    this->lineCount++;
+}
+
+void DebugLines::addContacts(const std::vector<Contact>& contacts, uint32_t color)
+{
+    const float CROSS_SIZE = 0.004f;
+    for (const Contact& contact : contacts) {
+        this->addLine(contact.pointX - CROSS_SIZE, contact.pointY - CROSS_SIZE, contact.pointX + CROSS_SIZE, contact.pointY + CROSS_SIZE, color);
+        this->addLine(contact.pointX - CROSS_SIZE, contact.pointY + CROSS_SIZE, contact.pointX + CROSS_SIZE, contact.pointY - CROSS_SIZE, color);
+        this->addLine(contact.pointX, contact.pointY, contact.pointX + contact.normalX * contact.depth, contact.pointY + contact.normalY * contact.depth, color);
+    }
+}
+
+void DebugLines::addWorld(const std::vector<WorldSegment>& world, uint32_t color)
+{
+    for (const WorldSegment& segment : world) {
+        this->addLine(segment.x0, segment.y0, segment.x1, segment.y1, color);
+    }
+}
+
+uint32_t DebugLines::getLineCount() const
+{
+    return this->lineCount;
+}
+uint32_t DebugLines::getDroppedLineCount() const
+{
+    return this->droppedLines;
+}
+
+DrawCommand DebugLines::getDraw(PipelineHandle pipeline) const
+{
+    DrawCommand draw{};
+    draw.pipeline = pipeline;
+    draw.vertexBuffer = this->vertexBuffers[this->frameIndex];
+    draw.vertexCount = this->lineCount * 2;
+    draw.instanceCount = 1;
+    return draw;
+}
\ No newline at end of file
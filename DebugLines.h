@@ -0,0 +1,36 @@
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "PipelineManager.h"
+#include "GpuAllocator.h"
+#include "DebugLineVertexInput.h"
+#include "FigureCollider.h"
+
+#pragma once
+// Lines drawn over the frame for debugging, collected anew every frame. They are written straight into a host
+// visible buffer of the frame in flight and drawn with one line list draw of a pipeline made by
+// PipelineManager; lines past the capacity are dropped and counted.
+class DebugLines
+{
+private:
+	VkDevice device;
+	GpuAllocator* allocator;
+	std::vector<VkBuffer> vertexBuffers;
+	std::vector<GpuAllocation> vertexMemories;
+	uint32_t maxLines;
+	uint32_t frameIndex = 0;
+	DebugLineVertex* vertices = nullptr;
+	uint32_t lineCount = 0;
+	uint32_t droppedLines = 0;
+public:
+	DebugLines(VkDevice device, PipelineManager* pipelineManager, GpuAllocator* allocator, uint32_t maxLines, uint32_t framesInFlight);
+	~DebugLines();
+	// the frame's previous submit has to be done, its lines are overwritten
+	void begin(uint32_t frameIndex);
+	void addLine(float x0, float y0, float x1, float y1, uint32_t color);
+	// a cross at each contact point and its normal, as long as the contact is deep
+	void addContacts(const std::vector<Contact>& contacts, uint32_t color);
+	void addWorld(const std::vector<WorldSegment>& world, uint32_t color);
+	uint32_t getLineCount() const;
+	uint32_t getDroppedLineCount() const;
+	DrawCommand getDraw(PipelineHandle pipeline) const;
+};
\ No newline at end of file
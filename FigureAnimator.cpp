@@ -0,0 +1,109 @@
+#include "FigureAnimator.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <cstring>
+
+FigureAnimator::FigureAnimator(VkDevice device, PipelineManager* pipelineManager, GpuAllocator* allocator, uint32_t figureCount, uint32_t framesInFlight)
+{
+    this->device = device;
+    this->allocator = allocator;
+    this->path = PoseEvaluator::getWidestPath();
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-0.95f, 0.95f);
+    std::uniform_real_distribution<float> scale(0.02f, 0.06f);
+    std::uniform_real_distribution<float> phase(0.0f, 6.2831853f);
+    std::uniform_int_distribution<uint32_t> color(0, 0xFFFFFF);
+    this->poses.resize(figureCount);
+    this->phases.resize(figureCount);
+    for (uint32_t figure = 0; figure < figureCount; figure++) {
+        this->poses.positionsX[figure] = position(random);
+        this->poses.positionsY[figure] = position(random);
+        this->poses.scales[figure] = scale(random);
+        this->poses.colors[figure] = color(random) | 0xFF000000;
+        this->phases[figure] = phase(random);
+    }
+    this->animate(0.0);
+
+    // written by the CPU once per frame and read once by the GPU, so it lives in host memory rather than being copied
+    VkDeviceSize bufferSize = (VkDeviceSize)std::max<uint32_t>(figureCount, 1) * sizeof(AnimatedFigureInstance);
+    this->instanceBuffers.resize(framesInFlight);
+    this->instanceMemories.resize(framesInFlight);
+    for (uint32_t frameIndex = 0; frameIndex < framesInFlight; frameIndex++) {
+        pipelineManager->createBuffer(bufferSize,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            this->instanceBuffers[frameIndex], this->instanceMemories[frameIndex], 0, nullptr);
+    }
+}
+
+FigureAnimator::~FigureAnimator()
+{
+    for (size_t frameIndex = 0; frameIndex < this->instanceBuffers.size(); frameIndex++) {
+        vkDestroyBuffer(this->device, this->instanceBuffers[frameIndex], nullptr);
+        this->allocator->free(this->instanceMemories[frameIndex]);
+    }
+}
+
+uint32_t FigureAnimator::getFigureCount() const
+{
+    return (uint32_t)this->poses.size();
+}
+FigurePoses& FigureAnimator::getPoses()
+{
+    return this->poses;
+}
+void FigureAnimator::setPath(PoseEvaluationPath path)
+{
+    this->path = path;
+}
+
+// Arms and legs swing against each other, the elbows and knees bend with the swing; the angles are relative to the
+// parent bone, see FigurePoses.
+void FigureAnimator::animate(double time)
+{
+    const float PI = 3.14159265f;
+    float cycle = (float)std::fmod(time * STEP_RATE * PI, 2.0 * PI);
+    for (size_t figure = 0; figure < this->poses.size(); figure++) {
+        float swing = std::sin(cycle + this->phases[figure]);
+        this->poses.boneAngles[0][figure] = 0.05f * swing;
+        this->poses.boneAngles[1][figure] = -PI - 0.4f + 0.6f * swing;
+        this->poses.boneAngles[2][figure] = -0.3f + 0.2f * swing;
+        this->poses.boneAngles[3][figure] = -PI + 0.4f - 0.6f * swing;
+        this->poses.boneAngles[4][figure] = 0.3f + 0.2f * swing;
+        this->poses.boneAngles[5][figure] = 0.5f * swing;
+        this->poses.boneAngles[6][figure] = 0.2f + 0.2f * swing;
+        this->poses.boneAngles[7][figure] = -0.5f * swing;
+        this->poses.boneAngles[8][figure] = 0.2f - 0.2f * swing;
+    }
+}
+
+void FigureAnimator::evaluate(uint32_t frameIndex)
+{
+    AnimatedFigureInstance* instances = static_cast<AnimatedFigureInstance*>(this->instanceMemories[frameIndex].mappedData);
+    PoseEvaluator::evaluate(this->poses, 0, this->poses.size(), instances, this->path);
+}
+
+const AnimatedFigureInstance* FigureAnimator::evaluateToHost(uint32_t frameIndex)
+{
+    this->hostInstances.resize(this->poses.size());
+    PoseEvaluator::evaluate(this->poses, 0, this->poses.size(), this->hostInstances.data(), this->path);
+    memcpy(this->instanceMemories[frameIndex].mappedData, this->hostInstances.data(), this->hostInstances.size() * sizeof(AnimatedFigureInstance));
+    return this->hostInstances.data();
+}
+
+const AnimatedFigureInstance* FigureAnimator::getInstances(uint32_t frameIndex) const
+{
+    return static_cast<const AnimatedFigureInstance*>(this->instanceMemories[frameIndex].mappedData);
+}
+
+DrawCommand FigureAnimator::getDraw(PipelineHandle pipeline, uint32_t frameIndex)
+{
+    DrawCommand draw{};
+    draw.pipeline = pipeline;
+    draw.vertexBuffer = this->instanceBuffers[frameIndex];
+    draw.vertexCount = ANIMATED_FIGURE_VERTEX_COUNT;
+    draw.instanceCount = (uint32_t)this->poses.size();
+    return draw;
+}
\ No newline at end of file
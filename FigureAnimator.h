@@ -0,0 +1,43 @@
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "PipelineManager.h"
+#include "GpuAllocator.h"
+#include "PoseEvaluator.h"
+
+#pragma once
+// Figures walking in place. Every frame animate sets their joint angles from a walk cycle and evaluate runs the pose
+// evaluation straight into the frame's instance buffer, which is host visible and stays mapped; there is one per
+// frame in flight so the GPU never reads a buffer that is being written.
+class FigureAnimator
+{
+private:
+	VkDevice device;
+	GpuAllocator* allocator;
+	FigurePoses poses;
+	// where in its walk cycle each figure starts, in radians
+	std::vector<float> phases;
+	std::vector<VkBuffer> instanceBuffers;
+	std::vector<GpuAllocation> instanceMemories;
+	std::vector<AnimatedFigureInstance> hostInstances;
+	PoseEvaluationPath path;
+public:
+	// steps per second of the walk cycle
+	static constexpr float STEP_RATE = 1.5f;
+
+	// places figureCount figures at random over the screen, with a fixed seed
+	FigureAnimator(VkDevice device, PipelineManager* pipelineManager, GpuAllocator* allocator, uint32_t figureCount, uint32_t framesInFlight);
+	~FigureAnimator();
+	uint32_t getFigureCount() const;
+	FigurePoses& getPoses();
+	// the widest the CPU supports unless set
+	void setPath(PoseEvaluationPath path);
+	// time in seconds since the animation started
+	void animate(double time);
+	// the frame's previous submit has to be done, its instances are overwritten
+	void evaluate(uint32_t frameIndex);
+	// Evaluates into host memory and copies that to the frame's instances, for when the CPU reads the poses as well;
+	// the mapped buffer may be uncached. The returned instances stay valid until the next call.
+	const AnimatedFigureInstance* evaluateToHost(uint32_t frameIndex);
+	const AnimatedFigureInstance* getInstances(uint32_t frameIndex) const;
+	DrawCommand getDraw(PipelineHandle pipeline, uint32_t frameIndex);
+};
\ No newline at end of file
@@ -0,0 +1,248 @@
+#include "FigureCollider.h"
+#include "PoseKernel.h"
+#include <cmath>
+#include <algorithm>
+
+struct Capsule {
+    float x0;
+    float y0;
+    float x1;
+    float y1;
+    float radius;
+};
+
+static Capsule getPart(const AnimatedFigureInstance& figure, uint32_t part)
+{
+    if (part == FigureCollider::HEAD_PART) {
+        float centerX;
+        float centerY;
+        getHeadCenter(figure, centerX, centerY);
+        return { centerX, centerY, centerX, centerY, figure.headRadius };
+    }
+    const float* start = figure.joints[POSE_BONE_START_JOINTS[part]];
+    const float* end = figure.joints[part + 1];
+    return { start[0], start[1], end[0], end[1], figure.headRadius * FigureCollider::LIMB_RADIUS };
+}
+
+static inline float clamp01(float value)
+{
+    return std::min(std::max(value, 0.0f), 1.0f);
+}
+
+// Closest points of two segments as fractions along them (Ericson, Real-Time Collision Detection 5.1.9).
+static void closestPoints(const Capsule& a, const Capsule& b, float& s, float& t)
+{
+    const float EPSILON = 1e-12f;
+    float directionAX = a.x1 - a.x0;
+    float directionAY = a.y1 - a.y0;
+    float directionBX = b.x1 - b.x0;
+    float directionBY = b.y1 - b.y0;
+    float offsetX = a.x0 - b.x0;
+    float offsetY = a.y0 - b.y0;
+    float lengthA = directionAX * directionAX + directionAY * directionAY;
+    float lengthB = directionBX * directionBX + directionBY * directionBY;
+    float f = directionBX * offsetX + directionBY * offsetY;
+    if (lengthA <= EPSILON && lengthB <= EPSILON) {
+        s = 0.0f;
+        t = 0.0f;
+        return;
+    }
+    if (lengthA <= EPSILON) {
+        s = 0.0f;
+        t = clamp01(f / lengthB);
+        return;
+    }
+    float c = directionAX * offsetX + directionAY * offsetY;
+    if (lengthB <= EPSILON) {
+        t = 0.0f;
+        s = clamp01(-c / lengthA);
+        return;
+    }
+    float b2 = directionAX * directionBX + directionAY * directionBY;
+    float denominator = lengthA * lengthB - b2 * b2;
+    // parallel segments pick any point, the one at a's start
+    s = denominator != 0.0f ? clamp01((b2 * f - c * lengthB) / denominator) : 0.0f;
+    t = (b2 * s + f) / lengthB;
+    if (t < 0.0f) {
+        t = 0.0f;
+        s = clamp01(-c / lengthA);
+    }
+    else if (t > 1.0f) {
+        t = 1.0f;
+        s = clamp01((b2 - c) / lengthA);
+    }
+}
+
+// appends a contact when the capsules overlap
+static void testCapsules(const Capsule& a, const Capsule& b, Contact contact, std::vector<Contact>& contacts)
+{
+    float s;
+    float t;
+    closestPoints(a, b, s, t);
+    float pointAX = a.x0 + (a.x1 - a.x0) * s;
+    float pointAY = a.y0 + (a.y1 - a.y0) * s;
+    float pointBX = b.x0 + (b.x1 - b.x0) * t;
+    float pointBY = b.y0 + (b.y1 - b.y0) * t;
+    float deltaX = pointBX - pointAX;
+    float deltaY = pointBY - pointAY;
+    float radii = a.radius + b.radius;
+    float distanceSquared = deltaX * deltaX + deltaY * deltaY;
+    if (distanceSquared >= radii * radii) {
+        return;
+    }
+    float distance = std::sqrt(distanceSquared);
+    if (distance > 0.0f) {
+        contact.normalX = deltaX / distance;
+        contact.normalY = deltaY / distance;
+    }
+    else {
+        // crossing center lines have no direction between them, push off a's side instead
+        float lengthA = std::sqrt((a.x1 - a.x0) * (a.x1 - a.x0) + (a.y1 - a.y0) * (a.y1 - a.y0));
+        contact.normalX = lengthA > 0.0f ? -(a.y1 - a.y0) / lengthA : 0.0f;
+        contact.normalY = lengthA > 0.0f ? (a.x1 - a.x0) / lengthA : 1.0f;
+    }
+    // halfway between the two surfaces
+    contact.pointX = 0.5f * (pointAX + contact.normalX * a.radius + pointBX - contact.normalX * b.radius);
+    contact.pointY = 0.5f * (pointAY + contact.normalY * a.radius + pointBY - contact.normalY * b.radius);
+    contact.depth = radii - distance;
+    contacts.push_back(contact);
+}
+
+// whether the capsules' boxes overlap, most part pairs of two figures are rejected here
+static inline bool mayTouch(const Capsule& a, const Capsule& b)
+{
+    float radii = a.radius + b.radius;
+    return std::min(a.x0, a.x1) - radii <= std::max(b.x0, b.x1) && std::min(b.x0, b.x1) <= std::max(a.x0, a.x1) + radii
+        && std::min(a.y0, a.y1) - radii <= std::max(b.y0, b.y1) && std::min(b.y0, b.y1) <= std::max(a.y0, a.y1) + radii;
+}
+
+// bounds of every figure, with the head and the limbs' thickness; returns the largest extent
+static float computeBounds(const AnimatedFigureInstance* figures, uint32_t count, float* minX, float* minY, float* maxX, float* maxY)
+{
+    float largestExtent = 0.0f;
+    for (uint32_t figure = 0; figure < count; figure++) {
+        const AnimatedFigureInstance& instance = figures[figure];
+        Capsule head = getPart(instance, FigureCollider::HEAD_PART);
+        float lowX = head.x0;
+        float lowY = head.y0;
+        float highX = head.x0;
+        float highY = head.y0;
+        for (uint32_t joint = 0; joint < SKELETON_JOINT_COUNT; joint++) {
+            lowX = std::min(lowX, instance.joints[joint][0]);
+            lowY = std::min(lowY, instance.joints[joint][1]);
+            highX = std::max(highX, instance.joints[joint][0]);
+            highY = std::max(highY, instance.joints[joint][1]);
+        }
+        // the head radius covers the limbs, which are thinner
+        minX[figure] = lowX - instance.headRadius;
+        minY[figure] = lowY - instance.headRadius;
+        maxX[figure] = highX + instance.headRadius;
+        maxY[figure] = highY + instance.headRadius;
+        largestExtent = std::max(largestExtent, std::max(maxX[figure] - minX[figure], maxY[figure] - minY[figure]));
+    }
+    return largestExtent;
+}
+
+void FigureCollider::setWorld(size_t segmentCount, const WorldSegment* segments)
+{
+    this->world.assign(segments, segments + segmentCount);
+}
+const std::vector<WorldSegment>& FigureCollider::getWorld() const
+{
+    return this->world;
+}
+
+size_t FigureCollider::findPairs(const AnimatedFigureInstance* figures, uint32_t count)
+{
+    this->boundsMinX.resize(count);
+    this->boundsMinY.resize(count);
+    this->boundsMaxX.resize(count);
+    this->boundsMaxY.resize(count);
+    float cellSize = computeBounds(figures, count, this->boundsMinX.data(), this->boundsMinY.data(), this->boundsMaxX.data(), this->boundsMaxY.data());
+    this->pairs.clear();
+    if (count == 0 || cellSize <= 0.0f) {
+        return 0;
+    }
+    this->broadphase.build(this->boundsMinX.data(), this->boundsMinY.data(), this->boundsMaxX.data(), this->boundsMaxY.data(), count, cellSize);
+    this->broadphase.findPairs(this->pairs);
+    return this->pairs.size();
+}
+
+size_t FigureCollider::findPairsBruteForce(const AnimatedFigureInstance* figures, uint32_t count)
+{
+    this->boundsMinX.resize(count);
+    this->boundsMinY.resize(count);
+    this->boundsMaxX.resize(count);
+    this->boundsMaxY.resize(count);
+    computeBounds(figures, count, this->boundsMinX.data(), this->boundsMinY.data(), this->boundsMaxX.data(), this->boundsMaxY.data());
+    this->pairs.clear();
+    for (uint32_t a = 0; a < count; a++) {
+        for (uint32_t b = a + 1; b < count; b++) {
+            if (this->boundsMinX[a] <= this->boundsMaxX[b] && this->boundsMinX[b] <= this->boundsMaxX[a]
+                && this->boundsMinY[a] <= this->boundsMaxY[b] && this->boundsMinY[b] <= this->boundsMaxY[a]) {
+                this->pairs.push_back({ a, b });
+            }
+        }
+    }
+    return this->pairs.size();
+}
+
+size_t FigureCollider::findContacts(const AnimatedFigureInstance* figures, uint32_t count)
+{
+    this->contacts.clear();
+    Capsule partsA[PART_COUNT];
+    Capsule partsB[PART_COUNT];
+    for (const CollisionPair& pair : this->pairs) {
+        for (uint32_t part = 0; part < PART_COUNT; part++) {
+            partsA[part] = getPart(figures[pair.a], part);
+            partsB[part] = getPart(figures[pair.b], part);
+        }
+        for (uint32_t partA = 0; partA < PART_COUNT; partA++) {
+            for (uint32_t partB = 0; partB < PART_COUNT; partB++) {
+                if (!mayTouch(partsA[partA], partsB[partB])) {
+                    continue;
+                }
+                Contact contact{};
+                contact.figureA = pair.a;
+                contact.figureB = pair.b;
+                contact.partA = partA;
+                contact.partB = partB;
+                testCapsules(partsA[partA], partsB[partB], contact, this->contacts);
+            }
+        }
+    }
+
+    // the world is a handful of segments, each figure's box is tested against all of them
+    for (uint32_t segment = 0; segment < this->world.size(); segment++) {
+        const WorldSegment& line = this->world[segment];
+        Capsule lineCapsule = { line.x0, line.y0, line.x1, line.y1, 0.0f };
+        float lineMinX = std::min(line.x0, line.x1);
+        float lineMinY = std::min(line.y0, line.y1);
+        float lineMaxX = std::max(line.x0, line.x1);
+        float lineMaxY = std::max(line.y0, line.y1);
+        for (uint32_t figure = 0; figure < count; figure++) {
+            if (this->boundsMinX[figure] > lineMaxX || lineMinX > this->boundsMaxX[figure]
+                || this->boundsMinY[figure] > lineMaxY || lineMinY > this->boundsMaxY[figure]) {
+                continue;
+            }
+            for (uint32_t part = 0; part < PART_COUNT; part++) {
+                Contact contact{};
+                contact.figureA = figure;
+                contact.figureB = WORLD;
+                contact.partA = part;
+                contact.partB = segment;
+                testCapsules(getPart(figures[figure], part), lineCapsule, contact, this->contacts);
+            }
+        }
+    }
+    return this->contacts.size();
+}
+
+const std::vector<CollisionPair>& FigureCollider::getPairs() const
+{
+    return this->pairs;
+}
+const std::vector<Contact>& FigureCollider::getContacts() const
+{
+    return this->contacts;
+}
\ No newline at end of file
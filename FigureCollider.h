@@ -0,0 +1,59 @@
+#include <vector>
+#include <cstdint>
+#include "AnimatedFigureVertexInput.h"
+#include "SpatialHash.h"
+
+#pragma once
+// A static line of the world that figures collide with, like the ground or a platform.
+struct WorldSegment {
+	float x0;
+	float y0;
+	float x1;
+	float y1;
+};
+// Where two parts touch: the point halfway between their surfaces, the normal pointing from a to b and how far they
+// overlap. A part is a bone, or FigureCollider::HEAD_PART.
+struct Contact {
+	uint32_t figureA;
+	// FigureCollider::WORLD for contacts with the world, partB then is the WorldSegment index
+	uint32_t figureB;
+	uint32_t partA;
+	uint32_t partB;
+	float pointX;
+	float pointY;
+	float normalX;
+	float normalY;
+	float depth;
+};
+// Collision tests for animated figures, run once per tick on the poses PoseEvaluator placed. Every bone is a capsule
+// and the head a circle; findPairs sorts the figures' bounding boxes into a SpatialHash for the pairs that may touch,
+// findContacts tests the parts of those pairs against each other and every figure against the world segments.
+class FigureCollider
+{
+private:
+	std::vector<float> boundsMinX;
+	std::vector<float> boundsMinY;
+	std::vector<float> boundsMaxX;
+	std::vector<float> boundsMaxY;
+	SpatialHash broadphase;
+	std::vector<CollisionPair> pairs;
+	std::vector<WorldSegment> world;
+	std::vector<Contact> contacts;
+public:
+	static const uint32_t HEAD_PART = SKELETON_BONE_COUNT;
+	static const uint32_t PART_COUNT = SKELETON_BONE_COUNT + 1;
+	static const uint32_t WORLD = UINT32_MAX;
+	// bone capsules are this thick relative to the head's radius
+	static constexpr float LIMB_RADIUS = 0.15f;
+
+	void setWorld(size_t segmentCount, const WorldSegment* segments);
+	const std::vector<WorldSegment>& getWorld() const;
+	// broadphase, with cells as large as the largest figure; returns the number of pairs
+	size_t findPairs(const AnimatedFigureInstance* figures, uint32_t count);
+	// every pair by its boxes, what the broadphase replaces; for checking it
+	size_t findPairsBruteForce(const AnimatedFigureInstance* figures, uint32_t count);
+	// narrowphase on the pairs of the last findPairs, with the same figures; returns the number of contacts
+	size_t findContacts(const AnimatedFigureInstance* figures, uint32_t count);
+	const std::vector<CollisionPair>& getPairs() const;
+	const std::vector<Contact>& getContacts() const;
+};
\ No newline at end of file
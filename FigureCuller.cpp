@@ -0,0 +1,112 @@
+#include "FigureCuller.h"
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+FigureCuller::FigureCuller(VkDevice device, PipelineManager* pipelineManager, GpuAllocator* allocator, uint32_t maxFigures)
+{
+    this->device = device;
+    this->pipelineManager = pipelineManager;
+    this->allocator = allocator;
+    this->maxFigures = maxFigures;
+
+    VkDeviceSize figuresSize = (VkDeviceSize)std::max<uint32_t>(maxFigures, 1) * sizeof(StickFigureInstance);
+    this->pipelineManager->createBuffer(figuresSize,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        this->entityBuffer, this->entityMemory, 0, nullptr);
+    this->pipelineManager->createBuffer(figuresSize,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        this->visibleBuffer, this->visibleMemory, 0, nullptr);
+    this->pipelineManager->createBuffer(DRAW_COUNT_OFFSET + sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        this->drawBuffer, this->drawMemory, 0, nullptr);
+    memset(this->drawMemory.mappedData, 0, DRAW_COUNT_OFFSET + sizeof(uint32_t));
+
+    ComputePipelineCreateInfo createInfo{};
+    createInfo.name = "cull";
+    createInfo.computeShaderModule = "compiled_shaders/cull.comp.spv";
+    createInfo.storageBufferCount = 3;
+    createInfo.pushConstantSize = sizeof(uint32_t);
+    this->pipelineManager->createComputePipelines(1, &createInfo);
+    VkBuffer buffers[] = { this->entityBuffer, this->visibleBuffer, this->drawBuffer };
+    this->cullPipeline = this->pipelineManager->findComputePipeline("cull");
+    this->pipelineManager->bindStorageBuffers(this->cullPipeline, 3, buffers);
+}
+
+FigureCuller::~FigureCuller()
+{
+    vkDestroyBuffer(this->device, this->entityBuffer, nullptr);
+    this->allocator->free(this->entityMemory);
+    vkDestroyBuffer(this->device, this->visibleBuffer, nullptr);
+    this->allocator->free(this->visibleMemory);
+    vkDestroyBuffer(this->device, this->drawBuffer, nullptr);
+    this->allocator->free(this->drawMemory);
+}
+
+VkBuffer FigureCuller::getFigureBuffer()
+{
+    return this->entityBuffer;
+}
+
+void FigureCuller::setFigureCount(uint32_t figureCount)
+{
+    if (figureCount > this->maxFigures) {
+        throw std::runtime_error("too many figures for the culler!");
+    }
+    this->figureCount = figureCount;
+}
+
+void FigureCuller::writeCulling(VkCommandBuffer buffer)
+{
+    // the previous frame's draw has to be done reading the outputs before they are cleared
+    VkMemoryBarrier clearBarrier{};
+    clearBarrier.sType = VkStructureType::VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = 0;
+    clearBarrier.dstAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    uint32_t drawHeader[] = { STICK_FIGURE_VERTEX_COUNT, 0, 0, 0, 0 };
+    vkCmdUpdateBuffer(buffer, this->drawBuffer, 0, sizeof(drawHeader), drawHeader);
+
+    VkMemoryBarrier cullBarrier{};
+    cullBarrier.sType = VkStructureType::VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullBarrier.srcAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_WRITE_BIT;
+    cullBarrier.dstAccessMask = VkAccessFlagBits::VK_ACCESS_SHADER_READ_BIT | VkAccessFlagBits::VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+    uint32_t groupCount = (this->figureCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+    if (groupCount > 0) {
+        this->pipelineManager->writeDispatch(buffer, this->cullPipeline, groupCount, &this->figureCount);
+    }
+
+    // the host stage is for readVisibleCount
+    VkMemoryBarrier drawBarrier{};
+    drawBarrier.sType = VkStructureType::VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    drawBarrier.srcAccessMask = VkAccessFlagBits::VK_ACCESS_SHADER_WRITE_BIT;
+    drawBarrier.dstAccessMask = VkAccessFlagBits::VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VkAccessFlagBits::VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VkAccessFlagBits::VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+}
+
+DrawCommand FigureCuller::getDraw(PipelineHandle pipeline)
+{
+    DrawCommand draw{};
+    draw.pipeline = pipeline;
+    draw.vertexBuffer = this->visibleBuffer;
+    draw.indirectBuffer = this->drawBuffer;
+    draw.indirectOffset = 0;
+    draw.countBuffer = this->drawBuffer;
+    draw.countOffset = DRAW_COUNT_OFFSET;
+    return draw;
+}
+
+uint32_t FigureCuller::readVisibleCount()
+{
+    const VkDrawIndirectCommand* drawCommand = static_cast<const VkDrawIndirectCommand*>(this->drawMemory.mappedData);
+    return drawCommand->instanceCount;
+}
@@ -0,0 +1,40 @@
+#include <vulkan/vulkan.h>
+#include "PipelineManager.h"
+#include "GpuAllocator.h"
+#include "StickFigureVertexInput.h"
+
+#pragma once
+// Culls figures against the screen in a compute pass and leaves the survivors in a compacted instance buffer,
+// together with the VkDrawIndirectCommand and draw count that draw them. No per-figure work happens on the CPU.
+class FigureCuller
+{
+private:
+	VkDevice device;
+	PipelineManager* pipelineManager;
+	GpuAllocator* allocator;
+	uint32_t maxFigures;
+	uint32_t figureCount = 0;
+	PipelineHandle cullPipeline;
+	VkBuffer entityBuffer;
+	GpuAllocation entityMemory;
+	VkBuffer visibleBuffer;
+	GpuAllocation visibleMemory;
+	// VkDrawIndirectCommand followed by a uint32_t draw count, host visible so results can be read back and checked
+	VkBuffer drawBuffer;
+	GpuAllocation drawMemory;
+public:
+	static const uint32_t WORKGROUP_SIZE = 64;
+	static const VkDeviceSize DRAW_COUNT_OFFSET = sizeof(VkDrawIndirectCommand);
+
+	FigureCuller(VkDevice device, PipelineManager* pipelineManager, GpuAllocator* allocator, uint32_t maxFigures);
+	~FigureCuller();
+	// holds a StickFigureInstance per figure, FigureScene::flush fills it; draws of every figure can bind it as well
+	VkBuffer getFigureBuffer();
+	// how many figures of the buffer the culling pass reads
+	void setFigureCount(uint32_t figureCount);
+	// records the culling pass, has to be outside of a render pass and before the draw
+	void writeCulling(VkCommandBuffer buffer);
+	DrawCommand getDraw(PipelineHandle pipeline);
+	// instance count the last completed culling pass wrote
+	uint32_t readVisibleCount();
+};
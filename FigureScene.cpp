@@ -0,0 +1,150 @@
+#include "FigureScene.h"
+#include <algorithm>
+
+FigureId FigureScene::add(float positionX, float positionY, float scale, uint32_t pose, uint32_t color)
+{
+    FigureId figure = (FigureId)this->positionsX.size();
+    this->positionsX.push_back(positionX);
+    this->positionsY.push_back(positionY);
+    this->scales.push_back(scale);
+    this->poses.push_back(pose);
+    this->colors.push_back(color);
+    this->instances.emplace_back();
+    if (figure % 64 == 0) {
+        this->dirtyWords.push_back(0);
+        // room for every word, so marking never allocates
+        this->dirtyWordIndices.reserve(this->dirtyWords.size());
+    }
+    this->markDirty(figure);
+    return figure;
+}
+void FigureScene::clear()
+{
+    this->positionsX.clear();
+    this->positionsY.clear();
+    this->scales.clear();
+    this->poses.clear();
+    this->colors.clear();
+    this->instances.clear();
+    this->dirtyWords.clear();
+    this->dirtyWordIndices.clear();
+    this->dirtyCount = 0;
+}
+uint32_t FigureScene::size() const
+{
+    return (uint32_t)this->positionsX.size();
+}
+void FigureScene::markDirty(FigureId figure)
+{
+    uint64_t& word = this->dirtyWords[figure / 64];
+    uint64_t bit = 1ull << (figure % 64);
+    if (word & bit) {
+        return;
+    }
+    if (word == 0) {
+        this->dirtyWordIndices.push_back(figure / 64);
+    }
+    word |= bit;
+    this->dirtyCount++;
+}
+void FigureScene::markAllDirty()
+{
+    for (FigureId figure = 0; figure < this->size(); figure++) {
+        this->markDirty(figure);
+    }
+}
+void FigureScene::setPosition(FigureId figure, float positionX, float positionY)
+{
+    this->positionsX[figure] = positionX;
+    this->positionsY[figure] = positionY;
+    this->markDirty(figure);
+}
+void FigureScene::setScale(FigureId figure, float scale)
+{
+    this->scales[figure] = scale;
+    this->markDirty(figure);
+}
+void FigureScene::setPose(FigureId figure, uint32_t pose)
+{
+    this->poses[figure] = pose;
+    this->markDirty(figure);
+}
+void FigureScene::setColor(FigureId figure, uint32_t color)
+{
+    this->colors[figure] = color;
+    this->markDirty(figure);
+}
+const float* FigureScene::getPositionsX() const
+{
+    return this->positionsX.data();
+}
+const float* FigureScene::getPositionsY() const
+{
+    return this->positionsY.data();
+}
+const float* FigureScene::getScales() const
+{
+    return this->scales.data();
+}
+const uint32_t* FigureScene::getPoses() const
+{
+    return this->poses.data();
+}
+const uint32_t* FigureScene::getColors() const
+{
+    return this->colors.data();
+}
+void FigureScene::packRange(FigureId first, FigureId last)
+{
+    for (FigureId figure = first; figure <= last; figure++) {
+        StickFigureInstance& instance = this->instances[figure];
+        instance.position[0] = this->positionsX[figure];
+        instance.position[1] = this->positionsY[figure];
+        instance.scale = this->scales[figure];
+        instance.pose = this->poses[figure];
+        instance.color = this->colors[figure];
+    }
+}
+
+SceneFlushStats FigureScene::flush(UploadRing* uploadRing, VkBuffer figureBuffer)
+{
+    SceneFlushStats stats{};
+    stats.dirtyFigures = this->dirtyCount;
+    // in figure order, so neighbouring dirty figures end up in one copy
+    std::sort(this->dirtyWordIndices.begin(), this->dirtyWordIndices.end());
+    FigureId rangeFirst = 0;
+    FigureId rangeLast = 0;
+    bool inRange = false;
+    auto uploadRange = [&]() {
+        this->packRange(rangeFirst, rangeLast);
+        VkDeviceSize size = (VkDeviceSize)(rangeLast - rangeFirst + 1) * sizeof(StickFigureInstance);
+        uploadRing->upload(figureBuffer, (VkDeviceSize)rangeFirst * sizeof(StickFigureInstance), &this->instances[rangeFirst], size);
+        stats.uploadedBytes += size;
+        stats.uploadedRanges++;
+    };
+    for (uint32_t wordIndex : this->dirtyWordIndices) {
+        uint64_t word = this->dirtyWords[wordIndex];
+        this->dirtyWords[wordIndex] = 0;
+        for (FigureId figure = wordIndex * 64; word != 0; figure++, word >>= 1) {
+            if ((word & 1) == 0) {
+                continue;
+            }
+            if (inRange && figure <= rangeLast + MERGE_GAP + 1) {
+                rangeLast = figure;
+                continue;
+            }
+            if (inRange) {
+                uploadRange();
+            }
+            rangeFirst = figure;
+            rangeLast = figure;
+            inRange = true;
+        }
+    }
+    if (inRange) {
+        uploadRange();
+    }
+    this->dirtyWordIndices.clear();
+    this->dirtyCount = 0;
+    return stats;
+}
\ No newline at end of file
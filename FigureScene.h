@@ -0,0 +1,58 @@
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include "StickFigureVertexInput.h"
+#include "UploadRing.h"
+
+#pragma once
+// Dense index of a figure, stable until the scene is cleared.
+typedef uint32_t FigureId;
+struct SceneFlushStats {
+	VkDeviceSize uploadedBytes;
+	uint32_t uploadedRanges;
+	uint32_t dirtyFigures;
+};
+// The stick figures of the scene, kept from frame to frame with one array per field. The skeleton itself is shared:
+// every figure picks one of its key poses (see shaders/stickfigure.vert) and places it with its transform.
+// Setters mark the figure dirty, and flush uploads only the ranges of dirty figures, so the bytes uploaded per frame
+// follow what changed rather than the scene size.
+class FigureScene
+{
+private:
+	std::vector<float> positionsX;
+	std::vector<float> positionsY;
+	std::vector<float> scales;
+	std::vector<uint32_t> poses;
+	std::vector<uint32_t> colors;
+	// one bit per figure, and the index of every word with a bit set, listed once
+	std::vector<uint64_t> dirtyWords;
+	std::vector<uint32_t> dirtyWordIndices;
+	uint32_t dirtyCount = 0;
+	// what the figure buffer holds, dirty ranges are packed into it and uploaded from there
+	std::vector<StickFigureInstance> instances;
+
+	void markDirty(FigureId figure);
+	void packRange(FigureId first, FigureId last);
+public:
+	// clean figures between two dirty ones that are uploaded along rather than starting a new copy
+	static const uint32_t MERGE_GAP = 8;
+
+	FigureId add(float positionX, float positionY, float scale, uint32_t pose, uint32_t color);
+	void clear();
+	uint32_t size() const;
+	void setPosition(FigureId figure, float positionX, float positionY);
+	void setScale(FigureId figure, float scale);
+	void setPose(FigureId figure, uint32_t pose);
+	// RGBA8, red in the lowest byte
+	void setColor(FigureId figure, uint32_t color);
+	const float* getPositionsX() const;
+	const float* getPositionsY() const;
+	const float* getScales() const;
+	const uint32_t* getPoses() const;
+	const uint32_t* getColors() const;
+	// after the buffer the figures go to was replaced
+	void markAllDirty();
+	// Uploads every figure changed since the last flush into figureBuffer, which holds a StickFigureInstance per
+	// figure in FigureId order. Allocates nothing once the scene has stopped growing.
+	SceneFlushStats flush(UploadRing* uploadRing, VkBuffer figureBuffer);
+};
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "FrameArena.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#ifdef FRAME_ARENA_CHECKS
+#include <iostream>
+#include <cstdlib>
+#endif
+
+static const size_t ARENA_ALIGNMENT = 64;
+// every allocation starts and ends on this
+static const size_t GRANULE = 16;
+
+static inline size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+#ifdef FRAME_ARENA_CHECKS
+// Right in front of every allocation. The padding an over-aligned allocation leaves before its header is zeroed, so
+// reset can walk the blocks from the start.
+struct BlockHeader {
+    uint64_t size;
+    uint32_t generation;
+    uint32_t magic;
+};
+static const size_t HEADER_SIZE = sizeof(BlockHeader);
+static_assert(sizeof(BlockHeader) == GRANULE, "block headers keep allocations on the granule");
+static const uint32_t LIVE_MAGIC = 0xA7E4A7E4;
+static const uint32_t FREED_MAGIC = 0xF7EEF7EE;
+// right behind every allocation
+static const uint64_t CANARY = 0xFDFDFDFDFDFDFDFDull;
+static const size_t CANARY_SIZE = sizeof(CANARY);
+static const unsigned char POISON = 0xDD;
+
+// for misuse found where nothing may throw, like a container's destructor
+[[noreturn]] static void fail(const char* message)
+{
+    std::cerr << "frame arena: " << message << std::endl;
+    std::abort();
+}
+#else
+static const size_t HEADER_SIZE = 0;
+static const size_t CANARY_SIZE = 0;
+#endif
+
+FrameArena::FrameArena(size_t capacity)
+{
+    this->capacity = alignUp(capacity, GRANULE);
+    this->memory = static_cast<char*>(::operator new(this->capacity, std::align_val_t(ARENA_ALIGNMENT)));
+#ifdef FRAME_ARENA_CHECKS
+    std::memset(this->memory, POISON, this->capacity);
+#endif
+}
+
+FrameArena::~FrameArena()
+{
+    ::operator delete(this->memory, std::align_val_t(ARENA_ALIGNMENT));
+}
+
+bool FrameArena::owns(const void* pointer) const
+{
+    const char* bytes = static_cast<const char*>(pointer);
+    return bytes >= this->memory && bytes < this->memory + this->capacity;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+    // the memory itself is aligned to ARENA_ALIGNMENT, so aligning offsets aligns addresses up to that
+    alignment = std::max(alignment, GRANULE);
+    if (alignment > ARENA_ALIGNMENT) {
+        throw std::runtime_error("frame arena allocations are aligned to at most " + std::to_string(ARENA_ALIGNMENT) + " bytes!");
+    }
+    size_t start = this->used.load(std::memory_order_relaxed);
+    size_t data;
+    size_t end;
+    do {
+        data = alignUp(start + HEADER_SIZE, alignment);
+        end = alignUp(data + bytes + CANARY_SIZE, GRANULE);
+        if (bytes > this->capacity || end > this->capacity) {
+#ifdef FRAME_ARENA_CHECKS
+            throw std::runtime_error("frame arena overflow, " + std::to_string(bytes) + " bytes asked for with "
+                + std::to_string(start) + " of " + std::to_string(this->capacity) + " used!");
+#else
+            this->overflowCount.fetch_add(1, std::memory_order_relaxed);
+            return ::operator new(bytes, std::align_val_t(alignment));
+#endif
+        }
+    } while (!this->used.compare_exchange_weak(start, end, std::memory_order_relaxed));
+
+#ifdef FRAME_ARENA_CHECKS
+    size_t header = data - HEADER_SIZE;
+    std::memset(this->memory + start, 0, header - start);
+    BlockHeader* block = reinterpret_cast<BlockHeader*>(this->memory + header);
+    block->size = bytes;
+    block->generation = (uint32_t)this->generation;
+    block->magic = LIVE_MAGIC;
+    std::memcpy(this->memory + data + bytes, &CANARY, CANARY_SIZE);
+#endif
+    return this->memory + data;
+}
+
+void FrameArena::do_deallocate(void* pointer, [[maybe_unused]] size_t bytes, size_t alignment)
+{
+    if (!this->owns(pointer)) {
+#ifdef FRAME_ARENA_CHECKS
+        fail("freeing memory that did not come from this arena");
+#else
+        // what overflowed to the heap
+        ::operator delete(pointer, std::align_val_t(std::max(alignment, GRANULE)));
+        return;
+#endif
+    }
+#ifdef FRAME_ARENA_CHECKS
+    if ((uintptr_t)pointer % std::max(alignment, GRANULE) != 0) {
+        fail("memory freed with a larger alignment than it was allocated with");
+    }
+    BlockHeader* block = reinterpret_cast<BlockHeader*>(static_cast<char*>(pointer) - HEADER_SIZE);
+    if (block->magic == FREED_MAGIC && block->generation == (uint32_t)this->generation) {
+        fail("memory freed twice");
+    }
+    if (block->magic != LIVE_MAGIC || block->generation != (uint32_t)this->generation || block->size != bytes) {
+        fail("memory freed after the arena it came from was reset");
+    }
+    if (std::memcmp(static_cast<char*>(pointer) + bytes, &CANARY, CANARY_SIZE) != 0) {
+        fail("allocation written past its end");
+    }
+    block->magic = FREED_MAGIC;
+    std::memset(pointer, POISON, bytes);
+#endif
+    // the memory itself comes back with the next reset
+}
+
+bool FrameArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+#ifdef FRAME_ARENA_CHECKS
+bool FrameArena::findOverrun(size_t end, uint64_t& size) const
+{
+    size_t offset = 0;
+    while (offset < end) {
+        const BlockHeader* block = reinterpret_cast<const BlockHeader*>(this->memory + offset);
+        if (block->magic != LIVE_MAGIC && block->magic != FREED_MAGIC) {
+            // padding in front of an over-aligned allocation
+            offset += GRANULE;
+            continue;
+        }
+        size_t data = offset + HEADER_SIZE;
+        // freed blocks were checked when they were freed
+        if (block->magic == LIVE_MAGIC && std::memcmp(this->memory + data + block->size, &CANARY, CANARY_SIZE) != 0) {
+            size = block->size;
+            return true;
+        }
+        offset = alignUp(data + block->size + CANARY_SIZE, GRANULE);
+    }
+    return false;
+}
+#endif
+
+void FrameArena::reset()
+{
+    size_t end = this->used.load(std::memory_order_relaxed);
+    this->highWater = std::max(this->highWater, end);
+#ifdef FRAME_ARENA_CHECKS
+    uint64_t overrunSize = 0;
+    bool overrun = this->findOverrun(end, overrunSize);
+    // whatever still reads through a pointer kept past the reset sees garbage rather than last frame's values
+    std::memset(this->memory, POISON, end);
+#endif
+    this->used.store(0, std::memory_order_relaxed);
+    this->generation++;
+#ifdef FRAME_ARENA_CHECKS
+    if (overrun) {
+        throw std::runtime_error("frame arena allocation of " + std::to_string(overrunSize) + " bytes written past its end!");
+    }
+#endif
+}
+
+size_t FrameArena::getCapacity() const
+{
+    return this->capacity;
+}
+size_t FrameArena::getUsedBytes() const
+{
+    return this->used.load(std::memory_order_relaxed);
+}
+size_t FrameArena::getHighWaterBytes() const
+{
+    return std::max(this->highWater, this->getUsedBytes());
+}
+uint64_t FrameArena::getOverflowCount() const
+{
+    return this->overflowCount.load(std::memory_order_relaxed);
+}
\ No newline at end of file
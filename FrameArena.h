@@ -0,0 +1,56 @@
+#include <memory_resource>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#pragma once
+// MSVC's Debug configurations and `make DEV=1` tag every allocation, poison memory on reset and stop on misuse;
+// release builds only bump a pointer.
+#if defined(_DEBUG) && !defined(FRAME_ARENA_CHECKS)
+#define FRAME_ARENA_CHECKS
+#endif
+// Linear allocator for data that lives at most one frame. Allocating bumps an offset, which is safe from any thread;
+// nothing is freed until reset, which the frame loop calls for a frame's arena once that frame's fence signaled, so
+// memory handed to the GPU or kept by the frame's commands is never reused early. As a std::pmr::memory_resource it
+// backs std::pmr containers: std::pmr::vector<VkBufferMemoryBarrier> barriers(arena).
+// Running out throws with FRAME_ARENA_CHECKS; release builds fall back to the global heap and count it.
+class FrameArena : public std::pmr::memory_resource
+{
+private:
+	char* memory;
+	size_t capacity;
+	std::atomic<size_t> used{ 0 };
+	size_t highWater = 0;
+	std::atomic<uint64_t> overflowCount{ 0 };
+	// bumped by every reset, allocations remember the one they were made in
+	uint64_t generation = 0;
+
+	bool owns(const void* pointer) const;
+#ifdef FRAME_ARENA_CHECKS
+	// the first allocation written past its end
+	bool findOverrun(size_t end, uint64_t& size) const;
+#endif
+protected:
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+public:
+	FrameArena(size_t capacity);
+	~FrameArena();
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+	// Frees everything at once; no other thread may allocate from the arena meanwhile. With FRAME_ARENA_CHECKS it
+	// also fills the memory with garbage and then throws if an allocation was written past its end.
+	void reset();
+	// uninitialized room for count values, only for types that need no destructor
+	template <typename T>
+	T* allocateArray(size_t count) {
+		return static_cast<T*>(this->allocate(count * sizeof(T), alignof(T)));
+	}
+	size_t getCapacity() const;
+	size_t getUsedBytes() const;
+	// the most any frame used so far
+	size_t getHighWaterBytes() const;
+	// allocations that did not fit and went to the heap
+	uint64_t getOverflowCount() const;
+};
\ No newline at end of file
@@ -0,0 +1,34 @@
+#include "FrameGraph.h"
+
+FrameGraph::~FrameGraph()
+{
+    for (Task* task : this->tasks) {
+        delete task;
+    }
+}
+
+Task* FrameGraph::add(std::function<void()> work)
+{
+    Task* task = new Task(std::move(work));
+    this->tasks.push_back(task);
+    return task;
+}
+
+void FrameGraph::run(ThreadPool* threadPool)
+{
+    threadPool->submit(this->tasks.size(), this->tasks.data());
+    std::exception_ptr firstException;
+    for (Task* task : this->tasks) {
+        try {
+            threadPool->wait(*task);
+        }
+        catch (...) {
+            if (!firstException) {
+                firstException = std::current_exception();
+            }
+        }
+    }
+    if (firstException) {
+        std::rethrow_exception(firstException);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#include <vector>
+#include <functional>
+#include "ThreadPool.h"
+
+#pragma once
+// The CPU work of a frame as tasks with dependencies, built once and run on the thread pool every frame: work
+// without a dependency between it runs at the same time, and the calling thread helps until every task finished.
+class FrameGraph
+{
+private:
+	std::vector<Task*> tasks;
+public:
+	~FrameGraph();
+	Task* add(std::function<void()> work);
+	// rethrows the first exception after every task finished
+	void run(ThreadPool* threadPool);
+};
\ No newline at end of file
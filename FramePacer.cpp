@@ -0,0 +1,165 @@
+#include "FramePacer.h"
+#include <thread>
+#include <iostream>
+
+// the last stretch before a limited frame starts is spun instead of slept, sleeps overshoot by about this much
+static const std::chrono::microseconds SPIN_DURATION(1000);
+
+bool parsePresentMode(const std::string& name, VkPresentModeKHR& presentMode)
+{
+    if (name == "immediate") {
+        presentMode = VkPresentModeKHR::VK_PRESENT_MODE_IMMEDIATE_KHR;
+    }
+    else if (name == "mailbox") {
+        presentMode = VkPresentModeKHR::VK_PRESENT_MODE_MAILBOX_KHR;
+    }
+    else if (name == "fifo") {
+        presentMode = VkPresentModeKHR::VK_PRESENT_MODE_FIFO_KHR;
+    }
+    else if (name == "fifo_relaxed") {
+        presentMode = VkPresentModeKHR::VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+const char* presentModeName(VkPresentModeKHR presentMode)
+{
+    switch (presentMode) {
+    case VkPresentModeKHR::VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "immediate";
+    case VkPresentModeKHR::VK_PRESENT_MODE_MAILBOX_KHR:
+        return "mailbox";
+    case VkPresentModeKHR::VK_PRESENT_MODE_FIFO_KHR:
+        return "fifo";
+    case VkPresentModeKHR::VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "fifo_relaxed";
+    default:
+        return "other";
+    }
+}
+
+bool parsePacingPreset(const std::string& name, PacingSettings& settings)
+{
+    if (name == "gameplay") {
+        // lowest latency without tearing, the CPU runs ahead as far as mailbox lets it
+        settings.presentMode = VkPresentModeKHR::VK_PRESENT_MODE_MAILBOX_KHR;
+        settings.framesInFlight = 2;
+        settings.frameRateLimit = 0.0;
+    }
+    else if (name == "battery") {
+        // vsync plus a 30 fps cap, CPU and GPU idle between frames
+        settings.presentMode = VkPresentModeKHR::VK_PRESENT_MODE_FIFO_KHR;
+        settings.framesInFlight = 1;
+        settings.frameRateLimit = 30.0;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+FramePacer::FramePacer(const PacingSettings& settings)
+{
+    this->settings = settings;
+    this->frameHasInput.assign(settings.framesInFlight, false);
+    this->frameInputTimes.resize(settings.framesInFlight);
+}
+
+VkPresentModeKHR FramePacer::choosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) const
+{
+    for (const auto& availablePresentMode : availablePresentModes) {
+        if (availablePresentMode == this->settings.presentMode) {
+            return availablePresentMode;
+        }
+    }
+    std::cout << "present mode " << presentModeName(this->settings.presentMode) << " is not supported, using fifo\n";
+    return VkPresentModeKHR::VK_PRESENT_MODE_FIFO_KHR;
+}
+
+uint32_t FramePacer::getFramesInFlight() const
+{
+    return this->settings.framesInFlight;
+}
+
+void FramePacer::limitFrameRate()
+{
+    if (this->settings.frameRateLimit <= 0.0) {
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    auto frameDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / this->settings.frameRateLimit));
+    if (!this->started || now > this->nextFrameStart + frameDuration) {
+        // first frame, or a long hitch: start counting from now instead of rushing to catch up
+        this->nextFrameStart = now;
+    }
+    if (this->nextFrameStart - now > SPIN_DURATION) {
+        std::this_thread::sleep_until(this->nextFrameStart - SPIN_DURATION);
+    }
+    while (Clock::now() < this->nextFrameStart) {
+        std::this_thread::yield();
+    }
+    this->nextFrameStart += frameDuration;
+}
+
+void FramePacer::onInput()
+{
+    if (!this->inputPending) {
+        this->inputPending = true;
+        this->pendingInputTime = Clock::now();
+    }
+}
+
+void FramePacer::beginFrame(uint32_t frameIndex)
+{
+    Clock::time_point now = Clock::now();
+    if (this->started) {
+        std::chrono::duration<double, std::milli> frameTime = now - this->lastFrameStart;
+        this->frameTimes.addSample(frameTime.count());
+    }
+    this->started = true;
+    this->lastFrameStart = now;
+
+    this->frameHasInput[frameIndex] = this->inputPending;
+    this->frameInputTimes[frameIndex] = this->pendingInputTime;
+    this->inputPending = false;
+}
+
+void FramePacer::cancelFrame(uint32_t frameIndex)
+{
+    if (!this->frameHasInput[frameIndex]) {
+        return;
+    }
+    if (!this->inputPending || this->frameInputTimes[frameIndex] < this->pendingInputTime) {
+        this->inputPending = true;
+        this->pendingInputTime = this->frameInputTimes[frameIndex];
+    }
+    this->frameHasInput[frameIndex] = false;
+}
+
+void FramePacer::presented(uint32_t frameIndex)
+{
+    if (!this->frameHasInput[frameIndex]) {
+        return;
+    }
+    std::chrono::duration<double, std::milli> latency = Clock::now() - this->frameInputTimes[frameIndex];
+    this->latencies.addSample(latency.count());
+    this->frameHasInput[frameIndex] = false;
+}
+
+void FramePacer::report(std::ostream& out) const
+{
+    out << "pacing: " << presentModeName(this->settings.presentMode) << ", " << this->settings.framesInFlight << " frames in flight, ";
+    if (this->settings.frameRateLimit > 0.0) {
+        out << "limited to " << this->settings.frameRateLimit << " fps\n";
+    }
+    else {
+        out << "no frame rate limit\n";
+    }
+    this->frameTimes.report(out, "ms");
+    if (this->latencies.size() > 0) {
+        this->latencies.report(out, "ms");
+    }
+}
\ No newline at end of file
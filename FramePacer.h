@@ -0,0 +1,56 @@
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <ostream>
+#include "Benchmark.h"
+
+#pragma once
+struct PacingSettings {
+	VkPresentModeKHR presentMode = VkPresentModeKHR::VK_PRESENT_MODE_MAILBOX_KHR;
+	uint32_t framesInFlight = 2;
+	// frames per second the CPU limiter holds the loop to, 0 leaves pacing to the present mode
+	double frameRateLimit = 0.0;
+};
+// Parses immediate, mailbox, fifo or fifo_relaxed; returns false for anything else.
+bool parsePresentMode(const std::string& name, VkPresentModeKHR& presentMode);
+const char* presentModeName(VkPresentModeKHR presentMode);
+// Parses the named setting presets (gameplay, battery) into settings; returns false for unknown names.
+bool parsePacingPreset(const std::string& name, PacingSettings& settings);
+
+// Frame pacing policy and its measurements: picks the present mode, holds the CPU to the frame rate limit and keeps
+// rolling histograms of frame times and input-to-present latency. Everything runs on the main thread.
+// Latency is taken from the earliest input event a frame picked up to the return of its vkQueuePresentKHR, the
+// presentation engine's own queue comes on top of it.
+class FramePacer
+{
+private:
+	typedef std::chrono::steady_clock Clock;
+	PacingSettings settings;
+	Clock::time_point nextFrameStart;
+	Clock::time_point lastFrameStart;
+	bool started = false;
+	bool inputPending = false;
+	Clock::time_point pendingInputTime;
+	// per frame in flight, the input the frame being recorded in it picked up
+	std::vector<bool> frameHasInput;
+	std::vector<Clock::time_point> frameInputTimes;
+	RollingHistogram frameTimes{ "frame time", 0.5, 100, 1000 };
+	RollingHistogram latencies{ "input-to-present latency", 1.0, 100, 1000 };
+public:
+	static const uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+	FramePacer(const PacingSettings& settings);
+	// the requested mode when the surface supports it, FIFO otherwise since every surface has it
+	VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) const;
+	uint32_t getFramesInFlight() const;
+	// sleeps until the next frame may start when a limit is set; call before polling input so it stays fresh
+	void limitFrameRate();
+	void onInput();
+	// marks the start of the frame that will be recorded into frameIndex and hands it the pending input
+	void beginFrame(uint32_t frameIndex);
+	// the frame started in frameIndex will not be presented, its input goes to the next frame instead
+	void cancelFrame(uint32_t frameIndex);
+	void presented(uint32_t frameIndex);
+	void report(std::ostream& out) const;
+};
\ No newline at end of file
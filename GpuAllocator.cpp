@@ -0,0 +1,225 @@
+#include "GpuAllocator.h"
+#include "Counters.h"
+#include <stdexcept>
+#include <algorithm>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+GpuAllocator::GpuAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize preferredBlockSize)
+{
+    this->device = device;
+    this->preferredBlockSize = preferredBlockSize;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &this->memoryProperties);
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    this->maxAllocationCount = deviceProperties.limits.maxMemoryAllocationCount;
+
+    // one pool per memory type and resource kind
+    this->pools.resize(this->memoryProperties.memoryTypeCount * 2);
+}
+
+GpuAllocator::~GpuAllocator()
+{
+    for (auto& pool : this->pools) {
+        for (auto& block : pool) {
+            this->destroyBlock(block);
+        }
+    }
+}
+
+const VkPhysicalDeviceMemoryProperties& GpuAllocator::getMemoryProperties()
+{
+    return this->memoryProperties;
+}
+
+uint32_t GpuAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+    for (uint32_t i = 0; i < this->memoryProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (this->memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+GpuAllocator::Block& GpuAllocator::createBlock(uint32_t memoryTypeIndex, GpuResourceKind kind, VkDeviceSize size)
+{
+    if (this->liveBlocks >= this->maxAllocationCount) {
+        throw std::runtime_error("failed to allocate memory block: maxMemoryAllocationCount reached!");
+    }
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    Block block{};
+    block.id = this->nextBlockId++;
+    block.size = size;
+    if (vkAllocateMemory(this->device, &allocInfo, nullptr, &block.memory) != VkResult::VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate memory block!");
+    }
+    this->deviceAllocationCalls++;
+    this->liveBlocks++;
+    Counters::add(Counter::DeviceAllocations);
+
+    if (this->memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(this->device, block.memory, 0, size, 0, &block.mappedData) != VkResult::VK_SUCCESS) {
+            vkFreeMemory(this->device, block.memory, nullptr);
+            this->liveBlocks--;
+            throw std::runtime_error("failed to map memory block!");
+        }
+    }
+    block.freeRanges.push_back({ 0, size });
+
+    auto& pool = this->pools[memoryTypeIndex * 2 + (kind == GpuResourceKind::Optimal ? 1 : 0)];
+    pool.push_back(block);
+    return pool.back();
+}
+
+void GpuAllocator::destroyBlock(Block& block)
+{
+    if (block.mappedData) {
+        vkUnmapMemory(this->device, block.memory);
+    }
+    vkFreeMemory(this->device, block.memory, nullptr);
+    this->liveBlocks--;
+}
+
+// first fit over the offset-sorted free list
+bool GpuAllocator::allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, GpuAllocation& allocation)
+{
+    for (size_t rangeIndex = 0; rangeIndex < block.freeRanges.size(); rangeIndex++) {
+        FreeRange range = block.freeRanges[rangeIndex];
+        VkDeviceSize alignedOffset = alignUp(range.offset, alignment);
+        if (alignedOffset + size > range.offset + range.size) {
+            continue;
+        }
+        // the alignment padding in front stays free, only the tail range is split off
+        VkDeviceSize tailOffset = alignedOffset + size;
+        VkDeviceSize tailSize = range.offset + range.size - tailOffset;
+        if (alignedOffset > range.offset) {
+            block.freeRanges[rangeIndex].size = alignedOffset - range.offset;
+            if (tailSize > 0) {
+                block.freeRanges.insert(block.freeRanges.begin() + rangeIndex + 1, { tailOffset, tailSize });
+            }
+        }
+        else if (tailSize > 0) {
+            block.freeRanges[rangeIndex] = { tailOffset, tailSize };
+        }
+        else {
+            block.freeRanges.erase(block.freeRanges.begin() + rangeIndex);
+        }
+
+        allocation.memory = block.memory;
+        allocation.offset = alignedOffset;
+        allocation.size = size;
+        allocation.mappedData = block.mappedData ? static_cast<char*>(block.mappedData) + alignedOffset : nullptr;
+        allocation.blockId = block.id;
+        block.allocationCount++;
+        return true;
+    }
+    return false;
+}
+
+GpuAllocation GpuAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, GpuResourceKind kind)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    uint32_t memoryTypeIndex = this->findMemoryType(requirements.memoryTypeBits, properties);
+    uint32_t poolIndex = memoryTypeIndex * 2 + (kind == GpuResourceKind::Optimal ? 1 : 0);
+    VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+
+    GpuAllocation allocation{};
+    allocation.poolIndex = poolIndex;
+    for (auto& block : this->pools[poolIndex]) {
+        if (this->allocateFromBlock(block, requirements.size, alignment, allocation)) {
+            return allocation;
+        }
+    }
+
+    // resources bigger than half a block get a block of their own instead of wasting the rest of a shared one
+    VkDeviceSize heapSize = this->memoryProperties.memoryHeaps[this->memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+    VkDeviceSize blockSize = std::min(this->preferredBlockSize, std::max<VkDeviceSize>(heapSize / 8, 1));
+    if (requirements.size > blockSize / 2) {
+        blockSize = requirements.size;
+    }
+    Block& block = this->createBlock(memoryTypeIndex, kind, blockSize);
+    if (!this->allocateFromBlock(block, requirements.size, alignment, allocation)) {
+        throw std::runtime_error("failed to sub-allocate from a fresh memory block!");
+    }
+    return allocation;
+}
+
+void GpuAllocator::free(GpuAllocation& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto& pool = this->pools[allocation.poolIndex];
+    auto block = std::find_if(pool.begin(), pool.end(), [&](const Block& candidate) { return candidate.id == allocation.blockId; });
+    if (block == pool.end()) {
+        throw std::runtime_error("failed to free memory: allocation does not belong to this allocator!");
+    }
+
+    // put the range back in offset order and merge it with free neighbours
+    auto& ranges = block->freeRanges;
+    auto next = std::lower_bound(ranges.begin(), ranges.end(), allocation.offset, [](const FreeRange& range, VkDeviceSize offset) { return range.offset < offset; });
+    auto inserted = ranges.insert(next, { allocation.offset, allocation.size });
+    if (inserted + 1 != ranges.end() && inserted->offset + inserted->size == (inserted + 1)->offset) {
+        inserted->size += (inserted + 1)->size;
+        ranges.erase(inserted + 1);
+    }
+    if (inserted != ranges.begin() && (inserted - 1)->offset + (inserted - 1)->size == inserted->offset) {
+        (inserted - 1)->size += inserted->size;
+        ranges.erase(inserted);
+    }
+    block->allocationCount--;
+
+    // keep one empty block per pool around so alternating allocate/free does not hit vkAllocateMemory every time
+    if (block->allocationCount == 0) {
+        size_t emptyBlocks = std::count_if(pool.begin(), pool.end(), [](const Block& candidate) { return candidate.allocationCount == 0; });
+        if (emptyBlocks > 1) {
+            this->destroyBlock(*block);
+            pool.erase(block);
+        }
+    }
+    allocation = {};
+}
+
+GpuAllocatorStats GpuAllocator::getStats()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    GpuAllocatorStats stats{};
+    stats.deviceAllocationCalls = this->deviceAllocationCalls;
+    for (const auto& pool : this->pools) {
+        for (const auto& block : pool) {
+            stats.blockCount++;
+            stats.allocationCount += block.allocationCount;
+            stats.allocatedBytes += block.size;
+            for (const auto& range : block.freeRanges) {
+                stats.freeBytes += range.size;
+                stats.largestFreeRange = std::max(stats.largestFreeRange, range.size);
+            }
+        }
+    }
+    stats.usedBytes = stats.allocatedBytes - stats.freeBytes;
+    if (stats.freeBytes > 0) {
+        stats.fragmentation = 1.0 - (double)stats.largestFreeRange / stats.freeBytes;
+    }
+    return stats;
+}
+
+void GpuAllocator::printStats(std::ostream& out)
+{
+    GpuAllocatorStats stats = this->getStats();
+    out << "gpu memory: " << stats.allocationCount << " allocations in " << stats.blockCount << " blocks, "
+        << stats.usedBytes << " of " << stats.allocatedBytes << " bytes used, "
+        << "fragmentation " << stats.fragmentation << ", "
+        << stats.deviceAllocationCalls << " vkAllocateMemory calls (limit " << this->maxAllocationCount << ")\n";
+}
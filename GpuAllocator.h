@@ -0,0 +1,72 @@
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <mutex>
+#include <ostream>
+
+#pragma once
+// Buffers and linear images never share a block with optimally tiled images. That keeps neighbouring
+// sub-allocations of different kinds apart, so bufferImageGranularity never has to be padded in.
+enum class GpuResourceKind {
+	Linear,
+	Optimal
+};
+struct GpuAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	// host visible blocks stay mapped for their whole lifetime, since one VkDeviceMemory can only be mapped once
+	void* mappedData = nullptr;
+	uint32_t poolIndex = 0;
+	uint32_t blockId = 0;
+};
+struct GpuAllocatorStats {
+	VkDeviceSize allocatedBytes = 0;
+	VkDeviceSize usedBytes = 0;
+	VkDeviceSize freeBytes = 0;
+	VkDeviceSize largestFreeRange = 0;
+	size_t blockCount = 0;
+	size_t allocationCount = 0;
+	size_t deviceAllocationCalls = 0;
+	// 0 when all free space is one range, approaching 1 when it is scattered in small pieces
+	double fragmentation = 0.0;
+};
+class GpuAllocator
+{
+private:
+	struct FreeRange {
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+	struct Block {
+		uint32_t id;
+		VkDeviceMemory memory;
+		VkDeviceSize size;
+		void* mappedData;
+		std::vector<FreeRange> freeRanges;
+		size_t allocationCount;
+	};
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	VkDeviceSize preferredBlockSize;
+	uint32_t maxAllocationCount;
+	std::vector<std::vector<Block>> pools;
+	uint32_t nextBlockId = 0;
+	// every vkAllocateMemory so far, for the stats
+	size_t deviceAllocationCalls = 0;
+	// blocks alive right now, what maxMemoryAllocationCount limits
+	size_t liveBlocks = 0;
+	std::mutex mutex;
+
+	Block& createBlock(uint32_t memoryTypeIndex, GpuResourceKind kind, VkDeviceSize size);
+	bool allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, GpuAllocation& allocation);
+	void destroyBlock(Block& block);
+public:
+	GpuAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize preferredBlockSize = 32 * 1024 * 1024);
+	~GpuAllocator();
+	const VkPhysicalDeviceMemoryProperties& getMemoryProperties();
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	GpuAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, GpuResourceKind kind);
+	void free(GpuAllocation& allocation);
+	GpuAllocatorStats getStats();
+	void printStats(std::ostream& out);
+};
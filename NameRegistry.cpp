@@ -0,0 +1,29 @@
+#include "NameRegistry.h"
+
+uint32_t NameRegistry::intern(std::string_view name)
+{
+    auto existing = this->ids.find(name);
+    if (existing != this->ids.end()) {
+        return existing->second;
+    }
+    uint32_t id = (uint32_t)this->names.size();
+    this->names.emplace_back(name);
+    this->ids.emplace(this->names.back(), id);
+    return id;
+}
+
+uint32_t NameRegistry::find(std::string_view name) const
+{
+    auto existing = this->ids.find(name);
+    return existing != this->ids.end() ? existing->second : INVALID_ID;
+}
+
+const std::string& NameRegistry::getName(uint32_t id) const
+{
+    return this->names.at(id);
+}
+
+size_t NameRegistry::size() const
+{
+    return this->names.size();
+}
\ No newline at end of file
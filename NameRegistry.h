@@ -0,0 +1,28 @@
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+
+#pragma once
+// Interns names into dense ids 0..size()-1 in the order they were first seen.
+// Name lookups are meant for setup code, anything running per draw or per frame keeps the ids. They take string views,
+// so a name passed as a const char* is looked up without copying it into a std::string first.
+class NameRegistry
+{
+private:
+	// keys view the names below, which a deque never moves
+	std::unordered_map<std::string_view, uint32_t> ids;
+	std::deque<std::string> names;
+public:
+	static const uint32_t INVALID_ID = UINT32_MAX;
+	NameRegistry() = default;
+	NameRegistry(const NameRegistry&) = delete;
+	NameRegistry& operator=(const NameRegistry&) = delete;
+	// returns the id the name already has, or the next free one
+	uint32_t intern(std::string_view name);
+	// returns INVALID_ID for names that were never interned
+	uint32_t find(std::string_view name) const;
+	const std::string& getName(uint32_t id) const;
+	size_t size() const;
+};
\ No newline at end of file
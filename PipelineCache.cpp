@@ -0,0 +1,127 @@
+#include "PipelineCache.h"
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const uint32_t PIPELINE_CACHE_MAGIC = 0x43504753; // "SGPC"
+static const uint32_t PIPELINE_CACHE_FILE_VERSION = 1;
+
+PipelineCache::PipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, const std::string path, bool ignoreFile)
+{
+    this->device = device;
+    this->path = path;
+    vkGetPhysicalDeviceProperties(physicalDevice, &this->deviceProperties);
+
+    std::string initialData;
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!ignoreFile && file.is_open()) {
+        size_t fileSize = (size_t)file.tellg();
+        FileHeader header{};
+        file.seekg(0);
+        if (fileSize >= sizeof(header) && file.read(reinterpret_cast<char*>(&header), sizeof(header)) && header.dataSize == fileSize - sizeof(header)) {
+            initialData.resize(fileSize - sizeof(header));
+            file.read(&initialData[0], initialData.size());
+        }
+        if (!file || !this->isCompatible(header, initialData)) {
+            std::cout << "pipeline cache " << path << " is stale or corrupted, starting cold\n";
+            initialData.clear();
+        }
+    }
+    file.close();
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = initialData.size();
+    cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+    if (vkCreatePipelineCache(this->device, &cacheInfo, nullptr, &this->cache) != VkResult::VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+}
+
+PipelineCache::~PipelineCache()
+{
+    vkDestroyPipelineCache(this->device, this->cache, nullptr);
+}
+
+VkPipelineCache PipelineCache::get()
+{
+    return this->cache;
+}
+
+PipelineCache::FileHeader PipelineCache::makeHeader()
+{
+    FileHeader header{};
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.fileVersion = PIPELINE_CACHE_FILE_VERSION;
+    header.vendorID = this->deviceProperties.vendorID;
+    header.deviceID = this->deviceProperties.deviceID;
+    header.driverVersion = this->deviceProperties.driverVersion;
+    memcpy(header.pipelineCacheUUID, this->deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+bool PipelineCache::isCompatible(const FileHeader& header, const std::string& data)
+{
+    FileHeader expected = this->makeHeader();
+    if (header.magic != expected.magic || header.fileVersion != expected.fileVersion
+        || header.vendorID != expected.vendorID || header.deviceID != expected.deviceID
+        || header.driverVersion != expected.driverVersion
+        || memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        return false;
+    }
+
+    // the driver checks its own header too, but a mismatch there is silently ignored instead of reported
+    VkPipelineCacheHeaderVersionOne driverHeader;
+    if (data.size() < sizeof(driverHeader)) {
+        return false;
+    }
+    memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+    return driverHeader.headerVersion == VkPipelineCacheHeaderVersion::VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && driverHeader.vendorID == expected.vendorID
+        && driverHeader.deviceID == expected.deviceID
+        && memcmp(driverHeader.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+bool PipelineCache::isWarm()
+{
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(this->device, this->cache, &dataSize, nullptr) != VkResult::VK_SUCCESS) {
+        return false;
+    }
+    return dataSize > sizeof(VkPipelineCacheHeaderVersionOne);
+}
+
+void PipelineCache::save()
+{
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(this->device, this->cache, &dataSize, nullptr) != VkResult::VK_SUCCESS) {
+        throw std::runtime_error("failed to get pipeline cache data!");
+    }
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(this->device, this->cache, &dataSize, data.data()) != VkResult::VK_SUCCESS) {
+        throw std::runtime_error("failed to get pipeline cache data!");
+    }
+
+    FileHeader header = this->makeHeader();
+    header.dataSize = dataSize;
+
+    // write next to the real file first so an interrupted save never leaves a truncated cache behind
+    std::string temporaryPath = this->path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cout << "failed to write pipeline cache " << temporaryPath << '\n';
+            return;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), dataSize);
+    }
+    std::remove(this->path.c_str());
+    if (std::rename(temporaryPath.c_str(), this->path.c_str()) != 0) {
+        std::cout << "failed to replace pipeline cache " << this->path << '\n';
+    }
+}
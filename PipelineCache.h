@@ -0,0 +1,32 @@
+#include <vulkan/vulkan.h>
+#include <string>
+
+#pragma once
+// VkPipelineCache that outlives PipelineManager instances and is persisted between runs.
+// The file is only reused when it was written by the same device and driver build.
+class PipelineCache
+{
+private:
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t fileVersion;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+	};
+	VkDevice device;
+	VkPipelineCache cache;
+	VkPhysicalDeviceProperties deviceProperties;
+	std::string path;
+
+	FileHeader makeHeader();
+	bool isCompatible(const FileHeader& header, const std::string& data);
+public:
+	PipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, const std::string path, bool ignoreFile);
+	~PipelineCache();
+	VkPipelineCache get();
+	bool isWarm();
+	void save();
+};
@@ -1,20 +1,21 @@
-#include "CircleVertexInput.h"
 #include "PipelineManager.h"
+#include "Counters.h"
+#include "AllocationCounter.h"
 #include <stdexcept>
 #include <iostream>
-#include <fstream>
 #include "VertexInput.h"
-#include "CreateCommandPool.h"
 #include "Families.h"
-#ifdef __linux__
-    #include <cstring>
-#endif
-VkShaderModule PipelineManager::createShaderModule(const std::vector<char>& code)
+#include "CreateCommandPool.h"
+#include "ShaderCode.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+VkShaderModule PipelineManager::createShaderModule(const uint32_t* code, size_t size)
 {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    createInfo.codeSize = size;
+    createInfo.pCode = code;
 
     VkShaderModule shaderModule;
     if (vkCreateShaderModule(this->device, &createInfo, nullptr, &shaderModule) != VkResult::VK_SUCCESS) {
@@ -24,39 +25,138 @@ VkShaderModule PipelineManager::createShaderModule(const std::vector<char>& code
     return shaderModule;
 }
 
-std::vector<char> PipelineManager::readFile(const std::string& filename)
+// What a VkGraphicsPipelineCreateInfo points to besides its shared PipelineStateBlock, kept alive until the batched
+// vkCreateGraphicsPipelines calls return. The vertex input descriptions point straight into the static VertexLayout
+// data and the specialization data into the create info.
+struct PipelineStateStorage {
+    VkPipelineShaderStageCreateInfo shaderStages[2];
+    VkSpecializationInfo specialization;
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo;
+};
+// Working arrays of createPipelines, buildPipelines and getShaderModules. They are cleared, never shrunk, so a batch no
+// bigger than an earlier one made with the same scratch allocates nothing.
+struct PipelineBuildScratch {
+    std::vector<const char*> shaderPaths;
+    std::vector<uint32_t> stageShaderIndices;
+    std::vector<VkShaderModule> shaderModules;
+    std::vector<uint64_t> shaderHashes;
+    // code without a module yet, kept mapped until its module is created
+    std::vector<ShaderCode> newCodes;
+    std::vector<uint64_t> newHashes;
+    std::vector<VkShaderModule> newModules;
+    // one block per distinct state in the batch
+    std::vector<PipelineState> uniqueStates;
+    std::vector<uint64_t> uniqueStateHashes;
+    std::vector<PipelineStateBlock> stateBlocks;
+    std::vector<uint32_t> stateBlockIndices;
+    std::vector<PipelineStateStorage> states;
+    std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos;
+    std::vector<VkPipeline> pipelines;
+    // createPipelines: the variant of every create info and the infos of the variants to build
+    std::vector<uint32_t> infoVariants;
+    std::vector<PipelineCreateInfo> variantInfos;
+    std::vector<uint32_t> builtVariants;
+};
+// Constant i is the i-th uint32_t of PipelineCreateInfo::specializationConstants.
+static const VkSpecializationMapEntry SPECIALIZATION_MAP_ENTRIES[MAX_SPECIALIZATION_CONSTANTS] = {
+    { 0, 0, sizeof(uint32_t) },
+    { 1, sizeof(uint32_t), sizeof(uint32_t) },
+    { 2, 2 * sizeof(uint32_t), sizeof(uint32_t) },
+    { 3, 3 * sizeof(uint32_t), sizeof(uint32_t) },
+};
+
+static uint64_t mixHash(uint64_t hash, const void* data, size_t size)
 {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+// Hashes everything that ends up in the VkPipeline, which leaves out the name and the vertex buffer size.
+static uint64_t getVariantKey(const PipelineCreateInfo& createInfo)
+{
+    uint64_t key = createInfo.state.hash();
+    key = mixHash(key, createInfo.vertexShaderModule, strlen(createInfo.vertexShaderModule) + 1);
+    key = mixHash(key, createInfo.fragmentShaderModule, strlen(createInfo.fragmentShaderModule) + 1);
+    const void* layout[] = { createInfo.input ? createInfo.input->binding : nullptr, createInfo.input ? createInfo.input->attributes : nullptr };
+    key = mixHash(key, layout, sizeof(layout));
+    key = mixHash(key, &createInfo.specializationCount, sizeof(uint32_t));
+    return mixHash(key, createInfo.specializationConstants, createInfo.specializationCount * sizeof(uint32_t));
+}
 
-    if (!file.is_open()) {
-        throw std::runtime_error("failed to open file!");
+// Resolves each path to a module, creating modules only for code no earlier path or batch had.
+void PipelineManager::getShaderModules(size_t pathCount, const char* const* paths, VkShaderModule* modules, bool parallel, PipelineBuildScratch& scratch)
+{
+    // background rebuilds share the cache with the main thread
+    std::lock_guard<std::mutex> lock(this->shaderModulesMutex);
+    scratch.shaderHashes.resize(pathCount);
+    scratch.newCodes.clear();
+    scratch.newHashes.clear();
+    for (size_t pathIndex = 0; pathIndex < pathCount; pathIndex++) {
+        ShaderCode code(paths[pathIndex]);
+        uint64_t hash = code.hash();
+        scratch.shaderHashes[pathIndex] = hash;
+        auto cached = this->shaderModules.find(hash);
+        if (cached != this->shaderModules.end()) {
+            modules[pathIndex] = cached->second;
+            continue;
+        }
+        modules[pathIndex] = VK_NULL_HANDLE;
+        if (std::find(scratch.newHashes.begin(), scratch.newHashes.end(), hash) == scratch.newHashes.end()) {
+            scratch.newCodes.push_back(std::move(code));
+            scratch.newHashes.push_back(hash);
+        }
+    }
+    if (scratch.newCodes.empty()) {
+        return;
     }
-    size_t fileSize = (size_t)file.tellg();
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
 
-    return buffer;
+    scratch.newModules.assign(scratch.newCodes.size(), VK_NULL_HANDLE);
+    this->forEach(scratch.newCodes.size(), [this, &scratch](size_t codeIndex) {
+        scratch.newModules[codeIndex] = this->createShaderModule(scratch.newCodes[codeIndex].getCode(), scratch.newCodes[codeIndex].getSize());
+    }, parallel);
+    for (size_t codeIndex = 0; codeIndex < scratch.newCodes.size(); codeIndex++) {
+        this->shaderModules[scratch.newHashes[codeIndex]] = scratch.newModules[codeIndex];
+    }
+    scratch.newCodes.clear();
+    for (size_t pathIndex = 0; pathIndex < pathCount; pathIndex++) {
+        if (modules[pathIndex] == VK_NULL_HANDLE) {
+            modules[pathIndex] = this->shaderModules[scratch.shaderHashes[pathIndex]];
+        }
+    }
 }
 
-PipelineManager::PipelineManager(VkPhysicalDevice physicalDevice, VkDevice device, VkRenderPass renderPass, uint32_t transferFamilyIndex, uint32_t graphicsFamilyIndex)
+PipelineManager::PipelineManager(VkPhysicalDevice physicalDevice, VkDevice device, VkRenderPass renderPass, VkPipelineCache pipelineCache, ThreadPool* threadPool, GpuAllocator* allocator, uint32_t transferFamilyIndex, uint32_t graphicsFamilyIndex, bool drawIndirectCount)
 {
 	this->device = device;
     this->renderPass = renderPass;
+    this->pipelineCache = pipelineCache;
+    this->threadPool = threadPool;
+    this->allocator = allocator;
     this->physicalDevice = physicalDevice;
     this->transferFamilyIndex = transferFamilyIndex;
     this->graphicsFamilyIndex = graphicsFamilyIndex;
+    this->drawIndirectCount = drawIndirectCount;
 
-    createCommandPool(this->device, transferFamilyIndex, &this->transferCommandPool);
-    vkGetDeviceQueue(this->device, transferFamilyIndex, 0, &this->transferQueue);
+    VkQueue transferQueue;
+    vkGetDeviceQueue(this->device, transferFamilyIndex, 0, &transferQueue);
+    this->uploadRing = new UploadRing(this->device, this->allocator, transferQueue, transferFamilyIndex, graphicsFamilyIndex);
+    this->buildScratch = new PipelineBuildScratch();
+    createCommandPool(this->device, graphicsFamilyIndex, &this->staticCommandPool, VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+
+    // shaders that measure in pixels, like shaders/segment.vert, read the pixel size from here
+    VkPushConstantRange viewportRange{};
+    viewportRange.stageFlags = VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT;
+    viewportRange.offset = 0;
+    viewportRange.size = sizeof(ViewportConstants);
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = 0; // Optional
     pipelineLayoutInfo.pSetLayouts = nullptr; // Optional
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &viewportRange;
 
     if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &this->pipelineLayout) != VkResult::VK_SUCCESS) {
         throw std::runtime_error("failed to create pipeline layout!");
@@ -66,282 +166,518 @@ PipelineManager::PipelineManager(VkPhysicalDevice physicalDevice, VkDevice devic
 
 PipelineManager::~PipelineManager()
 {
-    for (const auto& pipeline : this->pipelines) {
-        vkDestroyPipeline(this->device, pipeline.second, nullptr);
-        if (this->vertexBuffers[pipeline.first]) {
-            vkDestroyBuffer(this->device, this->vertexBuffers[pipeline.first], nullptr);
-            vkFreeMemory(this->device, this->vertexBufferMemories[pipeline.first], nullptr);
-            vkDestroyBuffer(this->device, this->stagingBuffers[pipeline.first], nullptr);
-            vkFreeMemory(this->device, this->stagingBufferMemories[pipeline.first], nullptr);
-        }
+    if (this->rebuildThread.joinable()) {
+        this->rebuildThread.join();
+    }
+    for (const auto& rebuilt : this->rebuiltPipelines) {
+        vkDestroyPipeline(this->device, rebuilt.pipeline, nullptr);
+    }
+    for (const auto& retired : this->retiredPipelines) {
+        vkDestroyPipeline(this->device, retired.pipeline, nullptr);
+    }
+    for (VkPipeline pipeline : this->pipelines) {
+        vkDestroyPipeline(this->device, pipeline, nullptr);
+    }
+    for (PipelineHandle pipeline = 0; pipeline < this->vertexBuffers.size(); pipeline++) {
+        this->destroyVertexBuffer(pipeline);
+    }
+    for (PipelineHandle pipeline = 0; pipeline < this->computePipelines.size(); pipeline++) {
+        this->destroyComputePipeline(pipeline);
+    }
+    for (const auto& shaderModule : this->shaderModules) {
+        vkDestroyShaderModule(this->device, shaderModule.second, nullptr);
     }
     vkDestroyPipelineLayout(this->device, this->pipelineLayout, nullptr);
-    vkDestroyCommandPool(this->device, this->transferCommandPool, nullptr);
+    delete this->uploadRing;
+    delete this->buildScratch;
+    vkDestroyCommandPool(this->device, this->staticCommandPool, nullptr);
+}
+void PipelineManager::destroyVertexBuffer(PipelineHandle pipeline)
+{
+    if (this->vertexBuffers[pipeline]) {
+        vkDestroyBuffer(this->device, this->vertexBuffers[pipeline], nullptr);
+        this->allocator->free(this->vertexBufferMemories[pipeline]);
+    }
+    this->vertexBuffers[pipeline] = VK_NULL_HANDLE;
+}
+void PipelineManager::destroyComputePipeline(PipelineHandle pipeline)
+{
+    ComputePipeline& computePipeline = this->computePipelines[pipeline];
+    vkDestroyPipeline(this->device, computePipeline.pipeline, nullptr);
+    vkDestroyPipelineLayout(this->device, computePipeline.layout, nullptr);
+    vkDestroyDescriptorPool(this->device, computePipeline.descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(this->device, computePipeline.setLayout, nullptr);
+    computePipeline = {};
 }
 
-void PipelineManager::createPipelines(size_t infosCount, PipelineCreateInfo* createInfos)
+void PipelineManager::fillPipelineInfo(const PipelineCreateInfo& createInfo, VkShaderModule vertShaderModule, VkShaderModule fragShaderModule, const PipelineStateBlock& stateBlock, PipelineStateStorage& state, VkGraphicsPipelineCreateInfo& pipelineInfo)
 {
-    std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos;
-    pipelineInfos.resize(infosCount);
-    std::vector<VkShaderModule> shaderModules;
-    shaderModules.resize(infosCount * 2);
+    VkSpecializationInfo& specialization = state.specialization;
+    specialization = {};
+    specialization.mapEntryCount = createInfo.specializationCount;
+    specialization.pMapEntries = SPECIALIZATION_MAP_ENTRIES;
+    specialization.dataSize = createInfo.specializationCount * sizeof(uint32_t);
+    specialization.pData = createInfo.specializationConstants;
 
-    for (size_t infoIndex = 0; infoIndex < infosCount; infoIndex++) {
+    VkPipelineShaderStageCreateInfo& vertShaderStageInfo = state.shaderStages[0];
+    vertShaderStageInfo = {};
+    vertShaderStageInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = vertShaderModule;
+    vertShaderStageInfo.pName = "main";
+    vertShaderStageInfo.pSpecializationInfo = createInfo.specializationCount > 0 ? &specialization : nullptr;
+
+    VkPipelineShaderStageCreateInfo& fragShaderStageInfo = state.shaderStages[1];
+    fragShaderStageInfo = {};
+    fragShaderStageInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragShaderStageInfo.stage = VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragShaderStageInfo.module = fragShaderModule;
+    fragShaderStageInfo.pName = "main";
+    fragShaderStageInfo.pSpecializationInfo = vertShaderStageInfo.pSpecializationInfo;
 
-        auto vertShaderCode = this->readFile(createInfos[infoIndex].vertexShaderModule);
-        auto fragShaderCode = this->readFile(createInfos[infoIndex].fragmentShaderModule);
-
-        shaderModules[infoIndex * 2] = createShaderModule(vertShaderCode);
-        shaderModules[infoIndex * 2 + 1] = createShaderModule(fragShaderCode);
-
-        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-        vertShaderStageInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vertShaderStageInfo.stage = VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT;
-        vertShaderStageInfo.module = shaderModules[infoIndex * 2];
-        vertShaderStageInfo.pName = "main";
-
-        VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-        fragShaderStageInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        fragShaderStageInfo.stage = VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragShaderStageInfo.module = shaderModules[infoIndex * 2 + 1];
-        fragShaderStageInfo.pName = "main";
-
-        VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-        vertexInputInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        VkVertexInputBindingDescription vertexInputBindingDesc;
-        if (createInfos[infoIndex].input) {
-            vertexInputBindingDesc = createInfos[infoIndex].input->getBindingDescription();
-            auto vertexInputAttributeDescs = createInfos[infoIndex].input->getAttributeDescriptions();
-            VkVertexInputAttributeDescription* vertexInputAttributeDescsMem = (VkVertexInputAttributeDescription*)malloc(sizeof(VkVertexInputAttributeDescription) * vertexInputAttributeDescs.size());
-            if (vertexInputAttributeDescsMem != 0) {
-                memcpy(vertexInputAttributeDescsMem, vertexInputAttributeDescs.data(), sizeof(VkVertexInputAttributeDescription) * vertexInputAttributeDescs.size());
+    VkPipelineVertexInputStateCreateInfo& vertexInputInfo = state.vertexInputInfo;
+    vertexInputInfo = {};
+    vertexInputInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    if (createInfo.input) {
+        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.pVertexBindingDescriptions = createInfo.input->binding; // Optional
+        vertexInputInfo.vertexAttributeDescriptionCount = createInfo.input->attributeCount;
+        vertexInputInfo.pVertexAttributeDescriptions = createInfo.input->attributes;
+    }
+    else {
+        vertexInputInfo.vertexBindingDescriptionCount = 0;
+        vertexInputInfo.pVertexBindingDescriptions = nullptr; // Optional
+        vertexInputInfo.vertexAttributeDescriptionCount = 0;
+        vertexInputInfo.pVertexAttributeDescriptions = nullptr; // Optional
+    }
+
+    pipelineInfo = {};
+    pipelineInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = state.shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &stateBlock.inputAssembly;
+    pipelineInfo.pViewportState = &stateBlock.viewportState;
+    pipelineInfo.pRasterizationState = &stateBlock.rasterizer;
+    pipelineInfo.pMultisampleState = &stateBlock.multisampling;
+    pipelineInfo.pDepthStencilState = nullptr; // Optional
+    pipelineInfo.pColorBlendState = &stateBlock.colorBlending;
+    pipelineInfo.pDynamicState = &stateBlock.dynamicStateInfo;
+    pipelineInfo.layout = this->pipelineLayout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+    pipelineInfo.basePipelineIndex = -1; // Optional
+}
+
+void PipelineManager::buildPipelines(size_t infosCount, const PipelineCreateInfo* createInfos, VkPipeline* pipelines, bool parallel, PipelineBuildScratch& scratch)
+{
+    // Pipelines in one batch often share shaders, so every path is looked up only once. Batches use a handful of
+    // shaders, a linear search finds them faster than hashing the paths would.
+    scratch.shaderPaths.clear();
+    scratch.stageShaderIndices.resize(infosCount * 2);
+    for (size_t infoIndex = 0; infoIndex < infosCount; infoIndex++) {
+        const char* stagePaths[] = { createInfos[infoIndex].vertexShaderModule, createInfos[infoIndex].fragmentShaderModule };
+        for (size_t stage = 0; stage < 2; stage++) {
+            uint32_t pathIndex = 0;
+            while (pathIndex < scratch.shaderPaths.size() && strcmp(scratch.shaderPaths[pathIndex], stagePaths[stage]) != 0) {
+                pathIndex++;
+            }
+            if (pathIndex == scratch.shaderPaths.size()) {
+                scratch.shaderPaths.push_back(stagePaths[stage]);
             }
-            vertexInputInfo.vertexBindingDescriptionCount = 1;
-            vertexInputInfo.pVertexBindingDescriptions = &vertexInputBindingDesc; // Optional
-            vertexInputInfo.vertexAttributeDescriptionCount = vertexInputAttributeDescs.size();
-            vertexInputInfo.pVertexAttributeDescriptions = vertexInputAttributeDescsMem;
+            scratch.stageShaderIndices[infoIndex * 2 + stage] = pathIndex;
         }
-        else {
-            vertexInputInfo.vertexBindingDescriptionCount = 0;
-            vertexInputInfo.pVertexBindingDescriptions = nullptr; // Optional
-            vertexInputInfo.vertexAttributeDescriptionCount = 0;
-            vertexInputInfo.pVertexAttributeDescriptions = nullptr; // Optional
-        }
-
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-        inputAssembly.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology = createInfos[infoIndex].topology;
-        inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float)createInfos[infoIndex].extent.width;
-        viewport.height = (float)createInfos[infoIndex].extent.height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-
-        VkRect2D scissor{};
-        scissor.offset = { 0, 0 };
-        scissor.extent = createInfos[infoIndex].extent;
-
-        VkPipelineViewportStateCreateInfo viewportState{};
-        viewportState.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewportState.viewportCount = 1;
-        viewportState.pViewports = &viewport;
-        viewportState.scissorCount = 1;
-        viewportState.pScissors = &scissor;
-
-
-        VkPipelineRasterizationStateCreateInfo rasterizer{};
-        rasterizer.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-        rasterizer.depthClampEnable = VK_FALSE;
-        rasterizer.rasterizerDiscardEnable = VK_FALSE;
-
-        if (createInfos[infoIndex].topology == VkPrimitiveTopology::VK_PRIMITIVE_TOPOLOGY_LINE_STRIP) {
-            rasterizer.lineWidth = 5.0f;
-            rasterizer.polygonMode = VkPolygonMode::VK_POLYGON_MODE_LINE;
+    }
+
+    scratch.shaderModules.assign(scratch.shaderPaths.size(), VK_NULL_HANDLE);
+    this->getShaderModules(scratch.shaderPaths.size(), scratch.shaderPaths.data(), scratch.shaderModules.data(), parallel, scratch);
+
+    // The same goes for the fixed function state: each distinct state is filled in once and its block is shared by all
+    // pipelines that have it. The blocks point into themselves, so they are sized before any is filled.
+    scratch.uniqueStates.clear();
+    scratch.uniqueStateHashes.clear();
+    scratch.stateBlockIndices.resize(infosCount);
+    for (size_t infoIndex = 0; infoIndex < infosCount; infoIndex++) {
+        const PipelineState& state = createInfos[infoIndex].state;
+        uint64_t hash = state.hash();
+        uint32_t blockIndex = 0;
+        while (blockIndex < scratch.uniqueStates.size() && (scratch.uniqueStateHashes[blockIndex] != hash || scratch.uniqueStates[blockIndex] != state)) {
+            blockIndex++;
         }
-        else {
-            rasterizer.lineWidth = 1.0f;
-            rasterizer.polygonMode = VkPolygonMode::VK_POLYGON_MODE_FILL;
-        }
-        rasterizer.cullMode = VkCullModeFlagBits::VK_CULL_MODE_BACK_BIT;
-        rasterizer.frontFace = VkFrontFace::VK_FRONT_FACE_CLOCKWISE;
-        rasterizer.depthBiasEnable = VK_FALSE;
-        rasterizer.depthBiasConstantFactor = 0.0f; // Optional
-        rasterizer.depthBiasClamp = 0.0f; // Optional
-        rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
-
-        VkPipelineMultisampleStateCreateInfo multisampling{};
-        multisampling.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT;
-        multisampling.minSampleShading = 1.0f; // Optional
-        multisampling.pSampleMask = nullptr; // Optional
-        multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
-        multisampling.alphaToOneEnable = VK_FALSE; // Optional
-
-        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-        colorBlendAttachment.colorWriteMask = VkColorComponentFlagBits::VK_COLOR_COMPONENT_R_BIT
-            | VkColorComponentFlagBits::VK_COLOR_COMPONENT_G_BIT
-            | VkColorComponentFlagBits::VK_COLOR_COMPONENT_B_BIT
-            | VkColorComponentFlagBits::VK_COLOR_COMPONENT_A_BIT;
-        colorBlendAttachment.blendEnable = VK_FALSE;
-        colorBlendAttachment.srcColorBlendFactor = VkBlendFactor::VK_BLEND_FACTOR_ONE; // Optional
-        colorBlendAttachment.dstColorBlendFactor = VkBlendFactor::VK_BLEND_FACTOR_ZERO; // Optional
-        colorBlendAttachment.colorBlendOp = VkBlendOp::VK_BLEND_OP_ADD; // Optional
-        colorBlendAttachment.srcAlphaBlendFactor = VkBlendFactor::VK_BLEND_FACTOR_ONE; // Optional
-        colorBlendAttachment.dstAlphaBlendFactor = VkBlendFactor::VK_BLEND_FACTOR_ZERO; // Optional
-        colorBlendAttachment.alphaBlendOp = VkBlendOp::VK_BLEND_OP_ADD; // Optional
-
-        VkPipelineColorBlendStateCreateInfo colorBlending{};
-        colorBlending.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        colorBlending.logicOpEnable = VK_FALSE;
-        colorBlending.logicOp = VkLogicOp::VK_LOGIC_OP_COPY; // Optional
-        colorBlending.attachmentCount = 1;
-        colorBlending.pAttachments = &colorBlendAttachment;
-        colorBlending.blendConstants[0] = 0.0f; // Optional
-        colorBlending.blendConstants[1] = 0.0f; // Optional
-        colorBlending.blendConstants[2] = 0.0f; // Optional
-        colorBlending.blendConstants[3] = 0.0f; // Optional
-
-        pipelineInfos[infoIndex].sType = VkStructureType::VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfos[infoIndex].stageCount = 2;
-        pipelineInfos[infoIndex].pStages = shaderStages;
-        pipelineInfos[infoIndex].pVertexInputState = &vertexInputInfo;
-        pipelineInfos[infoIndex].pInputAssemblyState = &inputAssembly;
-        pipelineInfos[infoIndex].pViewportState = &viewportState;
-        pipelineInfos[infoIndex].pRasterizationState = &rasterizer;
-        pipelineInfos[infoIndex].pMultisampleState = &multisampling;
-        pipelineInfos[infoIndex].pDepthStencilState = nullptr; // Optional
-        pipelineInfos[infoIndex].pColorBlendState = &colorBlending;
-        pipelineInfos[infoIndex].layout = this->pipelineLayout;
-        pipelineInfos[infoIndex].renderPass = renderPass;
-        pipelineInfos[infoIndex].subpass = 0;
-        pipelineInfos[infoIndex].basePipelineHandle = VK_NULL_HANDLE; // Optional
-        pipelineInfos[infoIndex].basePipelineIndex = -1; // Optional
-        if (createInfos[infoIndex].topology == VkPrimitiveTopology::VK_PRIMITIVE_TOPOLOGY_LINE_STRIP) {
-            VkDynamicState dynamicStates[1] = { VkDynamicState::VK_DYNAMIC_STATE_LINE_WIDTH };
-            VkPipelineDynamicStateCreateInfo dynamicStateInfo;
-            dynamicStateInfo.pDynamicStates = dynamicStates;
-            dynamicStateInfo.dynamicStateCount = 1;
-            dynamicStateInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-            dynamicStateInfo.pNext = nullptr;
-            dynamicStateInfo.flags = 0;
-            pipelineInfos[infoIndex].pDynamicState = &dynamicStateInfo; // Optional
-        }
-        else
-        {
-            pipelineInfos[infoIndex].pDynamicState = nullptr;
-        }
-        this->createInfos[createInfos[infoIndex].name] = createInfos[infoIndex];
-        VkPipeline pipeline;
-        std::cout << pipelineInfos[infoIndex].pRasterizationState->sType;
-        if (vkCreateGraphicsPipelines(this->device, VK_NULL_HANDLE, 1, &pipelineInfos[infoIndex], nullptr, &pipeline) != VkResult::VK_SUCCESS) {
+        if (blockIndex == scratch.uniqueStates.size()) {
+            scratch.uniqueStates.push_back(state);
+            scratch.uniqueStateHashes.push_back(hash);
+        }
+        scratch.stateBlockIndices[infoIndex] = blockIndex;
+    }
+    scratch.stateBlocks.resize(scratch.uniqueStates.size());
+    for (size_t blockIndex = 0; blockIndex < scratch.uniqueStates.size(); blockIndex++) {
+        scratch.stateBlocks[blockIndex].fill(scratch.uniqueStates[blockIndex]);
+    }
+
+    scratch.states.resize(infosCount);
+    scratch.pipelineInfos.resize(infosCount);
+    for (size_t infoIndex = 0; infoIndex < infosCount; infoIndex++) {
+        this->fillPipelineInfo(createInfos[infoIndex],
+            scratch.shaderModules[scratch.stageShaderIndices[infoIndex * 2]],
+            scratch.shaderModules[scratch.stageShaderIndices[infoIndex * 2 + 1]],
+            scratch.stateBlocks[scratch.stateBlockIndices[infoIndex]],
+            scratch.states[infoIndex],
+            scratch.pipelineInfos[infoIndex]);
+    }
+
+    // Without a thread pool every pipeline is compiled by its own call on this thread. With one, the infos are split
+    // into a contiguous batch per thread and each batch goes to the driver in a single vkCreateGraphicsPipelines call.
+    // The task captures two pointers, which std::function stores without allocating.
+    struct Batches {
+        size_t infosCount;
+        size_t batchCount;
+        const VkGraphicsPipelineCreateInfo* pipelineInfos;
+        VkPipeline* pipelines;
+    } batches = { infosCount, parallel && this->threadPool ? std::min(infosCount, this->threadPool->getThreadCount()) : infosCount, scratch.pipelineInfos.data(), pipelines };
+    this->forEach(batches.batchCount, [this, &batches](size_t batchIndex) {
+        size_t first = batches.infosCount * batchIndex / batches.batchCount;
+        size_t last = batches.infosCount * (batchIndex + 1) / batches.batchCount;
+        AllocationCounter::Ignore driverAllocations;
+        if (vkCreateGraphicsPipelines(this->device, this->pipelineCache, (uint32_t)(last - first), &batches.pipelineInfos[first], nullptr, &batches.pipelines[first]) != VkResult::VK_SUCCESS) {
             throw std::runtime_error("failed to create graphics pipeline!");
         }
-        this->pipelines[createInfos[infoIndex].name] = pipeline;
-        if (createInfos[infoIndex].input) {
-            this->createVertexBuffer(createInfos[infoIndex].name, createInfos[infoIndex].input);
+    }, parallel);
+}
+
+uint32_t PipelineManager::findVariant(uint64_t key, const PipelineCreateInfo& createInfo) const
+{
+    auto range = this->variantsByKey.equal_range(key);
+    for (auto entry = range.first; entry != range.second; entry++) {
+        const PipelineVariant& variant = this->variants[entry->second];
+        if (variant.state == createInfo.state
+            && variant.vertexShaderPath == createInfo.vertexShaderModule
+            && variant.fragmentShaderPath == createInfo.fragmentShaderModule
+            && variant.binding == (createInfo.input ? createInfo.input->binding : nullptr)
+            && variant.attributes == (createInfo.input ? createInfo.input->attributes : nullptr)
+            && variant.specializationCount == createInfo.specializationCount
+            && std::equal(createInfo.specializationConstants, createInfo.specializationConstants + createInfo.specializationCount, variant.specializationConstants)) {
+            return entry->second;
         }
     }
-    /*std::vector<VkPipeline> pipelines;
-    pipelines.resize(infosCount);
-    if (vkCreateGraphicsPipelines(this->device, VK_NULL_HANDLE, (uint32_t)infosCount, pipelineInfos.data(), nullptr, pipelines.data()) != VkResult::VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
+    return NO_VARIANT;
+}
+// The pipeline goes with the last handle, which must no longer be in use.
+void PipelineManager::releaseVariant(uint32_t variant)
+{
+    if (--this->variants[variant].handleCount == 0) {
+        vkDestroyPipeline(this->device, this->pipelines[variant], nullptr);
+        this->pipelines[variant] = VK_NULL_HANDLE;
     }
+}
+
+void PipelineManager::createPipelines(size_t infosCount, PipelineCreateInfo* createInfos)
+{
+    CpuScope scope(this->profiler, this->createPipelinesScope);
+    PipelineBuildScratch& scratch = *this->buildScratch;
+    // only the variants without a pipeline are built, each once however many infos in the batch match it
+    scratch.infoVariants.resize(infosCount);
+    scratch.variantInfos.clear();
+    scratch.builtVariants.clear();
     for (size_t infoIndex = 0; infoIndex < infosCount; infoIndex++) {
-        this->pipelines[createInfos[infoIndex].name] = pipelines[infoIndex];
-        if (createInfos[infoIndex].input) {
-            this->createVertexBuffer(createInfos[infoIndex].name, createInfos[infoIndex].input);
+        const PipelineCreateInfo& createInfo = createInfos[infoIndex];
+        if (createInfo.specializationCount > MAX_SPECIALIZATION_CONSTANTS) {
+            throw std::runtime_error(std::string("too many specialization constants for pipeline ") + createInfo.name);
+        }
+        uint64_t key = getVariantKey(createInfo);
+        uint32_t variant = this->findVariant(key, createInfo);
+        if (variant == NO_VARIANT) {
+            variant = (uint32_t)this->variants.size();
+            PipelineVariant newVariant{};
+            newVariant.key = key;
+            newVariant.state = createInfo.state;
+            newVariant.vertexShaderPath = createInfo.vertexShaderModule;
+            newVariant.fragmentShaderPath = createInfo.fragmentShaderModule;
+            if (createInfo.input) {
+                newVariant.binding = createInfo.input->binding;
+                newVariant.attributes = createInfo.input->attributes;
+                newVariant.attributeCount = createInfo.input->attributeCount;
+            }
+            newVariant.specializationCount = createInfo.specializationCount;
+            std::copy(createInfo.specializationConstants, createInfo.specializationConstants + createInfo.specializationCount, newVariant.specializationConstants);
+            this->variants.push_back(std::move(newVariant));
+            this->variantsByKey.emplace(key, variant);
+            this->pipelines.push_back(VK_NULL_HANDLE);
+            this->dynamicLineWidths.push_back(0.0f);
+        }
+        if (this->pipelines[variant] == VK_NULL_HANDLE && !this->variants[variant].queued) {
+            this->variants[variant].queued = true;
+            scratch.variantInfos.push_back(createInfo);
+            scratch.builtVariants.push_back(variant);
         }
-    }*/
+        scratch.infoVariants[infoIndex] = variant;
+    }
+    for (uint32_t variant : scratch.builtVariants) {
+        this->variants[variant].queued = false;
+    }
+
+    std::vector<VkPipeline>& pipelines = scratch.pipelines;
+    pipelines.assign(scratch.variantInfos.size(), VK_NULL_HANDLE);
+    this->buildPipelines(scratch.variantInfos.size(), scratch.variantInfos.data(), pipelines.data(), true, scratch);
+    for (size_t builtIndex = 0; builtIndex < scratch.builtVariants.size(); builtIndex++) {
+        uint32_t variant = scratch.builtVariants[builtIndex];
+        const RasterizationState& rasterization = this->variants[variant].state.rasterization;
+        this->pipelines[variant] = pipelines[builtIndex];
+        this->dynamicLineWidths[variant] = rasterization.dynamicLineWidth ? rasterization.lineWidth : 0.0f;
+        this->variants[variant].vertexShaderHash = scratch.shaderHashes[scratch.stageShaderIndices[builtIndex * 2]];
+        this->variants[variant].fragmentShaderHash = scratch.shaderHashes[scratch.stageShaderIndices[builtIndex * 2 + 1]];
+    }
 
-    for (const auto& shaderModule : shaderModules) {
-        vkDestroyShaderModule(this->device, shaderModule, nullptr);
+    // every variant of the batch is held before any handle lets go of its old one, so none of them is destroyed
+    for (size_t infoIndex = 0; infoIndex < infosCount; infoIndex++) {
+        this->variants[scratch.infoVariants[infoIndex]].handleCount++;
+    }
+    for (size_t infoIndex = 0; infoIndex < infosCount; infoIndex++) {
+        const PipelineCreateInfo& createInfo = createInfos[infoIndex];
+        PipelineHandle handle = this->pipelineNames.intern(createInfo.name);
+        bool keepVertexBuffer = false;
+        if (handle < this->handleVariants.size()) {
+            // a pipeline created again under the same name replaces the old one; a vertex buffer of the same size is
+            // kept with its contents
+            this->releaseVariant(this->handleVariants[handle]);
+            keepVertexBuffer = this->vertexBuffers[handle] != VK_NULL_HANDLE && createInfo.input && createInfo.input->dataSize == this->vertexInputs[handle]->dataSize;
+            if (!keepVertexBuffer) {
+                this->destroyVertexBuffer(handle);
+            }
+        }
+        else {
+            this->handleVariants.resize(handle + 1, NO_VARIANT);
+            this->vertexBuffers.resize(handle + 1, VK_NULL_HANDLE);
+            this->vertexBufferMemories.resize(handle + 1);
+            this->vertexInputs.resize(handle + 1, nullptr);
+            this->scopeNames.resize(handle + 1, NameRegistry::INVALID_ID);
+            if (this->profiler) {
+                this->scopeNames[handle] = this->profiler->registerName(createInfo.name);
+            }
+        }
+        this->handleVariants[handle] = scratch.infoVariants[infoIndex];
+        this->vertexInputs[handle] = createInfo.input;
+        if (createInfo.input && createInfo.input->dataSize > 0 && !keepVertexBuffer) {
+            this->createVertexBuffer(handle, createInfo.input);
+        }
     }
 }
-void PipelineManager::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = this->transferCommandPool;
-    allocInfo.commandBufferCount = 1;
 
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(this->device, &allocInfo, &commandBuffer);
+void PipelineManager::createComputePipelines(size_t infosCount, ComputePipelineCreateInfo* createInfos)
+{
+    std::vector<ComputePipeline> computePipelines;
+    computePipelines.resize(infosCount);
+    std::vector<const char*> shaderPaths;
+    for (size_t infoIndex = 0; infoIndex < infosCount; infoIndex++) {
+        shaderPaths.push_back(createInfos[infoIndex].computeShaderModule);
+    }
+    std::vector<VkShaderModule> shaderModules;
+    shaderModules.resize(infosCount, VK_NULL_HANDLE);
+    PipelineBuildScratch scratch;
+    this->getShaderModules(infosCount, shaderPaths.data(), shaderModules.data(), true, scratch);
+    std::vector<VkComputePipelineCreateInfo> pipelineInfos;
+    pipelineInfos.resize(infosCount);
 
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    for (size_t infoIndex = 0; infoIndex < infosCount; infoIndex++) {
+        const ComputePipelineCreateInfo& createInfo = createInfos[infoIndex];
+        ComputePipeline& computePipeline = computePipelines[infoIndex];
+        computePipeline.storageBufferCount = createInfo.storageBufferCount;
+        computePipeline.pushConstantSize = createInfo.pushConstantSize;
+        computePipeline.shaderPath = createInfo.computeShaderModule;
+        computePipeline.shaderHash = scratch.shaderHashes[infoIndex];
+
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+        bindings.resize(createInfo.storageBufferCount);
+        for (uint32_t binding = 0; binding < createInfo.storageBufferCount; binding++) {
+            bindings[binding] = {};
+            bindings[binding].binding = binding;
+            bindings[binding].descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[binding].descriptorCount = 1;
+            bindings[binding].stageFlags = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+        setLayoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        setLayoutInfo.bindingCount = createInfo.storageBufferCount;
+        setLayoutInfo.pBindings = bindings.data();
+        if (vkCreateDescriptorSetLayout(this->device, &setLayoutInfo, nullptr, &computePipeline.setLayout) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
 
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = createInfo.pushConstantSize;
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &computePipeline.setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = createInfo.pushConstantSize > 0 ? 1 : 0;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(this->device, &pipelineLayoutInfo, nullptr, &computePipeline.layout) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
 
-    VkBufferCopy copyRegion{};
-    copyRegion.srcOffset = 0; // Optional
-    copyRegion.dstOffset = 0; // Optional
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-    vkEndCommandBuffer(commandBuffer);
+        // every compute pipeline gets exactly one set, updated by bindStorageBuffers
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = std::max<uint32_t>(createInfo.storageBufferCount, 1);
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        if (vkCreateDescriptorPool(this->device, &poolInfo, nullptr, &computePipeline.descriptorPool) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        VkDescriptorSetAllocateInfo setInfo{};
+        setInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = computePipeline.descriptorPool;
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &computePipeline.setLayout;
+        if (vkAllocateDescriptorSets(this->device, &setInfo, &computePipeline.descriptorSet) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor set!");
+        }
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
+        pipelineInfos[infoIndex] = {};
+        pipelineInfos[infoIndex].sType = VkStructureType::VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfos[infoIndex].stage.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfos[infoIndex].stage.stage = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfos[infoIndex].stage.module = shaderModules[infoIndex];
+        pipelineInfos[infoIndex].stage.pName = "main";
+        pipelineInfos[infoIndex].layout = computePipeline.layout;
+    }
 
-    vkQueueSubmit(this->transferQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(this->transferQueue);
-    vkFreeCommandBuffers(this->device, this->transferCommandPool, 1, &commandBuffer);
+    std::vector<VkPipeline> pipelines;
+    pipelines.resize(infosCount, VK_NULL_HANDLE);
+    if (infosCount > 0 && vkCreateComputePipelines(this->device, this->pipelineCache, (uint32_t)infosCount, pipelineInfos.data(), nullptr, pipelines.data()) != VkResult::VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline!");
+    }
+    for (size_t infoIndex = 0; infoIndex < infosCount; infoIndex++) {
+        computePipelines[infoIndex].pipeline = pipelines[infoIndex];
+        PipelineHandle handle = this->computePipelineNames.intern(createInfos[infoIndex].name);
+        if (handle < this->computePipelines.size()) {
+            this->destroyComputePipeline(handle);
+        }
+        else {
+            this->computePipelines.resize(handle + 1, {});
+        }
+        this->computePipelines[handle] = computePipelines[infoIndex];
+    }
 }
-void PipelineManager::createVertexBuffer(const std::string name, VertexInput* bufferContent) {
-    uint32_t vertexBufferUsingFamilyIndices[] = { this->graphicsFamilyIndex, this->transferFamilyIndex };
-    uint32_t stagingBufferUsingFamilyIndices[] = { this->transferFamilyIndex };
+PipelineHandle PipelineManager::findPipeline(const std::string& name) const
+{
+    PipelineHandle handle = this->pipelineNames.find(name);
+    if (handle == INVALID_PIPELINE_HANDLE) {
+        throw std::runtime_error("unknown pipeline " + name);
+    }
+    return handle;
+}
+PipelineHandle PipelineManager::findComputePipeline(const std::string& name) const
+{
+    PipelineHandle handle = this->computePipelineNames.find(name);
+    if (handle == INVALID_PIPELINE_HANDLE) {
+        throw std::runtime_error("unknown compute pipeline " + name);
+    }
+    return handle;
+}
+size_t PipelineManager::getPipelineCount() const
+{
+    return this->handleVariants.size();
+}
+size_t PipelineManager::getVariantCount() const
+{
+    return this->pipelines.size() - std::count(this->pipelines.begin(), this->pipelines.end(), VK_NULL_HANDLE);
+}
+// Names the scopes of the pipelines created so far; the ones created later are named as they are created.
+void PipelineManager::setProfiler(Profiler* profiler, bool hostQueryReset)
+{
+    this->profiler = profiler;
+    this->uploadRing->setProfiler(profiler, hostQueryReset);
+    this->createPipelinesScope = profiler->registerName("createPipelines");
+    this->scopeNames.resize(this->handleVariants.size());
+    for (PipelineHandle handle = 0; handle < this->handleVariants.size(); handle++) {
+        this->scopeNames[handle] = profiler->registerName(this->pipelineNames.getName(handle));
+    }
+}
+void PipelineManager::bindStorageBuffers(PipelineHandle pipeline, size_t bufferCount, const VkBuffer* buffers)
+{
+    const ComputePipeline& computePipeline = this->computePipelines.at(pipeline);
+    if (bufferCount != computePipeline.storageBufferCount) {
+        throw std::runtime_error("storage buffer count does not match compute pipeline " + this->computePipelineNames.getName(pipeline));
+    }
+    std::vector<VkDescriptorBufferInfo> bufferInfos;
+    bufferInfos.resize(bufferCount);
+    std::vector<VkWriteDescriptorSet> writes;
+    writes.resize(bufferCount);
+    for (size_t binding = 0; binding < bufferCount; binding++) {
+        bufferInfos[binding].buffer = buffers[binding];
+        bufferInfos[binding].offset = 0;
+        bufferInfos[binding].range = VK_WHOLE_SIZE;
 
-    VkDeviceSize bufferSize = sizeof(bufferContent->getDataSize());
+        writes[binding] = {};
+        writes[binding].sType = VkStructureType::VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[binding].dstSet = computePipeline.descriptorSet;
+        writes[binding].dstBinding = (uint32_t)binding;
+        writes[binding].descriptorCount = 1;
+        writes[binding].descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[binding].pBufferInfo = &bufferInfos[binding];
+    }
+    vkUpdateDescriptorSets(this->device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+}
+void PipelineManager::writeDispatch(VkCommandBuffer buffer, PipelineHandle pipeline, uint32_t groupCountX, const void* pushConstants)
+{
+    const ComputePipeline& computePipeline = this->computePipelines[pipeline];
+    vkCmdBindPipeline(buffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline.pipeline);
+    vkCmdBindDescriptorSets(buffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline.layout, 0, 1, &computePipeline.descriptorSet, 0, nullptr);
+    if (computePipeline.pushConstantSize > 0) {
+        vkCmdPushConstants(buffer, computePipeline.layout, VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT, 0, computePipeline.pushConstantSize, pushConstants);
+    }
+    vkCmdDispatch(buffer, groupCountX, 1, 1);
+}
+UploadRing* PipelineManager::getUploadRing()
+{
+    return this->uploadRing;
+}
+void PipelineManager::forEach(size_t count, const std::function<void(size_t)>& task, bool parallel)
+{
+    if (parallel && this->threadPool) {
+        this->threadPool->parallelFor(count, task);
+        return;
+    }
+    for (size_t index = 0; index < count; index++) {
+        task(index);
+    }
+}
+void PipelineManager::createVertexBuffer(PipelineHandle pipeline, VertexInput* bufferContent) {
+    // exclusively owned by the graphics family, the upload ring hands ranges over from the transfer queue
+    uint32_t vertexBufferUsingFamilyIndices[] = { this->graphicsFamilyIndex };
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    this->createBuffer(bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer,
-        stagingBufferMemory,
-        1,
-        stagingBufferUsingFamilyIndices
-    );
+    VkDeviceSize bufferSize = bufferContent->dataSize;
 
     VkBuffer vertexBuffer;
-    VkDeviceMemory vertextBufferMemory;
+    GpuAllocation vertextBufferMemory;
 
     this->createBuffer(bufferSize,
         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         vertexBuffer,
         vertextBufferMemory,
-        2,
+        1,
         vertexBufferUsingFamilyIndices
     );
 
-    this->vertexBuffers[name] = vertexBuffer;
-    this->vertexBufferMemories[name] = vertextBufferMemory;
-
-    this->stagingBuffers[name] = stagingBuffer;
-    this->stagingBufferMemories[name] = stagingBufferMemory;
+    this->vertexBuffers[pipeline] = vertexBuffer;
+    this->vertexBufferMemories[pipeline] = vertextBufferMemory;
 }
-void PipelineManager::writeVertexData(void* vertexData, std::string name) {
-    size_t dataSize = this->createInfos[name].input->getDataSize();
-    
-    void* data;
-    vkMapMemory(this->device, this->stagingBufferMemories[name], 0, dataSize, 0, &data);
-    memcpy(data, vertexData, dataSize);
-    vkUnmapMemory(this->device, this->stagingBufferMemories[name]);
-
-    this->copyBuffer(this->stagingBuffers[name], this->vertexBuffers[name], dataSize);
+void PipelineManager::writeVertexData(void* vertexData, PipelineHandle pipeline) {
+    size_t dataSize = this->vertexInputs.at(pipeline)->dataSize;
+    this->uploadRing->upload(this->vertexBuffers[pipeline], 0, vertexData, dataSize);
+}
+UploadSubmission PipelineManager::submitUploads() {
+    return this->uploadRing->submit();
 }
-void PipelineManager::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, uint32_t usingFamiliesCount, uint32_t* usingFamilies) {
+void PipelineManager::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, GpuAllocation& bufferMemory, uint32_t usingFamiliesCount, uint32_t* usingFamilies) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
@@ -364,41 +700,337 @@ void PipelineManager::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(this->device, buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = this->findMemoryType(memRequirements.memoryTypeBits, properties);
+    bufferMemory = this->allocator->allocate(memRequirements, properties, GpuResourceKind::Linear);
+    vkBindBufferMemory(this->device, buffer, bufferMemory.memory, bufferMemory.offset);
+}
+
+void PipelineManager::writeCommands(VkCommandBuffer buffer, VkExtent2D extent, size_t drawCount, const DrawCommand* draws, const GpuScopeTarget& scopes)
+{
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)extent.width;
+    viewport.height = (float)extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(buffer, 0, 1, &viewport);
 
-    if (vkAllocateMemory(this->device, &allocInfo, nullptr, &bufferMemory) != VkResult::VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
+    VkRect2D scissor{};
+    scissor.offset = { 0, 0 };
+    scissor.extent = extent;
+    vkCmdSetScissor(buffer, 0, 1, &scissor);
+    // all graphics pipelines share the layout, so this stays for every pipeline bound below
+    ViewportConstants viewportConstants = { 2.0f / extent.width, 2.0f / extent.height };
+    vkCmdPushConstants(buffer, this->pipelineLayout, VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(viewportConstants), &viewportConstants);
+
+    PipelineHandle boundPipeline = INVALID_PIPELINE_HANDLE;
+    uint32_t boundVariant = NO_VARIANT;
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    // reads only, writeCommands runs on several recording threads at once
+    const uint32_t* handleVariants = this->handleVariants.data();
+    const VkPipeline* pipelines = this->pipelines.data();
+    const float* dynamicLineWidths = this->dynamicLineWidths.data();
+    const VkBuffer* ownVertexBuffers = this->vertexBuffers.data();
+    const uint32_t* scopeNames = this->scopeNames.data();
+    uint32_t scope = Profiler::NO_SCOPE;
+    uint64_t pipelineBinds = 0;
+    uint64_t vertexBufferBinds = 0;
+    for (size_t drawIndex = 0; drawIndex < drawCount; drawIndex++) {
+        const DrawCommand& draw = draws[drawIndex];
+        // consecutive draws with the same pipeline and vertex buffer keep their bindings
+        bool pipelineChanged = draw.pipeline != boundPipeline;
+        // a draw without a vertex buffer of its own uses its pipeline's, even after a draw that brought one
+        VkBuffer vertexBuffer = draw.vertexBuffer != VK_NULL_HANDLE ? draw.vertexBuffer : ownVertexBuffers[draw.pipeline];
+        if (pipelineChanged || vertexBuffer != boundVertexBuffer) {
+            if (pipelineChanged) {
+                if (scopes.profiler) {
+                    scopes.profiler->endGpuScope(buffer, scopes, scope);
+                    scope = scopes.profiler->beginGpuScope(buffer, scopes, scopeNames[draw.pipeline]);
+                }
+                uint32_t variant = handleVariants[draw.pipeline];
+                if (variant != boundVariant) {
+                    vkCmdBindPipeline(buffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[variant]);
+                    pipelineBinds++;
+                    if (dynamicLineWidths[variant] > 0.0f) {
+                        vkCmdSetLineWidth(buffer, dynamicLineWidths[variant]);
+                    }
+                    boundVariant = variant;
+                }
+            }
+            if (vertexBuffer && vertexBuffer != boundVertexBuffer) {
+                VkBuffer vertexBuffers[] = { vertexBuffer };
+                VkDeviceSize offsets[] = { 0 };
+                vkCmdBindVertexBuffers(buffer, 0, 1, vertexBuffers, offsets);
+                boundVertexBuffer = vertexBuffer;
+                vertexBufferBinds++;
+            }
+            boundPipeline = draw.pipeline;
+        }
+        if (draw.indirectBuffer == VK_NULL_HANDLE) {
+            vkCmdDraw(buffer, draw.vertexCount, draw.instanceCount, draw.firstVertex, draw.firstInstance);
+        }
+        else if (draw.countBuffer != VK_NULL_HANDLE && this->drawIndirectCount) {
+            vkCmdDrawIndirectCount(buffer, draw.indirectBuffer, draw.indirectOffset, draw.countBuffer, draw.countOffset, 1, sizeof(VkDrawIndirectCommand));
+        }
+        else {
+            // without drawIndirectCount the draw always happens, with an instance count of 0 when everything was culled
+            vkCmdDrawIndirect(buffer, draw.indirectBuffer, draw.indirectOffset, 1, sizeof(VkDrawIndirectCommand));
+        }
+    }
+    if (scopes.profiler) {
+        scopes.profiler->endGpuScope(buffer, scopes, scope);
     }
+    Counters::add(Counter::Draws, drawCount);
+    Counters::add(Counter::PipelineBinds, pipelineBinds);
+    Counters::add(Counter::VertexBufferBinds, vertexBufferBinds);
+}
+// Begins a secondary command buffer that continues subpass 0 of the render pass the pipelines were made for.
+void PipelineManager::beginSecondary(VkCommandBuffer buffer, VkCommandBufferUsageFlags flags)
+{
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = this->renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = VK_NULL_HANDLE; // Optional
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = flags | VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
 
-    vkBindBufferMemory(this->device, buffer, bufferMemory, 0);
+    if (vkBeginCommandBuffer(buffer, &beginInfo) != VkResult::VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording secondary command buffer!");
+    }
+}
+void PipelineManager::setStaticDraws(size_t drawCount, const DrawCommand* draws)
+{
+    this->staticDraws.assign(draws, draws + drawCount);
+    this->staticDrawsVersion++;
 }
-uint32_t PipelineManager::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(this->physicalDevice, &memProperties);
+// The caller must have waited for the frame's previous submit, since an outdated buffer is re-recorded in place.
+VkCommandBuffer PipelineManager::getStaticCommands(uint32_t frameIndex, VkExtent2D extent)
+{
+    if (frameIndex >= this->staticCommands.size()) {
+        size_t oldSize = this->staticCommands.size();
+        this->staticCommands.resize(frameIndex + 1);
+        for (size_t i = oldSize; i < this->staticCommands.size(); i++) {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = this->staticCommandPool;
+            allocInfo.level = VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(this->device, &allocInfo, &this->staticCommands[i].commandBuffer) != VkResult::VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate static command buffer!");
+            }
+            this->staticCommands[i].recordedVersion = 0;
+        }
+    }
 
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
+    StaticCommands& commands = this->staticCommands[frameIndex];
+    if (commands.recordedVersion != this->staticDrawsVersion
+        || commands.recordedExtent.width != extent.width || commands.recordedExtent.height != extent.height) {
+        vkResetCommandBuffer(commands.commandBuffer, 0);
+        this->beginSecondary(commands.commandBuffer, 0);
+        GpuScopeTarget scopes;
+        if (this->profiler) {
+            this->profiler->resetCachedScopes(frameIndex);
+            scopes.profiler = this->profiler;
+            scopes.frameIndex = frameIndex;
+            scopes.cached = true;
+        }
+        this->writeCommands(commands.commandBuffer, extent, this->staticDraws.size(), this->staticDraws.data(), scopes);
+        if (vkEndCommandBuffer(commands.commandBuffer) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to record static command buffer!");
         }
+        commands.recordedVersion = this->staticDrawsVersion;
+        commands.recordedExtent = extent;
     }
+    return commands.commandBuffer;
+}
 
-    throw std::runtime_error("failed to find suitable memory type!");
+void PipelineManager::rebuildPipelinesUsing(size_t pathCount, const std::string* paths)
+{
+    for (size_t pathIndex = 0; pathIndex < pathCount; pathIndex++) {
+        if (std::find(this->changedShaderPaths.begin(), this->changedShaderPaths.end(), paths[pathIndex]) == this->changedShaderPaths.end()) {
+            this->changedShaderPaths.push_back(paths[pathIndex]);
+        }
+    }
 }
+// Copies everything the rebuild needs, so the thread never reads the manager's arrays while the main thread uses them.
+void PipelineManager::startRebuild()
+{
+    auto isChanged = [this](const std::string& path) {
+        return std::find(this->changedShaderPaths.begin(), this->changedShaderPaths.end(), path) != this->changedShaderPaths.end();
+    };
+    std::vector<uint32_t> variants;
+    for (uint32_t variant = 0; variant < this->variants.size(); variant++) {
+        if (this->pipelines[variant] != VK_NULL_HANDLE && (isChanged(this->variants[variant].vertexShaderPath) || isChanged(this->variants[variant].fragmentShaderPath))) {
+            variants.push_back(variant);
+        }
+    }
+    std::vector<PipelineHandle> computeHandles;
+    std::vector<std::string> computeShaderPaths;
+    std::vector<VkPipelineLayout> computeLayouts;
+    for (PipelineHandle handle = 0; handle < this->computePipelines.size(); handle++) {
+        if (this->computePipelines[handle].pipeline != VK_NULL_HANDLE && isChanged(this->computePipelines[handle].shaderPath)) {
+            computeHandles.push_back(handle);
+            computeShaderPaths.push_back(this->computePipelines[handle].shaderPath);
+            computeLayouts.push_back(this->computePipelines[handle].layout);
+        }
+    }
+    this->changedShaderPaths.clear();
+    if (variants.empty() && computeHandles.empty()) {
+        return;
+    }
+
+    // buildPipelines reads neither names nor vertex buffer sizes, the inputs only carry the layouts
+    std::vector<std::string> shaderPaths;
+    std::vector<VertexInput> inputs(variants.size());
+    std::vector<PipelineCreateInfo> createInfos(variants.size());
+    for (uint32_t variant : variants) {
+        shaderPaths.push_back(this->variants[variant].vertexShaderPath);
+        shaderPaths.push_back(this->variants[variant].fragmentShaderPath);
+    }
+    for (size_t infoIndex = 0; infoIndex < variants.size(); infoIndex++) {
+        const PipelineVariant& variant = this->variants[variants[infoIndex]];
+        PipelineCreateInfo& createInfo = createInfos[infoIndex];
+        createInfo = {};
+        createInfo.name = "";
+        createInfo.state = variant.state;
+        createInfo.vertexShaderModule = shaderPaths[infoIndex * 2].c_str();
+        createInfo.fragmentShaderModule = shaderPaths[infoIndex * 2 + 1].c_str();
+        if (variant.binding) {
+            inputs[infoIndex] = { variant.binding, variant.attributes, variant.attributeCount, 0 };
+            createInfo.input = &inputs[infoIndex];
+        }
+        createInfo.specializationCount = variant.specializationCount;
+        std::copy(variant.specializationConstants, variant.specializationConstants + variant.specializationCount, createInfo.specializationConstants);
+    }
+
+    this->rebuilding = true;
+    this->rebuildFinished = false;
+    this->rebuildThread = std::thread([this, variants, computeHandles, computeShaderPaths, computeLayouts,
+        shaderPaths = std::move(shaderPaths), inputs = std::move(inputs), createInfos = std::move(createInfos)]() {
+        std::vector<RebuiltPipeline> rebuilt;
+        PipelineBuildScratch scratch;
+        try {
+            std::vector<VkPipeline> pipelines(variants.size(), VK_NULL_HANDLE);
+            this->buildPipelines(variants.size(), createInfos.data(), pipelines.data(), false, scratch);
+            for (size_t index = 0; index < variants.size(); index++) {
+                uint64_t vertexShaderHash = scratch.shaderHashes[scratch.stageShaderIndices[index * 2]];
+                uint64_t fragmentShaderHash = scratch.shaderHashes[scratch.stageShaderIndices[index * 2 + 1]];
+                rebuilt.push_back({ false, variants[index], pipelines[index], { vertexShaderHash, fragmentShaderHash } });
+            }
 
-void PipelineManager::writeCommands(VkCommandBuffer buffer)
+            std::vector<VkShaderModule> shaderModules(computeHandles.size(), VK_NULL_HANDLE);
+            std::vector<const char*> shaderPathPointers;
+            for (const std::string& path : computeShaderPaths) {
+                shaderPathPointers.push_back(path.c_str());
+            }
+            this->getShaderModules(computeHandles.size(), shaderPathPointers.data(), shaderModules.data(), false, scratch);
+            for (size_t index = 0; index < computeHandles.size(); index++) {
+                VkComputePipelineCreateInfo pipelineInfo{};
+                pipelineInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+                pipelineInfo.stage.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                pipelineInfo.stage.stage = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT;
+                pipelineInfo.stage.module = shaderModules[index];
+                pipelineInfo.stage.pName = "main";
+                pipelineInfo.layout = computeLayouts[index];
+                VkPipeline pipeline;
+                if (vkCreateComputePipelines(this->device, this->pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VkResult::VK_SUCCESS) {
+                    throw std::runtime_error("failed to create compute pipeline!");
+                }
+                rebuilt.push_back({ true, computeHandles[index], pipeline, { scratch.shaderHashes[index], 0 } });
+            }
+        }
+        catch (const std::exception& e) {
+            // the old pipelines stay in use, the next change to the shaders tries again
+            std::cerr << "pipeline rebuild failed: " << e.what() << std::endl;
+            for (const auto& pipeline : rebuilt) {
+                vkDestroyPipeline(this->device, pipeline.pipeline, nullptr);
+            }
+            rebuilt.clear();
+        }
+        this->rebuiltPipelines = std::move(rebuilt);
+        this->rebuildFinished.store(true, std::memory_order_release);
+    });
+}
+void PipelineManager::destroyUnusedShaderModules()
 {
-    for (const auto& pipeline : this->pipelines) {
-        vkCmdBindPipeline(buffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelines[pipeline.first]);
-        if (this->vertexBuffers[pipeline.first]) {
-            VkBuffer vertexBuffers[] = { this->vertexBuffers[pipeline.first] };
-            VkDeviceSize offsets[] = { 0 };
-            vkCmdBindVertexBuffers(buffer, 0, 1, vertexBuffers, offsets);
+    std::unordered_set<uint64_t> usedHashes;
+    for (uint32_t variant = 0; variant < this->variants.size(); variant++) {
+        if (this->pipelines[variant] != VK_NULL_HANDLE) {
+            usedHashes.insert(this->variants[variant].vertexShaderHash);
+            usedHashes.insert(this->variants[variant].fragmentShaderHash);
         }
-        if (this->createInfos[pipeline.first].topology == VkPrimitiveTopology::VK_PRIMITIVE_TOPOLOGY_LINE_STRIP) {
-            vkCmdSetLineWidth(buffer, 1.0);
+    }
+    for (const ComputePipeline& computePipeline : this->computePipelines) {
+        if (computePipeline.pipeline != VK_NULL_HANDLE) {
+            usedHashes.insert(computePipeline.shaderHash);
+        }
+    }
+    std::lock_guard<std::mutex> lock(this->shaderModulesMutex);
+    auto shaderModule = this->shaderModules.begin();
+    while (shaderModule != this->shaderModules.end()) {
+        if (usedHashes.count(shaderModule->first) == 0) {
+            vkDestroyShaderModule(this->device, shaderModule->second, nullptr);
+            shaderModule = this->shaderModules.erase(shaderModule);
+        }
+        else {
+            shaderModule++;
         }
     }
 }
+size_t PipelineManager::swapRebuiltPipelines(size_t framesInFlight)
+{
+    size_t swapped = 0;
+    if (this->rebuilding && this->rebuildFinished.load(std::memory_order_acquire)) {
+        this->rebuildThread.join();
+        this->rebuilding = false;
+        for (const auto& rebuilt : this->rebuiltPipelines) {
+            VkPipeline& current = rebuilt.compute ? this->computePipelines[rebuilt.handle].pipeline : this->pipelines[rebuilt.handle];
+            if (current == VK_NULL_HANDLE) {
+                // every handle left the variant while it was rebuilt
+                vkDestroyPipeline(this->device, rebuilt.pipeline, nullptr);
+                continue;
+            }
+            this->retiredPipelines.push_back({ current, this->swapCount });
+            current = rebuilt.pipeline;
+            if (rebuilt.compute) {
+                this->computePipelines[rebuilt.handle].shaderHash = rebuilt.shaderHashes[0];
+            }
+            else {
+                this->variants[rebuilt.handle].vertexShaderHash = rebuilt.shaderHashes[0];
+                this->variants[rebuilt.handle].fragmentShaderHash = rebuilt.shaderHashes[1];
+                // the static secondaries still bind the old pipeline
+                this->staticDrawsVersion++;
+            }
+            swapped++;
+        }
+        this->rebuiltPipelines.clear();
+        // a pipeline no longer needs its modules once it is created, only the code something was built from now may
+        // be asked for again
+        if (swapped > 0) {
+            this->destroyUnusedShaderModules();
+        }
+    }
+
+    // Everything recorded before this call used the old pipelines. Each call is followed by a submit and comes after
+    // the wait for the fence framesInFlight submits back, so after framesInFlight more calls those submits are done.
+    auto retired = this->retiredPipelines.begin();
+    while (retired != this->retiredPipelines.end()) {
+        if (retired->retiredAt + framesInFlight <= this->swapCount) {
+            vkDestroyPipeline(this->device, retired->pipeline, nullptr);
+            retired = this->retiredPipelines.erase(retired);
+        }
+        else {
+            retired++;
+        }
+    }
+
+    if (!this->rebuilding && !this->changedShaderPaths.empty()) {
+        this->startRebuild();
+    }
+    this->swapCount++;
+    return swapped;
+}
\ No newline at end of file
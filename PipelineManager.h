@@ -1,46 +1,216 @@
 #include <vulkan/vulkan.h>
 #include <string>
 #include <vector>
-#include <map>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <atomic>
 #include "VertexInput.h"
+#include "ThreadPool.h"
+#include "GpuAllocator.h"
+#include "UploadRing.h"
+#include "NameRegistry.h"
+#include "Profiler.h"
+#include "PipelineState.h"
 
 #pragma once
+// Dense index of a graphics or compute pipeline, resolved once from its name with PipelineManager::findPipeline.
+typedef uint32_t PipelineHandle;
+const PipelineHandle INVALID_PIPELINE_HANDLE = NameRegistry::INVALID_ID;
+const uint32_t MAX_SPECIALIZATION_CONSTANTS = 4;
+// Create infos that differ only in name and vertex buffer size share one VkPipeline.
 struct PipelineCreateInfo {
 	const char* name;
-	VkPrimitiveTopology topology;
+	PipelineState state;
 	const char* vertexShaderModule;
 	const char* fragmentShaderModule;
 	VertexInput* input;
-	VkExtent2D extent;
+	// values of the specialization constants with constant_id 0..specializationCount-1, in both stages;
+	// the others keep their defaults from the shader
+	uint32_t specializationCount;
+	uint32_t specializationConstants[MAX_SPECIALIZATION_CONSTANTS];
 };
+// Compute pipelines take their buffers as storage buffers 0..storageBufferCount-1 of set 0.
+struct ComputePipelineCreateInfo {
+	const char* name;
+	const char* computeShaderModule;
+	uint32_t storageBufferCount;
+	uint32_t pushConstantSize;
+};
+// One vkCmdDraw with the given pipeline and its vertex buffer.
+struct DrawCommand {
+	PipelineHandle pipeline;
+	uint32_t vertexCount;
+	uint32_t instanceCount;
+	uint32_t firstVertex;
+	uint32_t firstInstance;
+	// binds this instead of the pipeline's own vertex buffer when set
+	VkBuffer vertexBuffer;
+	// when set the draw parameters come from one VkDrawIndirectCommand at indirectOffset instead of the fields above,
+	// and countBuffer, if set as well, holds the draw count (0 or 1) at countOffset
+	VkBuffer indirectBuffer;
+	VkDeviceSize indirectOffset;
+	VkBuffer countBuffer;
+	VkDeviceSize countOffset;
+};
+// Push constants of every graphics pipeline's vertex stage, set by writeCommands for the extent it records for.
+struct ViewportConstants {
+	// size of one pixel in normalized device coordinates
+	float pixelWidth;
+	float pixelHeight;
+};
+struct PipelineStateStorage;
+struct PipelineBuildScratch;
 class PipelineManager
 {
 private:
 	VkDevice device;
 	VkRenderPass renderPass;
 	VkPipelineLayout pipelineLayout;
-	std::map<const std::string, VkPipeline> pipelines;
-	VkShaderModule createShaderModule(const std::vector<char>& code);
-	static std::vector<char> readFile(const std::string& filename);
-	std::map<const std::string, VkBuffer> vertexBuffers;
-	std::map<const std::string, VkDeviceMemory> vertexBufferMemories;
-	std::map<const std::string, VkBuffer> stagingBuffers;
-	std::map<const std::string, VkDeviceMemory> stagingBufferMemories;
-	VkCommandPool transferCommandPool;
+	VkPipelineCache pipelineCache;
+	ThreadPool* threadPool;
+	GpuAllocator* allocator;
+	// Modules by ShaderCode::hash, kept so shaders shared between batches compile once. Code that no pipeline was built
+	// from any more, like the old version of a hot reloaded shader, has its module destroyed by swapRebuiltPipelines.
+	std::unordered_map<uint64_t, VkShaderModule> shaderModules;
+	VkShaderModule createShaderModule(const uint32_t* code, size_t size);
+	std::mutex shaderModulesMutex;
+	void getShaderModules(size_t pathCount, const char* const* paths, VkShaderModule* modules, bool parallel, PipelineBuildScratch& scratch);
+	void destroyUnusedShaderModules();
+	UploadRing* uploadRing;
 	VkPhysicalDevice physicalDevice;
-	VkQueue transferQueue;
 	uint32_t transferFamilyIndex;
 	uint32_t graphicsFamilyIndex;
-	std::map<const std::string, PipelineCreateInfo> createInfos;
+	// Distinct graphics pipelines. Handles whose create infos match in state, shaders, vertex layout and specialization
+	// share a variant and with it one VkPipeline. Variants are never removed: when the last handle moves on, the
+	// pipeline is destroyed but the key stays, and the pipeline is built again once a create info matches it later.
+	struct PipelineVariant {
+		uint64_t key;
+		PipelineState state;
+		std::string vertexShaderPath;
+		std::string fragmentShaderPath;
+		// the code the pipeline was built from
+		uint64_t vertexShaderHash;
+		uint64_t fragmentShaderHash;
+		// the vertex layout, compared by address since VertexInput::of points into static data
+		const VkVertexInputBindingDescription* binding;
+		const VkVertexInputAttributeDescription* attributes;
+		uint32_t attributeCount;
+		uint32_t specializationCount;
+		uint32_t specializationConstants[MAX_SPECIALIZATION_CONSTANTS];
+		uint32_t handleCount;
+		// set while createPipelines has it in the batch it builds
+		bool queued;
+	};
+	static const uint32_t NO_VARIANT = UINT32_MAX;
+	std::vector<PipelineVariant> variants;
+	std::unordered_multimap<uint64_t, uint32_t> variantsByKey;
+	// one entry per variant, read by writeCommands: the pipeline, VK_NULL_HANDLE while no handle uses it, and the line
+	// width to set after binding it, 0 unless its state leaves the line width dynamic
+	std::vector<VkPipeline> pipelines;
+	std::vector<float> dynamicLineWidths;
+	uint32_t findVariant(uint64_t key, const PipelineCreateInfo& createInfo) const;
+	void releaseVariant(uint32_t variant);
+	// graphics pipeline handles, one entry per handle in every array
+	NameRegistry pipelineNames;
+	std::vector<uint32_t> handleVariants;
+	std::vector<VkBuffer> vertexBuffers;
+	std::vector<GpuAllocation> vertexBufferMemories;
+	std::vector<VertexInput*> vertexInputs;
+	// profiler scope name of each pipeline's draws
+	std::vector<uint32_t> scopeNames;
+	struct ComputePipeline {
+		VkPipeline pipeline;
+		VkPipelineLayout layout;
+		VkDescriptorSetLayout setLayout;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+		uint32_t storageBufferCount;
+		uint32_t pushConstantSize;
+		std::string shaderPath;
+		uint64_t shaderHash;
+	};
+	NameRegistry computePipelineNames;
+	std::vector<ComputePipeline> computePipelines;
+	bool drawIndirectCount;
+	Profiler* profiler = nullptr;
+	uint32_t createPipelinesScope = NameRegistry::INVALID_ID;
+	// static draws are recorded once per frame in flight into secondary command buffers and replayed until they change
+	struct StaticCommands {
+		VkCommandBuffer commandBuffer;
+		uint64_t recordedVersion;
+		VkExtent2D recordedExtent;
+	};
+	VkCommandPool staticCommandPool;
+	std::vector<DrawCommand> staticDraws;
+	uint64_t staticDrawsVersion = 1;
+	std::vector<StaticCommands> staticCommands;
+
+	void createVertexBuffer(PipelineHandle pipeline, VertexInput* bufferContent);
+	void destroyComputePipeline(PipelineHandle pipeline);
+	void fillPipelineInfo(const PipelineCreateInfo& createInfo, VkShaderModule vertShaderModule, VkShaderModule fragShaderModule, const PipelineStateBlock& stateBlock, PipelineStateStorage& state, VkGraphicsPipelineCreateInfo& pipelineInfo);
+	// parallel is false on the rebuild thread, the thread pool belongs to the main thread
+	void forEach(size_t count, const std::function<void(size_t)>& task, bool parallel = true);
+	void buildPipelines(size_t infosCount, const PipelineCreateInfo* createInfos, VkPipeline* pipelines, bool parallel, PipelineBuildScratch& scratch);
+	// createPipelines' scratch, the rebuild thread has its own
+	PipelineBuildScratch* buildScratch;
+	void destroyVertexBuffer(PipelineHandle pipeline);
 
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-	void createVertexBuffer(const std::string name, VertexInput* bufferContent);
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, uint32_t usingFamiliesCount, uint32_t* usingFamilies);
-	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	// hot reload: pipelines using changed shaders are rebuilt on rebuildThread and swapped in by swapRebuiltPipelines
+	struct RebuiltPipeline {
+		bool compute;
+		// the variant for graphics pipelines
+		PipelineHandle handle;
+		VkPipeline pipeline;
+		// the vertex and fragment shader's code, only the first for compute pipelines
+		uint64_t shaderHashes[2];
+	};
+	struct RetiredPipeline {
+		VkPipeline pipeline;
+		uint64_t retiredAt;
+	};
+	std::vector<std::string> changedShaderPaths;
+	std::thread rebuildThread;
+	bool rebuilding = false;
+	std::atomic<bool> rebuildFinished{ false };
+	std::vector<RebuiltPipeline> rebuiltPipelines;
+	std::vector<RetiredPipeline> retiredPipelines;
+	uint64_t swapCount = 0;
+	void startRebuild();
 public: 
-	PipelineManager(VkPhysicalDevice physicalDevice, VkDevice device, VkRenderPass renderPass, uint32_t transferFamilyIndex, uint32_t graphicsFamilyIndex);
+	PipelineManager(VkPhysicalDevice physicalDevice, VkDevice device, VkRenderPass renderPass, VkPipelineCache pipelineCache, ThreadPool* threadPool, GpuAllocator* allocator, uint32_t transferFamilyIndex, uint32_t graphicsFamilyIndex, bool drawIndirectCount);
 	~PipelineManager();
+	// Pipelines whose input has a dataSize of 0 get no vertex buffer of their own, their draws bind one.
+	// Creating pipelines again under names that exist, with shaders seen before and inputs of the same data size, allocates
+	// nothing outside of Vulkan once the scratch space has grown to the batch size; the vertex buffers and their contents are kept.
 	void createPipelines(size_t infosCount, PipelineCreateInfo* createInfos);
-	void writeCommands(VkCommandBuffer buffer);
-	void writeVertexData(void* vertexData, std::string name);
+	void createComputePipelines(size_t infosCount, ComputePipelineCreateInfo* createInfos);
+	// both throw for names that were never created
+	PipelineHandle findPipeline(const std::string& name) const;
+	PipelineHandle findComputePipeline(const std::string& name) const;
+	size_t getPipelineCount() const;
+	// how many VkPipelines the graphics pipeline handles share
+	size_t getVariantCount() const;
+	// also hands the profiler to the upload ring, which can time its transfers only with hostQueryReset enabled
+	void setProfiler(Profiler* profiler, bool hostQueryReset);
+	void bindStorageBuffers(PipelineHandle computePipeline, size_t bufferCount, const VkBuffer* buffers);
+	// records a dispatch outside of a render pass; pushConstants has the size given at creation
+	void writeDispatch(VkCommandBuffer buffer, PipelineHandle computePipeline, uint32_t groupCountX, const void* pushConstants);
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, GpuAllocation& bufferMemory, uint32_t usingFamiliesCount, uint32_t* usingFamilies);
+	UploadRing* getUploadRing();
+	void beginSecondary(VkCommandBuffer buffer, VkCommandBufferUsageFlags flags);
+	// Scopes each run of draws with the same pipeline when a profiler is given. Pipelines that share a variant are bound
+	// once for consecutive draws, so draws sorted by state bind only as often as the state changes.
+	void writeCommands(VkCommandBuffer buffer, VkExtent2D extent, size_t drawCount, const DrawCommand* draws, const GpuScopeTarget& scopes = GpuScopeTarget());
+	void setStaticDraws(size_t drawCount, const DrawCommand* draws);
+	VkCommandBuffer getStaticCommands(uint32_t frameIndex, VkExtent2D extent);
+	void writeVertexData(void* vertexData, PipelineHandle pipeline);
+	// queues a rebuild of every pipeline that uses one of the compiled shaders at paths
+	void rebuildPipelinesUsing(size_t pathCount, const std::string* paths);
+	// Called once per frame after waiting for its fence and before recording. Swaps in finished rebuilds, starts the
+	// queued ones and destroys pipelines that were swapped out framesInFlight calls ago, as well as the shader modules no
+	// pipeline in use was built from. Returns how many were swapped in.
+	size_t swapRebuiltPipelines(size_t framesInFlight);
+	UploadSubmission submitUploads();
 };
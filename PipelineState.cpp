@@ -0,0 +1,114 @@
+#include "PipelineState.h"
+#include <cstring>
+
+namespace {
+    // FNV-1a, as ShaderCode::hash
+    struct StateHasher {
+        uint64_t hash = 14695981039346656037ull;
+        template <typename T>
+        void mix(const T& value) {
+            unsigned char bytes[sizeof(T)];
+            memcpy(bytes, &value, sizeof(T));
+            for (size_t i = 0; i < sizeof(T); i++) {
+                this->hash = (this->hash ^ bytes[i]) * 1099511628211ull;
+            }
+        }
+    };
+}
+
+uint64_t PipelineState::hash() const
+{
+    StateHasher hasher;
+    hasher.mix(this->topology);
+    hasher.mix(this->rasterization.polygonMode);
+    hasher.mix(this->rasterization.cullMode);
+    hasher.mix(this->rasterization.frontFace);
+    hasher.mix(this->rasterization.lineWidth);
+    hasher.mix(this->rasterization.dynamicLineWidth);
+    hasher.mix(this->samples);
+    hasher.mix(this->blend.enable);
+    hasher.mix(this->blend.srcColorFactor);
+    hasher.mix(this->blend.dstColorFactor);
+    hasher.mix(this->blend.colorOp);
+    hasher.mix(this->blend.srcAlphaFactor);
+    hasher.mix(this->blend.dstAlphaFactor);
+    hasher.mix(this->blend.alphaOp);
+    hasher.mix(this->blend.writeMask);
+    return hasher.hash;
+}
+bool PipelineState::operator==(const PipelineState& other) const
+{
+    return this->topology == other.topology
+        && this->rasterization.polygonMode == other.rasterization.polygonMode
+        && this->rasterization.cullMode == other.rasterization.cullMode
+        && this->rasterization.frontFace == other.rasterization.frontFace
+        && this->rasterization.lineWidth == other.rasterization.lineWidth
+        && this->rasterization.dynamicLineWidth == other.rasterization.dynamicLineWidth
+        && this->samples == other.samples
+        && this->blend.enable == other.blend.enable
+        && this->blend.srcColorFactor == other.blend.srcColorFactor
+        && this->blend.dstColorFactor == other.blend.dstColorFactor
+        && this->blend.colorOp == other.blend.colorOp
+        && this->blend.srcAlphaFactor == other.blend.srcAlphaFactor
+        && this->blend.dstAlphaFactor == other.blend.dstAlphaFactor
+        && this->blend.alphaOp == other.blend.alphaOp
+        && this->blend.writeMask == other.blend.writeMask;
+}
+
+void PipelineStateBlock::fill(const PipelineState& state)
+{
+    this->inputAssembly = {};
+    this->inputAssembly.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    this->inputAssembly.topology = state.topology;
+    this->inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // viewport and scissor are dynamic and set in writeCommands, so pipelines do not depend on the swapchain extent
+    this->viewportState = {};
+    this->viewportState.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    this->viewportState.viewportCount = 1;
+    this->viewportState.scissorCount = 1;
+
+    this->rasterizer = {};
+    this->rasterizer.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    this->rasterizer.depthClampEnable = VK_FALSE;
+    this->rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    this->rasterizer.polygonMode = state.rasterization.polygonMode;
+    this->rasterizer.lineWidth = state.rasterization.lineWidth;
+    this->rasterizer.cullMode = state.rasterization.cullMode;
+    this->rasterizer.frontFace = state.rasterization.frontFace;
+    this->rasterizer.depthBiasEnable = VK_FALSE;
+
+    this->multisampling = {};
+    this->multisampling.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    this->multisampling.sampleShadingEnable = VK_FALSE;
+    this->multisampling.rasterizationSamples = state.samples;
+    this->multisampling.minSampleShading = 1.0f;
+
+    this->colorBlendAttachment = {};
+    this->colorBlendAttachment.colorWriteMask = state.blend.writeMask;
+    this->colorBlendAttachment.blendEnable = state.blend.enable ? VK_TRUE : VK_FALSE;
+    this->colorBlendAttachment.srcColorBlendFactor = state.blend.srcColorFactor;
+    this->colorBlendAttachment.dstColorBlendFactor = state.blend.dstColorFactor;
+    this->colorBlendAttachment.colorBlendOp = state.blend.colorOp;
+    this->colorBlendAttachment.srcAlphaBlendFactor = state.blend.srcAlphaFactor;
+    this->colorBlendAttachment.dstAlphaBlendFactor = state.blend.dstAlphaFactor;
+    this->colorBlendAttachment.alphaBlendOp = state.blend.alphaOp;
+
+    this->colorBlending = {};
+    this->colorBlending.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    this->colorBlending.logicOpEnable = VK_FALSE;
+    this->colorBlending.logicOp = VkLogicOp::VK_LOGIC_OP_COPY;
+    this->colorBlending.attachmentCount = 1;
+    this->colorBlending.pAttachments = &this->colorBlendAttachment;
+
+    this->dynamicStates[0] = VkDynamicState::VK_DYNAMIC_STATE_VIEWPORT;
+    this->dynamicStates[1] = VkDynamicState::VK_DYNAMIC_STATE_SCISSOR;
+    uint32_t dynamicStateCount = 2;
+    if (state.rasterization.dynamicLineWidth) {
+        this->dynamicStates[dynamicStateCount++] = VkDynamicState::VK_DYNAMIC_STATE_LINE_WIDTH;
+    }
+    this->dynamicStateInfo = {};
+    this->dynamicStateInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    this->dynamicStateInfo.dynamicStateCount = dynamicStateCount;
+    this->dynamicStateInfo.pDynamicStates = this->dynamicStates;
+}
\ No newline at end of file
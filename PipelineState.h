@@ -0,0 +1,100 @@
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+#pragma once
+struct RasterizationState {
+	VkPolygonMode polygonMode;
+	VkCullModeFlags cullMode;
+	VkFrontFace frontFace;
+	float lineWidth;
+	// when set the pipeline leaves the line width dynamic and writeCommands sets lineWidth after binding it
+	bool dynamicLineWidth;
+};
+struct BlendState {
+	bool enable;
+	VkBlendFactor srcColorFactor;
+	VkBlendFactor dstColorFactor;
+	VkBlendOp colorOp;
+	VkBlendFactor srcAlphaFactor;
+	VkBlendFactor dstAlphaFactor;
+	VkBlendOp alphaOp;
+	VkColorComponentFlags writeMask;
+};
+// The fixed function state of a graphics pipeline, by value so it can be hashed and compared. Viewport and scissor are
+// always dynamic and not part of it. Built at compile time from forTopology and the with* modifiers:
+//   constexpr PipelineState lines = PipelineState::forTopology(VK_PRIMITIVE_TOPOLOGY_LINE_LIST).withLineWidth(2.0f, true);
+struct PipelineState {
+	VkPrimitiveTopology topology;
+	RasterizationState rasterization;
+	VkSampleCountFlagBits samples;
+	BlendState blend;
+
+	// filled, back faces culled, one sample, no blending
+	static constexpr PipelineState forTopology(VkPrimitiveTopology topology) {
+		PipelineState state{};
+		state.topology = topology;
+		state.rasterization.polygonMode = VkPolygonMode::VK_POLYGON_MODE_FILL;
+		state.rasterization.cullMode = VkCullModeFlagBits::VK_CULL_MODE_BACK_BIT;
+		state.rasterization.frontFace = VkFrontFace::VK_FRONT_FACE_CLOCKWISE;
+		state.rasterization.lineWidth = 1.0f;
+		state.rasterization.dynamicLineWidth = false;
+		state.samples = VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT;
+		state.blend.enable = false;
+		state.blend.srcColorFactor = VkBlendFactor::VK_BLEND_FACTOR_ONE;
+		state.blend.dstColorFactor = VkBlendFactor::VK_BLEND_FACTOR_ZERO;
+		state.blend.colorOp = VkBlendOp::VK_BLEND_OP_ADD;
+		state.blend.srcAlphaFactor = VkBlendFactor::VK_BLEND_FACTOR_ONE;
+		state.blend.dstAlphaFactor = VkBlendFactor::VK_BLEND_FACTOR_ZERO;
+		state.blend.alphaOp = VkBlendOp::VK_BLEND_OP_ADD;
+		state.blend.writeMask = VkColorComponentFlagBits::VK_COLOR_COMPONENT_R_BIT
+			| VkColorComponentFlagBits::VK_COLOR_COMPONENT_G_BIT
+			| VkColorComponentFlagBits::VK_COLOR_COMPONENT_B_BIT
+			| VkColorComponentFlagBits::VK_COLOR_COMPONENT_A_BIT;
+		return state;
+	}
+	constexpr PipelineState withPolygonMode(VkPolygonMode polygonMode) const {
+		PipelineState state = *this;
+		state.rasterization.polygonMode = polygonMode;
+		return state;
+	}
+	constexpr PipelineState withCulling(VkCullModeFlags cullMode, VkFrontFace frontFace) const {
+		PipelineState state = *this;
+		state.rasterization.cullMode = cullMode;
+		state.rasterization.frontFace = frontFace;
+		return state;
+	}
+	constexpr PipelineState withLineWidth(float lineWidth, bool dynamic) const {
+		PipelineState state = *this;
+		state.rasterization.lineWidth = lineWidth;
+		state.rasterization.dynamicLineWidth = dynamic;
+		return state;
+	}
+	// straight alpha: color * alpha + destination * (1 - alpha)
+	constexpr PipelineState withAlphaBlending() const {
+		PipelineState state = *this;
+		state.blend.enable = true;
+		state.blend.srcColorFactor = VkBlendFactor::VK_BLEND_FACTOR_SRC_ALPHA;
+		state.blend.dstColorFactor = VkBlendFactor::VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		state.blend.srcAlphaFactor = VkBlendFactor::VK_BLEND_FACTOR_ONE;
+		state.blend.dstAlphaFactor = VkBlendFactor::VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		return state;
+	}
+	// field by field, so padding never takes part
+	uint64_t hash() const;
+	bool operator==(const PipelineState& other) const;
+	bool operator!=(const PipelineState& other) const { return !(*this == other); }
+};
+// The Vulkan structs of one PipelineState, filled once and shared by every pipeline in a batch that has that state.
+struct PipelineStateBlock {
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly;
+	VkPipelineViewportStateCreateInfo viewportState;
+	VkPipelineRasterizationStateCreateInfo rasterizer;
+	VkPipelineMultisampleStateCreateInfo multisampling;
+	VkPipelineColorBlendAttachmentState colorBlendAttachment;
+	VkPipelineColorBlendStateCreateInfo colorBlending;
+	VkDynamicState dynamicStates[3];
+	VkPipelineDynamicStateCreateInfo dynamicStateInfo;
+
+	// points into itself, so it must not move until the pipelines using it are created
+	void fill(const PipelineState& state);
+};
\ No newline at end of file
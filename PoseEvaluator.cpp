@@ -0,0 +1,154 @@
+#include "PoseEvaluator.h"
+#include "PoseKernel.h"
+#include <cmath>
+#include <stdexcept>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define POSE_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// defined in PoseEvaluatorAvx2.cpp, which is compiled for AVX2
+size_t evaluatePosesAvx2(const PoseArrays& poses, size_t first, size_t count, AnimatedFigureInstance* out);
+
+void FigurePoses::resize(size_t figureCount)
+{
+    this->positionsX.resize(figureCount);
+    this->positionsY.resize(figureCount);
+    this->scales.resize(figureCount);
+    this->colors.resize(figureCount);
+    for (std::vector<float>& angles : this->boneAngles) {
+        angles.resize(figureCount);
+    }
+}
+size_t FigurePoses::size() const
+{
+    return this->positionsX.size();
+}
+
+struct ScalarBatch {
+    static const size_t WIDTH = 1;
+    float value;
+    static ScalarBatch load(const float* data) { return { *data }; }
+    static ScalarBatch broadcast(float value) { return { value }; }
+    void store(float* data) const { *data = this->value; }
+};
+static inline ScalarBatch operator+(ScalarBatch a, ScalarBatch b) { return { a.value + b.value }; }
+static inline ScalarBatch operator-(ScalarBatch a, ScalarBatch b) { return { a.value - b.value }; }
+static inline ScalarBatch operator*(ScalarBatch a, ScalarBatch b) { return { a.value * b.value }; }
+static inline ScalarBatch min(ScalarBatch a, ScalarBatch b) { return { a.value < b.value ? a.value : b.value }; }
+static inline ScalarBatch max(ScalarBatch a, ScalarBatch b) { return { a.value > b.value ? a.value : b.value }; }
+// half to even like the SIMD conversions
+static inline ScalarBatch roundNearest(ScalarBatch a) { return { std::nearbyint(a.value) }; }
+
+#ifdef POSE_X86
+struct SseBatch {
+    static const size_t WIDTH = 4;
+    __m128 value;
+    static SseBatch load(const float* data) { return { _mm_loadu_ps(data) }; }
+    static SseBatch broadcast(float value) { return { _mm_set1_ps(value) }; }
+    void store(float* data) const { _mm_storeu_ps(data, this->value); }
+};
+static inline SseBatch operator+(SseBatch a, SseBatch b) { return { _mm_add_ps(a.value, b.value) }; }
+static inline SseBatch operator-(SseBatch a, SseBatch b) { return { _mm_sub_ps(a.value, b.value) }; }
+static inline SseBatch operator*(SseBatch a, SseBatch b) { return { _mm_mul_ps(a.value, b.value) }; }
+static inline SseBatch min(SseBatch a, SseBatch b) { return { _mm_min_ps(a.value, b.value) }; }
+static inline SseBatch max(SseBatch a, SseBatch b) { return { _mm_max_ps(a.value, b.value) }; }
+// SSE2 has no rounding instruction, the conversion rounds with the default mode; the angles are far below 2^31
+static inline SseBatch roundNearest(SseBatch a) { return { _mm_cvtepi32_ps(_mm_cvtps_epi32(a.value)) }; }
+#endif
+
+static bool cpuHasAvx2()
+{
+#if defined(POSE_X86) && defined(__GNUC__)
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#elif defined(POSE_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    if (!osSavesYmm || !avx || !fma || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+bool PoseEvaluator::isSupported(PoseEvaluationPath path)
+{
+    static const bool hasAvx2 = cpuHasAvx2();
+    switch (path) {
+    case PoseEvaluationPath::Scalar:
+        return true;
+    case PoseEvaluationPath::Sse:
+#ifdef POSE_X86
+        return true;
+#else
+        return false;
+#endif
+    case PoseEvaluationPath::Avx2:
+        return hasAvx2;
+    }
+    return false;
+}
+PoseEvaluationPath PoseEvaluator::getWidestPath()
+{
+    if (isSupported(PoseEvaluationPath::Avx2)) {
+        return PoseEvaluationPath::Avx2;
+    }
+    if (isSupported(PoseEvaluationPath::Sse)) {
+        return PoseEvaluationPath::Sse;
+    }
+    return PoseEvaluationPath::Scalar;
+}
+const char* PoseEvaluator::getName(PoseEvaluationPath path)
+{
+    switch (path) {
+    case PoseEvaluationPath::Scalar:
+        return "scalar";
+    case PoseEvaluationPath::Sse:
+        return "SSE";
+    case PoseEvaluationPath::Avx2:
+        return "AVX2";
+    }
+    return "unknown";
+}
+void PoseEvaluator::evaluate(const FigurePoses& poses, size_t first, size_t count, AnimatedFigureInstance* out, PoseEvaluationPath path)
+{
+    if (!isSupported(path)) {
+        throw std::runtime_error(std::string("pose evaluation path ") + getName(path) + " is not supported on this CPU!");
+    }
+    if (first + count > poses.size()) {
+        throw std::runtime_error("pose evaluation past the last figure!");
+    }
+    PoseArrays arrays;
+    arrays.positionsX = poses.positionsX.data();
+    arrays.positionsY = poses.positionsY.data();
+    arrays.scales = poses.scales.data();
+    arrays.colors = poses.colors.data();
+    for (uint32_t bone = 0; bone < SKELETON_BONE_COUNT; bone++) {
+        arrays.boneAngles[bone] = poses.boneAngles[bone].data();
+    }
+
+    size_t done = 0;
+    if (path == PoseEvaluationPath::Avx2) {
+        done = evaluatePosesAvx2(arrays, first, count, out);
+    }
+#ifdef POSE_X86
+    else if (path == PoseEvaluationPath::Sse) {
+        done = evaluateBatches<SseBatch>(arrays, first, count, out);
+    }
+#endif
+    // what does not fill a whole batch
+    evaluateBatches<ScalarBatch>(arrays, first + done, count - done, out + done);
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "AnimatedFigureVertexInput.h"
+
+#pragma once
+// Placement and joint angles of every animated figure, one array per value. A bone's angle is relative to its parent
+// bone, 0 continues it straight; the spine starts pointing up and the legs pointing down from the hip.
+struct FigurePoses {
+	std::vector<float> positionsX;
+	std::vector<float> positionsY;
+	std::vector<float> scales;
+	std::vector<uint32_t> colors;
+	std::vector<float> boneAngles[SKELETON_BONE_COUNT];
+
+	void resize(size_t figureCount);
+	size_t size() const;
+};
+enum class PoseEvaluationPath {
+	Scalar,
+	// 4 figures at a time, always there on x86
+	Sse,
+	// 8 figures at a time, when the CPU has AVX2 and FMA
+	Avx2
+};
+// Forward kinematics from joint angles to screen positions of the joints, batches of figures at a time.
+// All paths share one kernel and one sine polynomial, so they agree to a few ulps.
+class PoseEvaluator
+{
+public:
+	static bool isSupported(PoseEvaluationPath path);
+	static PoseEvaluationPath getWidestPath();
+	static const char* getName(PoseEvaluationPath path);
+	// writes figures [first, first + count) to out[0] .. out[count - 1], which may be mapped device memory:
+	// every instance is written whole and in order
+	static void evaluate(const FigurePoses& poses, size_t first, size_t count, AnimatedFigureInstance* out, PoseEvaluationPath path);
+};
\ No newline at end of file
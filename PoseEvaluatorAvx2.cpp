@@ -0,0 +1,40 @@
+#include "PoseEvaluator.h"
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+// Only the code below is compiled for AVX2 and FMA, the headers above keep the project's target. PoseEvaluator only
+// calls in here after checking the CPU. MSVC needs no switch for the intrinsics.
+#ifdef __GNUC__
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+#include "PoseKernel.h"
+
+struct AvxBatch {
+    static const size_t WIDTH = 8;
+    __m256 value;
+    static AvxBatch load(const float* data) { return { _mm256_loadu_ps(data) }; }
+    static AvxBatch broadcast(float value) { return { _mm256_set1_ps(value) }; }
+    void store(float* data) const { _mm256_storeu_ps(data, this->value); }
+};
+static inline AvxBatch operator+(AvxBatch a, AvxBatch b) { return { _mm256_add_ps(a.value, b.value) }; }
+static inline AvxBatch operator-(AvxBatch a, AvxBatch b) { return { _mm256_sub_ps(a.value, b.value) }; }
+static inline AvxBatch operator*(AvxBatch a, AvxBatch b) { return { _mm256_mul_ps(a.value, b.value) }; }
+static inline AvxBatch min(AvxBatch a, AvxBatch b) { return { _mm256_min_ps(a.value, b.value) }; }
+static inline AvxBatch max(AvxBatch a, AvxBatch b) { return { _mm256_max_ps(a.value, b.value) }; }
+static inline AvxBatch roundNearest(AvxBatch a) { return { _mm256_round_ps(a.value, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC) }; }
+
+size_t evaluatePosesAvx2(const PoseArrays& poses, size_t first, size_t count, AnimatedFigureInstance* out)
+{
+    return evaluateBatches<AvxBatch>(poses, first, count, out);
+}
+#ifdef __GNUC__
+#pragma GCC pop_options
+#endif
+#else
+#include "PoseKernel.h"
+
+size_t evaluatePosesAvx2(const PoseArrays& poses, size_t first, size_t count, AnimatedFigureInstance* out)
+{
+    return 0;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include "AnimatedFigureVertexInput.h"
+
+#pragma once
+// The pose evaluation kernel, written once against a batch type F that holds F::WIDTH floats and provides
+// load/broadcast/store, + - *, min, max and roundNearest. Included by PoseEvaluator.cpp for the scalar and SSE batches
+// and by PoseEvaluatorAvx2.cpp, which compiles it for AVX2. Everything here is static, so the differently compiled
+// copies never get merged by the linker.
+
+// raw pointers into FigurePoses, so the kernel instantiates nothing from the standard library
+struct PoseArrays {
+	const float* positionsX;
+	const float* positionsY;
+	const float* scales;
+	const uint32_t* colors;
+	const float* boneAngles[SKELETON_BONE_COUNT];
+};
+
+const float POSE_HIP_Y = 0.3f;
+const float POSE_HEAD_RADIUS = 0.25f;
+const uint32_t POSE_ROOT = UINT32_MAX;
+// per bone: parent bone (POSE_ROOT for the bones starting at the hip), direction of the root when there is no
+// parent, and length, in figure units
+static const uint32_t POSE_BONE_PARENTS[SKELETON_BONE_COUNT] = { POSE_ROOT, 0, 1, 0, 3, POSE_ROOT, 5, POSE_ROOT, 7 };
+static const float POSE_ROOT_ANGLES[SKELETON_BONE_COUNT] = { 3.14159265f, 0, 0, 0, 0, 0, 0, 0, 0 };
+static const float POSE_BONE_LENGTHS[SKELETON_BONE_COUNT] = { 0.8f, 0.35f, 0.3f, 0.35f, 0.3f, 0.4f, 0.35f, 0.4f, 0.35f };
+// the joint each bone starts at
+static const uint32_t POSE_BONE_START_JOINTS[SKELETON_BONE_COUNT] = { 0, 1, 2, 1, 4, 0, 6, 0, 8 };
+
+// the head sits on the neck in line with the spine, like shaders/animatedfigure.vert draws it
+static inline void getHeadCenter(const AnimatedFigureInstance& figure, float& x, float& y)
+{
+	const float* hip = figure.joints[(uint32_t)Joint::Hip];
+	const float* neck = figure.joints[(uint32_t)Joint::Neck];
+	float spineX = neck[0] - hip[0];
+	float spineY = neck[1] - hip[1];
+	float spineLength = std::sqrt(spineX * spineX + spineY * spineY);
+	float scale = spineLength > 0.0f ? figure.headRadius / spineLength : 0.0f;
+	x = neck[0] + spineX * scale;
+	y = neck[1] + spineY * scale;
+}
+
+// Taylor series to x^11, good to about 1e-7 for |x| <= pi/2.
+template <typename F>
+static inline F sinHalfPeriod(F x)
+{
+	F x2 = x * x;
+	F p = F::broadcast(-2.5052108e-8f);
+	p = p * x2 + F::broadcast(2.7557319e-6f);
+	p = p * x2 + F::broadcast(-1.9841270e-4f);
+	p = p * x2 + F::broadcast(8.3333333e-3f);
+	p = p * x2 + F::broadcast(-1.6666667e-1f);
+	return x + x * x2 * p;
+}
+template <typename F>
+static inline F sinAny(F x)
+{
+	const float PI = 3.14159265f;
+	// to [-pi, pi], then mirrored around +-pi/2 into [-pi/2, pi/2], where sin takes the same values
+	x = x - F::broadcast(2.0f * PI) * roundNearest(x * F::broadcast(0.5f / PI));
+	F mirrored = min(x, F::broadcast(PI) - x);
+	return sinHalfPeriod(max(mirrored, F::broadcast(-PI) - mirrored));
+}
+template <typename F>
+static inline F cosAny(F x)
+{
+	return sinAny(x + F::broadcast(1.57079633f));
+}
+
+// Evaluates whole batches of figures [first, first + count) and returns how many it did; the rest is left to a
+// narrower batch type. Bones come in parent first order, so each one starts where its parent ended.
+template <typename F>
+static size_t evaluateBatches(const PoseArrays& poses, size_t first, size_t count, AnimatedFigureInstance* out)
+{
+	const size_t WIDTH = F::WIDTH;
+	alignas(32) float jointsX[SKELETON_JOINT_COUNT][WIDTH];
+	alignas(32) float jointsY[SKELETON_JOINT_COUNT][WIDTH];
+	alignas(32) float headRadii[WIDTH];
+	size_t batchEnd = count - count % WIDTH;
+	for (size_t batch = 0; batch < batchEnd; batch += WIDTH) {
+		size_t figure = first + batch;
+		F scale = F::load(poses.scales + figure);
+		F boneX[SKELETON_JOINT_COUNT];
+		F boneY[SKELETON_JOINT_COUNT];
+		F worldAngles[SKELETON_BONE_COUNT];
+		boneX[0] = F::load(poses.positionsX + figure);
+		boneY[0] = F::load(poses.positionsY + figure) + scale * F::broadcast(POSE_HIP_Y);
+		for (uint32_t bone = 0; bone < SKELETON_BONE_COUNT; bone++) {
+			F parentAngle = POSE_BONE_PARENTS[bone] == POSE_ROOT ? F::broadcast(POSE_ROOT_ANGLES[bone]) : worldAngles[POSE_BONE_PARENTS[bone]];
+			worldAngles[bone] = parentAngle + F::load(poses.boneAngles[bone] + figure);
+			F length = scale * F::broadcast(POSE_BONE_LENGTHS[bone]);
+			// an angle of 0 points down the screen
+			boneX[bone + 1] = boneX[POSE_BONE_START_JOINTS[bone]] + length * sinAny(worldAngles[bone]);
+			boneY[bone + 1] = boneY[POSE_BONE_START_JOINTS[bone]] + length * cosAny(worldAngles[bone]);
+		}
+		for (uint32_t joint = 0; joint < SKELETON_JOINT_COUNT; joint++) {
+			boneX[joint].store(jointsX[joint]);
+			boneY[joint].store(jointsY[joint]);
+		}
+		(scale * F::broadcast(POSE_HEAD_RADIUS)).store(headRadii);
+
+		for (size_t lane = 0; lane < WIDTH; lane++) {
+			AnimatedFigureInstance& instance = out[batch + lane];
+			for (uint32_t joint = 0; joint < SKELETON_JOINT_COUNT; joint++) {
+				instance.joints[joint][0] = jointsX[joint][lane];
+				instance.joints[joint][1] = jointsY[joint][lane];
+			}
+			instance.headRadius = headRadii[lane];
+			instance.color = poses.colors[figure + lane];
+		}
+	}
+	return batchEnd;
+}
\ No newline at end of file
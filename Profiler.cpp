@@ -0,0 +1,337 @@
+#include "Profiler.h"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+namespace {
+    std::atomic<uint32_t> nextThreadId{ 1 };
+    uint32_t getThreadId() {
+        thread_local uint32_t threadId = nextThreadId.fetch_add(1);
+        return threadId;
+    }
+    void writeJsonString(std::ostream& out, const std::string& text) {
+        out << '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out << '\\';
+            }
+            out << c;
+        }
+        out << '"';
+    }
+}
+
+Profiler::Profiler(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t graphicsFamilyIndex, uint32_t framesInFlight, bool tracing)
+{
+    this->device = device;
+    this->graphicsFamilyIndex = graphicsFamilyIndex;
+    this->tracing = tracing;
+    this->startTime = Clock::now();
+    this->frameName = this->registerName("frame");
+    if (tracing) {
+        // so recording events never allocates in the middle of a frame
+        this->events.reserve(MAX_TRACE_EVENTS);
+    }
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    for (const VkQueueFamilyProperties& family : queueFamilies) {
+        uint32_t validBits = family.timestampValidBits;
+        this->timestampMasks.push_back(validBits == 0 ? 0 : validBits >= 64 ? UINT64_MAX : ((uint64_t)1 << validBits) - 1);
+    }
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    this->timestampPeriod = deviceProperties.limits.timestampPeriod;
+
+    if (!this->hasGpuTimestamps()) {
+        std::cout << "timestamps are not supported on the graphics queue, GPU frame time will not be measured\n";
+        return;
+    }
+    // two timestamps (begin, end) per scope, one pool per frame in flight written by that frame's command buffers
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VkQueryType::VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = MAX_SCOPES * 2;
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        this->frames.emplace_back(new FrameQueries());
+        this->frames[i]->scopeNames.resize(MAX_SCOPES, NameRegistry::INVALID_ID);
+        this->frames[i]->results.resize(MAX_SCOPES * 4);
+        if (vkCreateQueryPool(this->device, &queryPoolInfo, nullptr, &this->frames[i]->pool) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+    }
+}
+
+Profiler::~Profiler()
+{
+    for (auto& frame : this->frames) {
+        vkDestroyQueryPool(this->device, frame->pool, nullptr);
+    }
+}
+
+bool Profiler::hasGpuTimestamps() const
+{
+    return this->getTimestampMask(this->graphicsFamilyIndex) != 0;
+}
+
+uint64_t Profiler::getTimestampMask(uint32_t familyIndex) const
+{
+    return familyIndex < this->timestampMasks.size() ? this->timestampMasks[familyIndex] : 0;
+}
+
+double Profiler::getTimestampPeriod() const
+{
+    return this->timestampPeriod;
+}
+
+uint32_t Profiler::registerName(std::string_view name)
+{
+    std::lock_guard<std::mutex> lock(this->namesMutex);
+    return this->names.intern(name);
+}
+
+bool Profiler::isTracing() const
+{
+    return this->tracing;
+}
+
+int64_t Profiler::ticksToNanoseconds(uint64_t ticks, uint64_t mask) const
+{
+    return (int64_t)((ticks & mask) * this->timestampPeriod);
+}
+
+void Profiler::addEvent(const TraceEvent& event)
+{
+    std::lock_guard<std::mutex> lock(this->eventsMutex);
+    if (this->events.size() < MAX_TRACE_EVENTS) {
+        this->events.push_back(event);
+    }
+}
+
+bool Profiler::collect(uint32_t frameIndex)
+{
+    if (frameIndex >= this->frames.size() || !this->frames[frameIndex]->recorded) {
+        return false;
+    }
+    FrameQueries& frame = *this->frames[frameIndex];
+    frame.recorded = false;
+
+    // The frame's fence has signaled, so every query its command buffers wrote is available and nothing waits here.
+    // Queries between the cached and the frame scopes were only reset and come back unavailable.
+    uint32_t scopeCount = std::min(frame.nextScope.load(), MAX_SCOPES);
+    const uint64_t* results = frame.results.data();
+    VkResult result = vkGetQueryPoolResults(this->device, frame.pool, 0, scopeCount * 2, scopeCount * 4 * sizeof(uint64_t), frame.results.data(), sizeof(uint64_t) * 2,
+        VkQueryResultFlagBits::VK_QUERY_RESULT_64_BIT | VkQueryResultFlagBits::VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VkResult::VK_SUCCESS && result != VkResult::VK_NOT_READY) {
+        return false;
+    }
+    uint64_t mask = this->getTimestampMask(this->graphicsFamilyIndex);
+    auto scopeAvailable = [&](uint32_t scope) {
+        return results[scope * 4 + 1] != 0 && results[scope * 4 + 3] != 0;
+    };
+    if (frame.frameScope == NO_SCOPE || !scopeAvailable(frame.frameScope)) {
+        return false;
+    }
+    uint64_t frameBegin = results[frame.frameScope * 4];
+    this->lastFrameMilliseconds = this->ticksToNanoseconds(results[frame.frameScope * 4 + 2] - frameBegin, mask) / 1000000.0;
+    if (!this->tracing) {
+        return true;
+    }
+
+    int64_t frameBeginNanoseconds = this->ticksToNanoseconds(frameBegin, mask);
+    int64_t offset = frame.submitTime - frameBeginNanoseconds;
+    if (!this->gpuOffsetKnown || offset > this->gpuOffset) {
+        this->gpuOffset = offset;
+        this->gpuOffsetKnown = true;
+    }
+    for (uint32_t scope = 0; scope < scopeCount; scope++) {
+        if (!scopeAvailable(scope)) {
+            continue;
+        }
+        TraceEvent event;
+        event.name = frame.scopeNames[scope];
+        event.thread = 0;
+        event.start = this->ticksToNanoseconds(results[scope * 4], mask);
+        event.duration = this->ticksToNanoseconds(results[scope * 4 + 2] - results[scope * 4], mask);
+        this->addEvent(event);
+    }
+    return true;
+}
+
+double Profiler::getLastFrameMilliseconds() const
+{
+    return this->lastFrameMilliseconds;
+}
+
+void Profiler::writeTimestamp(VkCommandBuffer buffer, uint32_t frameIndex, uint32_t query, VkPipelineStageFlagBits stage)
+{
+    vkCmdWriteTimestamp(buffer, stage, this->frames[frameIndex]->pool, query);
+}
+
+void Profiler::beginFrame(VkCommandBuffer buffer, uint32_t frameIndex)
+{
+    if (frameIndex >= this->frames.size()) {
+        return;
+    }
+    FrameQueries& frame = *this->frames[frameIndex];
+    // the whole pool, cached scopes included: their command buffers write them again when the frame executes them
+    vkCmdResetQueryPool(buffer, frame.pool, 0, MAX_SCOPES * 2);
+    frame.nextScope = CACHED_SCOPES;
+    frame.frameScope = NO_SCOPE;
+    GpuScopeTarget target;
+    target.profiler = this;
+    target.frameIndex = frameIndex;
+    frame.frameScope = this->beginGpuScope(buffer, target, this->frameName);
+}
+
+void Profiler::endFrame(VkCommandBuffer buffer, uint32_t frameIndex)
+{
+    if (frameIndex >= this->frames.size()) {
+        return;
+    }
+    FrameQueries& frame = *this->frames[frameIndex];
+    GpuScopeTarget target;
+    target.profiler = this;
+    target.frameIndex = frameIndex;
+    this->endGpuScope(buffer, target, frame.frameScope);
+    frame.recorded = true;
+}
+
+void Profiler::markSubmitted(uint32_t frameIndex)
+{
+    if (frameIndex < this->frames.size()) {
+        this->frames[frameIndex]->submitTime = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - this->startTime).count();
+    }
+}
+
+void Profiler::discardFrame(uint32_t frameIndex)
+{
+    if (frameIndex < this->frames.size()) {
+        this->frames[frameIndex]->recorded = false;
+    }
+}
+
+uint32_t Profiler::beginGpuScope(VkCommandBuffer buffer, const GpuScopeTarget& target, uint32_t name)
+{
+    if (target.frameIndex >= this->frames.size()) {
+        return NO_SCOPE;
+    }
+    FrameQueries& frame = *this->frames[target.frameIndex];
+    // only the frame scope is needed for the frame time, the named scopes are for the trace
+    if (!this->tracing && name != this->frameName) {
+        return NO_SCOPE;
+    }
+    uint32_t scope;
+    if (target.cached) {
+        // cached command buffers are recorded on the main thread
+        if (frame.cachedScopeCount == CACHED_SCOPES) {
+            return NO_SCOPE;
+        }
+        scope = frame.cachedScopeCount++;
+    }
+    else {
+        scope = frame.nextScope.fetch_add(1);
+        if (scope >= MAX_SCOPES) {
+            return NO_SCOPE;
+        }
+    }
+    frame.scopeNames[scope] = name;
+    this->writeTimestamp(buffer, target.frameIndex, scope * 2, VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    return scope;
+}
+
+void Profiler::endGpuScope(VkCommandBuffer buffer, const GpuScopeTarget& target, uint32_t scope)
+{
+    if (scope == NO_SCOPE) {
+        return;
+    }
+    this->writeTimestamp(buffer, target.frameIndex, scope * 2 + 1, VkPipelineStageFlagBits::VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+}
+
+void Profiler::resetCachedScopes(uint32_t frameIndex)
+{
+    if (frameIndex < this->frames.size()) {
+        this->frames[frameIndex]->cachedScopeCount = 0;
+    }
+}
+
+void Profiler::addGpuScope(uint32_t name, uint64_t beginTicks, uint64_t endTicks, uint64_t mask)
+{
+    if (!this->tracing) {
+        return;
+    }
+    TraceEvent event;
+    event.name = name;
+    event.thread = 0;
+    event.start = this->ticksToNanoseconds(beginTicks, mask);
+    event.duration = this->ticksToNanoseconds(endTicks - beginTicks, mask);
+    this->addEvent(event);
+}
+
+void Profiler::addCpuScope(uint32_t name, Clock::time_point begin, Clock::time_point end)
+{
+    if (!this->tracing) {
+        return;
+    }
+    TraceEvent event;
+    event.name = name;
+    event.thread = getThreadId();
+    event.start = std::chrono::duration_cast<std::chrono::nanoseconds>(begin - this->startTime).count();
+    event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    this->addEvent(event);
+}
+
+// Writes the Trace Event Format: complete ("X") events in microseconds, with the GPU as thread 0.
+void Profiler::writeChromeTrace(const std::string& path)
+{
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("failed to open trace file " + path + "!");
+    }
+    std::lock_guard<std::mutex> eventsLock(this->eventsMutex);
+    std::lock_guard<std::mutex> namesLock(this->namesMutex);
+    uint32_t threadCount = nextThreadId.load();
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (uint32_t thread = 0; thread < threadCount; thread++) {
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":";
+        writeJsonString(out, thread == 0 ? "GPU" : "CPU thread " + std::to_string(thread));
+        out << "}}";
+        out << (thread + 1 < threadCount || !this->events.empty() ? ",\n" : "\n");
+    }
+    out.precision(3);
+    out << std::fixed;
+    for (size_t i = 0; i < this->events.size(); i++) {
+        const TraceEvent& event = this->events[i];
+        // GPU timestamps are moved onto the CPU clock only now, when the offset has seen every frame
+        int64_t start = event.thread == 0 ? event.start + this->gpuOffset : event.start;
+        out << "{\"name\":";
+        writeJsonString(out, this->names.getName(event.name));
+        out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":" << start / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << "}";
+        out << (i + 1 < this->events.size() ? ",\n" : "\n");
+    }
+    out << "]}\n";
+    if (this->events.size() == MAX_TRACE_EVENTS) {
+        std::cout << "trace stopped after " << MAX_TRACE_EVENTS << " events\n";
+    }
+    std::cout << "wrote " << this->events.size() << " trace events to " << path << "\n";
+}
+
+CpuScope::CpuScope(Profiler* profiler, uint32_t name)
+{
+    this->profiler = profiler;
+    this->name = name;
+    if (profiler) {
+        this->begin = std::chrono::steady_clock::now();
+    }
+}
+
+CpuScope::~CpuScope()
+{
+    if (this->profiler) {
+        this->profiler->addCpuScope(this->name, this->begin, std::chrono::steady_clock::now());
+    }
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include "NameRegistry.h"
+
+#pragma once
+class Profiler;
+// Where a recording function writes its GPU scopes; the default records none.
+// Cached command buffers, the ones replayed over several frames, use the frame's cached scopes.
+struct GpuScopeTarget {
+	Profiler* profiler = nullptr;
+	uint32_t frameIndex = 0;
+	bool cached = false;
+};
+// GPU timestamp scopes recorded into command buffers and CPU scopes around host work, exported as Chrome trace JSON
+// that Perfetto and chrome://tracing open.
+// Every frame in flight has its own query pool, reset at the start of the frame's primary command buffer and read
+// back by collect once the frame's fence has signaled, so reading never waits on the GPU. GPU times are put on the
+// CPU timeline with the smallest observed gap between a frame's submit and its first timestamp.
+// Scope names are registered once up front; beginning and ending scopes is safe from any recording thread.
+class Profiler
+{
+public:
+	// queries per frame in flight, the first CACHED_SCOPES pairs belong to cached command buffers
+	static const uint32_t MAX_SCOPES = 1024;
+	static const uint32_t CACHED_SCOPES = 128;
+	static const uint32_t NO_SCOPE = UINT32_MAX;
+	// trace events kept before tracing stops, about 24 MB
+	static const size_t MAX_TRACE_EVENTS = 1000000;
+	typedef std::chrono::steady_clock Clock;
+private:
+	struct FrameQueries {
+		VkQueryPool pool = VK_NULL_HANDLE;
+		bool recorded = false;
+		int64_t submitTime = 0;
+		uint32_t cachedScopeCount = 0;
+		std::atomic<uint32_t> nextScope{ CACHED_SCOPES };
+		uint32_t frameScope = NO_SCOPE;
+		// name id per scope
+		std::vector<uint32_t> scopeNames;
+		// what collect reads the queries into, begin, availability, end, availability per scope
+		std::vector<uint64_t> results;
+	};
+	struct TraceEvent {
+		uint32_t name;
+		// 0 is the GPU, CPU threads count up from 1
+		uint32_t thread;
+		// nanoseconds, CPU events since the profiler was created, GPU events in timestamp time
+		int64_t start;
+		int64_t duration;
+	};
+	VkDevice device;
+	uint32_t graphicsFamilyIndex;
+	std::vector<uint64_t> timestampMasks;
+	double timestampPeriod;
+	std::vector<std::unique_ptr<FrameQueries>> frames;
+	std::mutex namesMutex;
+	NameRegistry names;
+	uint32_t frameName;
+	bool tracing;
+	Clock::time_point startTime;
+	std::mutex eventsMutex;
+	std::vector<TraceEvent> events;
+	bool gpuOffsetKnown = false;
+	int64_t gpuOffset = 0;
+	double lastFrameMilliseconds = 0.0;
+
+	int64_t ticksToNanoseconds(uint64_t ticks, uint64_t mask) const;
+	void addEvent(const TraceEvent& event);
+	void writeTimestamp(VkCommandBuffer buffer, uint32_t frameIndex, uint32_t query, VkPipelineStageFlagBits stage);
+public:
+	Profiler(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t graphicsFamilyIndex, uint32_t framesInFlight, bool tracing);
+	~Profiler();
+	bool hasGpuTimestamps() const;
+	// 0 when the family cannot write timestamps
+	uint64_t getTimestampMask(uint32_t familyIndex) const;
+	double getTimestampPeriod() const;
+	uint32_t registerName(std::string_view name);
+	bool isTracing() const;
+
+	// After waiting for the frame's fence. Records the frame's scopes and returns true when its GPU time was available.
+	bool collect(uint32_t frameIndex);
+	double getLastFrameMilliseconds() const;
+	// start and end of the frame's primary command buffer, outside of a render pass
+	void beginFrame(VkCommandBuffer buffer, uint32_t frameIndex);
+	void endFrame(VkCommandBuffer buffer, uint32_t frameIndex);
+	void markSubmitted(uint32_t frameIndex);
+	// the frame's command buffers were recorded but will never be submitted, so collect must not read its queries
+	void discardFrame(uint32_t frameIndex);
+	// returns the scope to hand to endGpuScope, NO_SCOPE once the frame is out of queries
+	uint32_t beginGpuScope(VkCommandBuffer buffer, const GpuScopeTarget& target, uint32_t name);
+	void endGpuScope(VkCommandBuffer buffer, const GpuScopeTarget& target, uint32_t scope);
+	// the frame's cached command buffers are about to be recorded again
+	void resetCachedScopes(uint32_t frameIndex);
+	// for timestamps from query pools of their own, like the upload ring's
+	void addGpuScope(uint32_t name, uint64_t beginTicks, uint64_t endTicks, uint64_t mask);
+	void addCpuScope(uint32_t name, Clock::time_point begin, Clock::time_point end);
+	void writeChromeTrace(const std::string& path);
+};
+// Adds a CPU scope from construction to destruction; a null profiler makes it a no-op.
+class CpuScope
+{
+private:
+	Profiler* profiler;
+	uint32_t name;
+	std::chrono::steady_clock::time_point begin;
+public:
+	CpuScope(Profiler* profiler, uint32_t name);
+	~CpuScope();
+};
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "SegmentBatcher.h"
+#include "PoseKernel.h"
+#include <algorithm>
+#include <cmath>
+
+SegmentBatcher::SegmentBatcher(VkDevice device, PipelineManager* pipelineManager, GpuAllocator* allocator, ThreadPool* threadPool, uint32_t maxSegments, uint32_t framesInFlight)
+{
+    this->device = device;
+    this->allocator = allocator;
+    this->threadPool = threadPool;
+    this->maxSegments = maxSegments;
+    VkDeviceSize bufferSize = (VkDeviceSize)maxSegments * sizeof(SegmentInstance);
+    this->segmentBuffers.resize(framesInFlight);
+    this->segmentMemories.resize(framesInFlight);
+    for (uint32_t frameIndex = 0; frameIndex < framesInFlight; frameIndex++) {
+        pipelineManager->createBuffer(bufferSize,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            this->segmentBuffers[frameIndex], this->segmentMemories[frameIndex], 0, nullptr);
+    }
+    this->begin(0);
+}
+
+SegmentBatcher::~SegmentBatcher()
+{
+    for (size_t frameIndex = 0; frameIndex < this->segmentBuffers.size(); frameIndex++) {
+        vkDestroyBuffer(this->device, this->segmentBuffers[frameIndex], nullptr);
+        this->allocator->free(this->segmentMemories[frameIndex]);
+    }
+}
+
+void SegmentBatcher::begin(uint32_t frameIndex)
+{
+    this->frameIndex = frameIndex;
+    this->segments = static_cast<SegmentInstance*>(this->segmentMemories[frameIndex].mappedData);
+    this->segmentCount = 0;
+    this->droppedSegments = 0;
+}
+
+void SegmentBatcher::addSegment(float x0, float y0, float x1, float y1, float width, uint32_t color)
+{
+    if (this->segmentCount == this->maxSegments) {
+        this->droppedSegments++;
+        return;
+    }
+    this->segments[this->segmentCount++] = { x0, y0, x1, y1, width, color };
+}
+
+// points of the head outline on the unit circle, the last one closes it
+struct HeadOutline {
+    float x[ANIMATED_FIGURE_HEAD_SEGMENTS + 1];
+    float y[ANIMATED_FIGURE_HEAD_SEGMENTS + 1];
+};
+
+static void writeFigure(const AnimatedFigureInstance& figure, float width, const HeadOutline& outline, SegmentInstance* segments)
+{
+    for (uint32_t bone = 0; bone < SKELETON_BONE_COUNT; bone++) {
+        const float* start = figure.joints[POSE_BONE_START_JOINTS[bone]];
+        const float* end = figure.joints[bone + 1];
+        segments[bone] = { start[0], start[1], end[0], end[1], width, figure.color };
+    }
+    float centerX;
+    float centerY;
+    getHeadCenter(figure, centerX, centerY);
+    SegmentInstance* head = segments + SKELETON_BONE_COUNT;
+    for (uint32_t segment = 0; segment < ANIMATED_FIGURE_HEAD_SEGMENTS; segment++) {
+        head[segment] = {
+            centerX + figure.headRadius * outline.x[segment], centerY + figure.headRadius * outline.y[segment],
+            centerX + figure.headRadius * outline.x[segment + 1], centerY + figure.headRadius * outline.y[segment + 1],
+            width, figure.color };
+    }
+}
+
+void SegmentBatcher::addFigures(const AnimatedFigureInstance* figures, uint32_t figureCount, float width)
+{
+    const uint32_t FIGURES_PER_CHUNK = 1024;
+    const float TWO_PI = 6.283185307179586f;
+    uint32_t addedCount = std::min(figureCount, (this->maxSegments - this->segmentCount) / FIGURE_SEGMENT_COUNT);
+    this->droppedSegments += (figureCount - addedCount) * FIGURE_SEGMENT_COUNT;
+    SegmentInstance* firstSegment = this->segments + this->segmentCount;
+    this->segmentCount += addedCount * FIGURE_SEGMENT_COUNT;
+
+    HeadOutline outline;
+    for (uint32_t point = 0; point <= ANIMATED_FIGURE_HEAD_SEGMENTS; point++) {
+        float angle = TWO_PI * point / ANIMATED_FIGURE_HEAD_SEGMENTS;
+        outline.x[point] = std::cos(angle);
+        outline.y[point] = std::sin(angle);
+    }
+    // every figure has its own place in the buffer, so chunks are written on any thread in any order
+    size_t chunkCount = (addedCount + FIGURES_PER_CHUNK - 1) / FIGURES_PER_CHUNK;
+    auto writeChunk = [&](size_t chunk) {
+        uint32_t first = (uint32_t)chunk * FIGURES_PER_CHUNK;
+        uint32_t last = std::min(first + FIGURES_PER_CHUNK, addedCount);
+        for (uint32_t figure = first; figure < last; figure++) {
+            writeFigure(figures[figure], width, outline, firstSegment + figure * FIGURE_SEGMENT_COUNT);
+        }
+    };
+    if (this->threadPool) {
+        // a lambda holding one reference fits into the std::function without allocating
+        this->threadPool->parallelFor(chunkCount, [&writeChunk](size_t chunk) { writeChunk(chunk); });
+    }
+    else {
+        for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+            writeChunk(chunk);
+        }
+    }
+}
+
+uint32_t SegmentBatcher::getSegmentCount() const
+{
+    return this->segmentCount;
+}
+uint32_t SegmentBatcher::getDroppedSegmentCount() const
+{
+    return this->droppedSegments;
+}
+
+DrawCommand SegmentBatcher::getDraw(PipelineHandle pipeline) const
+{
+    DrawCommand draw{};
+    draw.pipeline = pipeline;
+    draw.vertexBuffer = this->segmentBuffers[this->frameIndex];
+    draw.vertexCount = SEGMENT_VERTEX_COUNT;
+    draw.instanceCount = this->segmentCount;
+    return draw;
+}
\ No newline at end of file
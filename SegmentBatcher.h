@@ -0,0 +1,43 @@
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "PipelineManager.h"
+#include "GpuAllocator.h"
+#include "ThreadPool.h"
+#include "SegmentVertexInput.h"
+#include "AnimatedFigureVertexInput.h"
+
+#pragma once
+// Segments of any width, collected anew every frame and drawn with one instanced draw. Every segment is an instance
+// in a host visible buffer of the frame in flight, and shaders/segment.vert spreads its six vertices into a quad
+// measured in pixels, so wide lines need neither the wideLines feature nor a pipeline per width. Segments past the
+// capacity are dropped and counted.
+class SegmentBatcher
+{
+private:
+	VkDevice device;
+	GpuAllocator* allocator;
+	ThreadPool* threadPool;
+	std::vector<VkBuffer> segmentBuffers;
+	std::vector<GpuAllocation> segmentMemories;
+	uint32_t maxSegments;
+	uint32_t frameIndex = 0;
+	SegmentInstance* segments = nullptr;
+	uint32_t segmentCount = 0;
+	uint32_t droppedSegments = 0;
+public:
+	// what addFigures adds per figure: its bones and the outline of its head
+	static const uint32_t FIGURE_SEGMENT_COUNT = SKELETON_BONE_COUNT + ANIMATED_FIGURE_HEAD_SEGMENTS;
+
+	// addFigures spreads the figures over threadPool, when there is one
+	SegmentBatcher(VkDevice device, PipelineManager* pipelineManager, GpuAllocator* allocator, ThreadPool* threadPool, uint32_t maxSegments, uint32_t framesInFlight);
+	~SegmentBatcher();
+	// the frame's previous submit has to be done, its segments are overwritten
+	void begin(uint32_t frameIndex);
+	void addSegment(float x0, float y0, float x1, float y1, float width, uint32_t color);
+	// Every figure as drawn by shaders/animatedfigure.vert, but width pixels wide. Figures that don't fit as a whole
+	// are dropped.
+	void addFigures(const AnimatedFigureInstance* figures, uint32_t figureCount, float width);
+	uint32_t getSegmentCount() const;
+	uint32_t getDroppedSegmentCount() const;
+	DrawCommand getDraw(PipelineHandle pipeline) const;
+};
\ No newline at end of file
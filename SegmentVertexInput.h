@@ -0,0 +1,26 @@
+#pragma once
+#include "VertexInput.h"
+#include <cstdint>
+
+// One segment of a SegmentBatcher, already on screen; shaders/segment.vert makes a quad of it.
+struct SegmentInstance {
+    float x0;
+    float y0;
+    float x1;
+    float y1;
+    // in pixels, the ends reach half of it past the endpoints
+    float width;
+    // RGBA8, red in the lowest byte
+    uint32_t color;
+};
+// two triangles per segment
+const uint32_t SEGMENT_VERTEX_COUNT = 6;
+template <>
+struct VertexLayout<SegmentInstance> {
+    static constexpr VkVertexInputBindingDescription binding = { 0, sizeof(SegmentInstance), VK_VERTEX_INPUT_RATE_INSTANCE };
+    static constexpr VkVertexInputAttributeDescription attributes[] = {
+        { 0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(SegmentInstance, x0) },
+        { 1, 0, VK_FORMAT_R32_SFLOAT, offsetof(SegmentInstance, width) },
+        { 2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(SegmentInstance, color) },
+    };
+};
\ No newline at end of file
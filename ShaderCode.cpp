@@ -0,0 +1,161 @@
+#include "ShaderCode.h"
+#include <stdexcept>
+#include <cstring>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#if !defined(SHADER_DEV_MODE) && __has_include("compiled_shaders/EmbeddedShaders.h")
+    #include "compiled_shaders/EmbeddedShaders.h"
+    #define HAS_EMBEDDED_SHADERS
+#endif
+
+std::atomic<size_t> ShaderCode::fileReadCount{ 0 };
+std::atomic<bool> ShaderCode::preferFiles{ false };
+
+ShaderCode::ShaderCode(const char* path)
+{
+#ifdef HAS_EMBEDDED_SHADERS
+    for (const EmbeddedShader& shader : EMBEDDED_SHADERS) {
+        if (!preferFiles && strcmp(path, shader.path) == 0) {
+            this->code = shader.code;
+            this->size = shader.size;
+            return;
+        }
+    }
+#endif
+    this->mapFile(path);
+}
+
+ShaderCode::ShaderCode(ShaderCode&& other) noexcept
+{
+    this->code = other.code;
+    this->size = other.size;
+    this->mapping = other.mapping;
+#ifdef _WIN32
+    this->file = other.file;
+    this->fileMapping = other.fileMapping;
+    other.file = nullptr;
+    other.fileMapping = nullptr;
+#endif
+    other.code = nullptr;
+    other.size = 0;
+    other.mapping = nullptr;
+}
+
+ShaderCode::~ShaderCode()
+{
+    if (!this->mapping) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(this->mapping);
+    CloseHandle((HANDLE)this->fileMapping);
+    CloseHandle((HANDLE)this->file);
+#else
+    munmap(this->mapping, this->size);
+#endif
+}
+
+void ShaderCode::mapFile(const char* path)
+{
+    fileReadCount++;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error(std::string("failed to open file ") + path + "!");
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    if (fileSize.QuadPart % sizeof(uint32_t) != 0) {
+        CloseHandle(file);
+        throw std::runtime_error(std::string("SPIR-V size is not a multiple of 4 in ") + path + "!");
+    }
+    HANDLE fileMapping = fileSize.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    void* mapping = fileMapping ? MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!mapping) {
+        if (fileMapping) {
+            CloseHandle(fileMapping);
+        }
+        CloseHandle(file);
+        throw std::runtime_error(std::string("failed to map file ") + path + "!");
+    }
+    this->file = file;
+    this->fileMapping = fileMapping;
+    this->size = (size_t)fileSize.QuadPart;
+#else
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        throw std::runtime_error(std::string("failed to open file ") + path + "!");
+    }
+    struct stat fileStat;
+    void* mapping = MAP_FAILED;
+    if (fstat(file, &fileStat) != 0) {
+        close(file);
+        throw std::runtime_error(std::string("failed to open file ") + path + "!");
+    }
+    if (fileStat.st_size % sizeof(uint32_t) != 0) {
+        close(file);
+        throw std::runtime_error(std::string("SPIR-V size is not a multiple of 4 in ") + path + "!");
+    }
+    if (fileStat.st_size > 0) {
+        mapping = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    // the mapping keeps the file referenced on its own
+    close(file);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error(std::string("failed to map file ") + path + "!");
+    }
+    this->size = (size_t)fileStat.st_size;
+#endif
+    this->mapping = mapping;
+    this->code = reinterpret_cast<const uint32_t*>(mapping);
+}
+
+const uint32_t* ShaderCode::getCode() const
+{
+    return this->code;
+}
+
+size_t ShaderCode::getSize() const
+{
+    return this->size;
+}
+
+uint64_t ShaderCode::hash() const
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const unsigned char* bytes, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+    uint64_t size = this->size;
+    mix(reinterpret_cast<const unsigned char*>(&size), sizeof(size));
+    mix(reinterpret_cast<const unsigned char*>(this->code), this->size);
+    return hash;
+}
+
+bool ShaderCode::hasEmbeddedShaders()
+{
+#ifdef HAS_EMBEDDED_SHADERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ShaderCode::setPreferFiles(bool preferFiles)
+{
+    ShaderCode::preferFiles = preferFiles;
+}
+
+size_t ShaderCode::getFileReadCount()
+{
+    return fileReadCount;
+}
\ No newline at end of file
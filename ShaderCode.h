@@ -0,0 +1,48 @@
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <atomic>
+
+#pragma once
+// One entry of the table tools/EmbedShaders (or shaders.ps1) generates into compiled_shaders/EmbeddedShaders.h.
+struct EmbeddedShader {
+	const char* path;
+	const uint32_t* code;
+	size_t size;
+};
+// SPIR-V of one compiled shader, looked up by its compiled_shaders/ path.
+// Release builds find it in the binary and never touch the file system. Dev builds (SHADER_DEV_MODE), and paths the
+// binary does not contain, map the file instead and keep it mapped for as long as the ShaderCode lives.
+class ShaderCode
+{
+private:
+	const uint32_t* code = nullptr;
+	size_t size = 0;
+	void* mapping = nullptr;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* fileMapping = nullptr;
+#endif
+	static std::atomic<size_t> fileReadCount;
+	static std::atomic<bool> preferFiles;
+
+	void mapFile(const char* path);
+public:
+	// looks path up and maps files without allocating, only errors build strings
+	ShaderCode(const char* path);
+	~ShaderCode();
+	ShaderCode(const ShaderCode&) = delete;
+	// takes the mapping over, other is left empty
+	ShaderCode(ShaderCode&& other) noexcept;
+	ShaderCode& operator=(const ShaderCode&) = delete;
+	const uint32_t* getCode() const;
+	// in bytes, always a multiple of 4
+	size_t getSize() const;
+	// FNV-1a over the size and the code, the same for every shader with the same content
+	uint64_t hash() const;
+	static bool hasEmbeddedShaders();
+	// makes every later ShaderCode map its file even when the binary has the shader, for hot reload
+	static void setPreferFiles(bool preferFiles);
+	// files mapped since startup, stays 0 in release builds
+	static size_t getFileReadCount();
+};
\ No newline at end of file
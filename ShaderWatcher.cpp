@@ -0,0 +1,141 @@
+#include "ShaderWatcher.h"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <sys/wait.h>
+    #include <poll.h>
+    #include <spawn.h>
+    #include <unistd.h>
+    extern char** environ;
+#endif
+
+// editors tend to write several events per save, they are collected for this long before compiling
+static const int SETTLE_MILLISECONDS = 50;
+static const int STOP_POLL_MILLISECONDS = 100;
+
+ShaderWatcher::ShaderWatcher(const std::string& sourceDirectory, const std::string& outputDirectory)
+{
+    this->sourceDirectory = sourceDirectory;
+    this->outputDirectory = outputDirectory;
+    const char* compiler = std::getenv("GLSLC");
+    this->compiler = compiler ? compiler : "glslc";
+#ifdef __linux__
+    this->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (this->inotifyFd < 0) {
+        throw std::runtime_error("failed to initialize inotify!");
+    }
+    // editors that save through a temporary file and a rename only produce IN_MOVED_TO
+    if (inotify_add_watch(this->inotifyFd, sourceDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(this->inotifyFd);
+        throw std::runtime_error("failed to watch " + sourceDirectory + "!");
+    }
+    this->thread = std::thread(&ShaderWatcher::watchLoop, this);
+#else
+    throw std::runtime_error("shader hot reload needs inotify and is only supported on Linux!");
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+    this->stopping = true;
+    if (this->thread.joinable()) {
+        this->thread.join();
+    }
+#ifdef __linux__
+    if (this->inotifyFd >= 0) {
+        close(this->inotifyFd);
+    }
+#endif
+}
+
+std::vector<std::string> ShaderWatcher::takeCompiledShaders()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::vector<std::string> compiledShaders;
+    compiledShaders.swap(this->compiledShaders);
+    return compiledShaders;
+}
+
+void ShaderWatcher::watchLoop()
+{
+#ifdef __linux__
+    std::vector<std::string> changed;
+    alignas(inotify_event) char buffer[4096];
+    while (!this->stopping) {
+        pollfd pollInfo{};
+        pollInfo.fd = this->inotifyFd;
+        pollInfo.events = POLLIN;
+        // once something changed, wait only until the writes settle
+        int ready = poll(&pollInfo, 1, changed.empty() ? STOP_POLL_MILLISECONDS : SETTLE_MILLISECONDS);
+        if (ready > 0) {
+            ssize_t length;
+            while ((length = read(this->inotifyFd, buffer, sizeof(buffer))) > 0) {
+                for (char* position = buffer; position < buffer + length; ) {
+                    const inotify_event* event = reinterpret_cast<const inotify_event*>(position);
+                    position += sizeof(inotify_event) + event->len;
+                    if (event->len == 0) {
+                        continue;
+                    }
+                    std::string name = event->name;
+                    // skip editor swap and backup files
+                    if (name[0] == '.' || name.back() == '~' || name.find(".swp") != std::string::npos) {
+                        continue;
+                    }
+                    if (std::find(changed.begin(), changed.end(), name) == changed.end()) {
+                        changed.push_back(name);
+                    }
+                }
+            }
+            continue;
+        }
+        for (const std::string& name : changed) {
+            if (this->compile(name)) {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->compiledShaders.push_back(this->outputDirectory + "/" + name + ".spv");
+            }
+        }
+        changed.clear();
+    }
+#endif
+}
+
+// Compiles to a temporary file first and renames it over the old SPIR-V, so readers never see a partial file.
+bool ShaderWatcher::compile(const std::string& name)
+{
+#ifdef __linux__
+    std::string source = this->sourceDirectory + "/" + name;
+    std::string output = this->outputDirectory + "/" + name + ".spv";
+    std::string temporary = output + ".tmp";
+    std::vector<char*> arguments = {
+        const_cast<char*>(this->compiler.c_str()),
+        const_cast<char*>(source.c_str()),
+        const_cast<char*>("-o"),
+        const_cast<char*>(temporary.c_str()),
+        nullptr
+    };
+    pid_t process;
+    // glslc's diagnostics go straight to our stderr
+    if (posix_spawnp(&process, this->compiler.c_str(), nullptr, nullptr, arguments.data(), environ) != 0) {
+        std::cerr << "failed to start " << this->compiler << std::endl;
+        return false;
+    }
+    int status;
+    if (waitpid(process, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << "failed to compile " << source << ", keeping the previous version" << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    if (std::rename(temporary.c_str(), output.c_str()) != 0) {
+        std::cerr << "failed to replace " << output << std::endl;
+        return false;
+    }
+    std::cout << "recompiled " << source << std::endl;
+    return true;
+#else
+    return false;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#pragma once
+// Watches a directory of GLSL sources and recompiles changed files with a glslc subprocess on its own thread.
+// Each successful compile writes outputDirectory/<name>.spv and is reported once by takeCompiledShaders.
+// Needs inotify, so it is only available on Linux. The compiler is $GLSLC, or glslc from PATH.
+class ShaderWatcher
+{
+private:
+	std::string sourceDirectory;
+	std::string outputDirectory;
+	std::string compiler;
+	int inotifyFd = -1;
+	std::thread thread;
+	std::atomic<bool> stopping{ false };
+	std::mutex mutex;
+	std::vector<std::string> compiledShaders;
+
+	void watchLoop();
+	bool compile(const std::string& name);
+public:
+	ShaderWatcher(const std::string& sourceDirectory, const std::string& outputDirectory);
+	~ShaderWatcher();
+	// output paths compiled since the last call
+	std::vector<std::string> takeCompiledShaders();
+};
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "Simulation.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+Simulation::Simulation(const float* positionsX, const float* positionsY, uint32_t entityCount, uint32_t tickRate)
+{
+    this->tickDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / tickRate));
+    this->tickSeconds = 1.0f / tickRate;
+    this->positionsX.assign(positionsX, positionsX + entityCount);
+    this->positionsY.assign(positionsY, positionsY + entityCount);
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> velocity(-0.3f, 0.3f);
+    this->velocitiesX.resize(entityCount);
+    this->velocitiesY.resize(entityCount);
+    for (uint32_t entity = 0; entity < entityCount; entity++) {
+        this->velocitiesX[entity] = velocity(random);
+        this->velocitiesY[entity] = velocity(random);
+    }
+    // sized once here, ticks only copy into them
+    for (uint32_t slot = 0; slot < 3; slot++) {
+        SimulationSnapshot& snapshot = this->snapshots.getSlot(slot);
+        snapshot.previousX.resize(entityCount);
+        snapshot.previousY.resize(entityCount);
+        snapshot.positionsX.resize(entityCount);
+        snapshot.positionsY.resize(entityCount);
+    }
+}
+
+Simulation::~Simulation()
+{
+    this->stop();
+}
+
+uint32_t Simulation::getEntityCount() const
+{
+    return (uint32_t)this->positionsX.size();
+}
+float Simulation::getTickSeconds() const
+{
+    return this->tickSeconds;
+}
+
+void Simulation::start()
+{
+    this->stopping.store(false, std::memory_order_relaxed);
+    this->thread = std::thread(&Simulation::run, this);
+}
+void Simulation::stop()
+{
+    if (!this->thread.joinable()) {
+        return;
+    }
+    this->stopping.store(true, std::memory_order_relaxed);
+    this->thread.join();
+}
+
+void Simulation::run()
+{
+    Clock::time_point nextTick = Clock::now();
+    while (!this->stopping.load(std::memory_order_relaxed)) {
+        Clock::time_point now = Clock::now();
+        if (now < nextTick) {
+            std::this_thread::sleep_until(nextTick);
+            continue;
+        }
+        uint64_t dueTicks = (uint64_t)((now - nextTick) / this->tickDuration) + 1;
+        if (dueTicks > MAX_CATCH_UP_TICKS) {
+            uint64_t dropped = dueTicks - MAX_CATCH_UP_TICKS;
+            this->droppedTicks.fetch_add(dropped, std::memory_order_relaxed);
+            nextTick += this->tickDuration * dropped;
+        }
+        this->tick(nextTick);
+        nextTick += this->tickDuration;
+    }
+}
+
+void Simulation::tick(Clock::time_point time)
+{
+    SimulationSnapshot& snapshot = this->snapshots.getBack();
+    std::copy(this->positionsX.begin(), this->positionsX.end(), snapshot.previousX.begin());
+    std::copy(this->positionsY.begin(), this->positionsY.end(), snapshot.previousY.begin());
+
+    float* positionsX = this->positionsX.data();
+    float* positionsY = this->positionsY.data();
+    float* velocitiesX = this->velocitiesX.data();
+    float* velocitiesY = this->velocitiesY.data();
+    size_t entityCount = this->positionsX.size();
+    for (size_t entity = 0; entity < entityCount; entity++) {
+        positionsX[entity] += velocitiesX[entity] * this->tickSeconds;
+        positionsY[entity] += velocitiesY[entity] * this->tickSeconds;
+        // reflected back inside, the step never covers more than the screen
+        if (std::abs(positionsX[entity]) > BOUNDS) {
+            positionsX[entity] = std::copysign(2.0f * BOUNDS, positionsX[entity]) - positionsX[entity];
+            velocitiesX[entity] = -velocitiesX[entity];
+        }
+        if (std::abs(positionsY[entity]) > BOUNDS) {
+            positionsY[entity] = std::copysign(2.0f * BOUNDS, positionsY[entity]) - positionsY[entity];
+            velocitiesY[entity] = -velocitiesY[entity];
+        }
+    }
+
+    std::copy(this->positionsX.begin(), this->positionsX.end(), snapshot.positionsX.begin());
+    std::copy(this->positionsY.begin(), this->positionsY.end(), snapshot.positionsY.begin());
+    this->tickCount++;
+    snapshot.tick = this->tickCount;
+    snapshot.time = time;
+    this->snapshots.publish();
+    this->publishedTicks.store(this->tickCount, std::memory_order_relaxed);
+}
+
+uint64_t Simulation::getPublishedTickCount() const
+{
+    return this->publishedTicks.load(std::memory_order_relaxed);
+}
+uint64_t Simulation::getDroppedTickCount() const
+{
+    return this->droppedTicks.load(std::memory_order_relaxed);
+}
+
+uint64_t Simulation::interpolate(Clock::time_point now, float* positionsX, float* positionsY)
+{
+    this->snapshots.take();
+    const SimulationSnapshot& snapshot = this->snapshots.getFront();
+    if (snapshot.tick == 0) {
+        return 0;
+    }
+    // the snapshot's tick is due at its time, so a renderer one tick behind is at its start then and at its end one
+    // tick later; a late snapshot holds at its end until the next one arrives
+    float blend = std::chrono::duration<float>(now - snapshot.time).count() / this->tickSeconds;
+    blend = std::min(std::max(blend, 0.0f), 1.0f);
+    size_t entityCount = snapshot.positionsX.size();
+    for (size_t entity = 0; entity < entityCount; entity++) {
+        positionsX[entity] = snapshot.previousX[entity] + (snapshot.positionsX[entity] - snapshot.previousX[entity]) * blend;
+        positionsY[entity] = snapshot.previousY[entity] + (snapshot.positionsY[entity] - snapshot.previousY[entity]) * blend;
+    }
+    return snapshot.tick;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "TripleBuffer.h"
+
+#pragma once
+// What one tick produced: the entity positions before and after it, so the renderer can blend between them.
+struct SimulationSnapshot {
+	uint64_t tick = 0;
+	// when the tick's state is due, on the simulation's schedule
+	std::chrono::steady_clock::time_point time;
+	std::vector<float> previousX;
+	std::vector<float> previousY;
+	std::vector<float> positionsX;
+	std::vector<float> positionsY;
+};
+// Game state advanced at a fixed tick rate on its own thread, independent of how fast frames are drawn. After every
+// tick the positions go to the render thread through a triple buffer; the renderer draws one tick behind and
+// interpolates inside the newest snapshot. Entities drift at a constant speed and bounce off the screen edges.
+class Simulation
+{
+private:
+	typedef std::chrono::steady_clock Clock;
+	std::vector<float> positionsX;
+	std::vector<float> positionsY;
+	std::vector<float> velocitiesX;
+	std::vector<float> velocitiesY;
+	TripleBuffer<SimulationSnapshot> snapshots;
+	Clock::duration tickDuration;
+	float tickSeconds;
+	uint64_t tickCount = 0;
+	std::thread thread;
+	std::atomic<bool> stopping{ false };
+	// read by other threads for statistics
+	std::atomic<uint64_t> publishedTicks{ 0 };
+	std::atomic<uint64_t> droppedTicks{ 0 };
+
+	void run();
+public:
+	// ticks the thread runs at once to catch up after a stall; beyond that it drops ticks and falls behind wall time
+	// rather than spiraling into ever longer catch ups
+	static const uint32_t MAX_CATCH_UP_TICKS = 5;
+	static constexpr float BOUNDS = 0.95f;
+
+	// entities start at the given positions with a random velocity from a fixed seed
+	Simulation(const float* positionsX, const float* positionsY, uint32_t entityCount, uint32_t tickRate);
+	~Simulation();
+	uint32_t getEntityCount() const;
+	float getTickSeconds() const;
+	void start();
+	// waits for the thread to finish its tick
+	void stop();
+	// one tick on the calling thread, published as due at time; only while the thread is not running
+	void tick(Clock::time_point time);
+	uint64_t getPublishedTickCount() const;
+	uint64_t getDroppedTickCount() const;
+	// Render thread: takes the newest snapshot and writes every entity's position at now minus one tick to
+	// positionsX/Y. Returns the tick drawn, 0 until the first one arrived, when nothing is written.
+	uint64_t interpolate(Clock::time_point now, float* positionsX, float* positionsY);
+};
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "SpatialHash.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+uint32_t SpatialHash::getBucket(int32_t cellX, int32_t cellY) const
+{
+    return ((uint32_t)cellX * 73856093u ^ (uint32_t)cellY * 19349663u) & this->bucketMask;
+}
+
+void SpatialHash::build(const float* minX, const float* minY, const float* maxX, const float* maxY, uint32_t count, float cellSize)
+{
+    // about two buckets per item keeps unrelated cells sharing a bucket rare
+    uint32_t bucketCount = 16;
+    while (bucketCount < count * 2) {
+        bucketCount *= 2;
+    }
+    this->bucketMask = bucketCount - 1;
+    this->inverseCellSize = 1.0f / cellSize;
+    this->itemBuckets.resize(count);
+    this->bucketStarts.assign(bucketCount + 1, 0);
+    this->bucketCursors.resize(bucketCount);
+    this->entries.resize(count);
+
+    // count the items per bucket, shifted by one so the prefix sum below gives the starts
+    for (uint32_t item = 0; item < count; item++) {
+        if (maxX[item] - minX[item] > cellSize || maxY[item] - minY[item] > cellSize) {
+            throw std::runtime_error("box larger than a spatial hash cell!");
+        }
+        int32_t cellX = (int32_t)std::floor((minX[item] + maxX[item]) * 0.5f * this->inverseCellSize);
+        int32_t cellY = (int32_t)std::floor((minY[item] + maxY[item]) * 0.5f * this->inverseCellSize);
+        uint32_t bucket = this->getBucket(cellX, cellY);
+        this->itemBuckets[item] = bucket;
+        this->bucketStarts[bucket + 1]++;
+    }
+    for (uint32_t bucket = 0; bucket < bucketCount; bucket++) {
+        this->bucketStarts[bucket + 1] += this->bucketStarts[bucket];
+    }
+    std::copy(this->bucketStarts.begin(), this->bucketStarts.end() - 1, this->bucketCursors.begin());
+    for (uint32_t item = 0; item < count; item++) {
+        Entry& entry = this->entries[this->bucketCursors[this->itemBuckets[item]]++];
+        entry.minX = minX[item];
+        entry.minY = minY[item];
+        entry.maxX = maxX[item];
+        entry.maxY = maxY[item];
+        entry.cellX = (int32_t)std::floor((minX[item] + maxX[item]) * 0.5f * this->inverseCellSize);
+        entry.cellY = (int32_t)std::floor((minY[item] + maxY[item]) * 0.5f * this->inverseCellSize);
+        entry.item = item;
+    }
+}
+
+static inline bool overlaps(float minXA, float minYA, float maxXA, float maxYA, float minXB, float minYB, float maxXB, float maxYB)
+{
+    return minXA <= maxXB && minXB <= maxXA && minYA <= maxYB && minYB <= maxYA;
+}
+
+void SpatialHash::findPairs(std::vector<CollisionPair>& pairs) const
+{
+    // the cell itself is walked from the entry on, then the half of the neighbours after it, so every pair of
+    // neighbouring cells is looked at from one side only
+    const int32_t NEIGHBOUR_OFFSETS[4][2] = { { 1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 } };
+    uint32_t bucketCount = this->bucketMask + 1;
+    for (uint32_t bucket = 0; bucket < bucketCount; bucket++) {
+        uint32_t bucketEnd = this->bucketStarts[bucket + 1];
+        for (uint32_t index = this->bucketStarts[bucket]; index < bucketEnd; index++) {
+            const Entry& entry = this->entries[index];
+            // buckets may hold other cells that hash alike, only entries of the cell looked for count
+            for (uint32_t other = index + 1; other < bucketEnd; other++) {
+                const Entry& candidate = this->entries[other];
+                if (candidate.cellX == entry.cellX && candidate.cellY == entry.cellY
+                    && overlaps(entry.minX, entry.minY, entry.maxX, entry.maxY, candidate.minX, candidate.minY, candidate.maxX, candidate.maxY)) {
+                    pairs.push_back({ std::min(entry.item, candidate.item), std::max(entry.item, candidate.item) });
+                }
+            }
+            for (const int32_t* offset : NEIGHBOUR_OFFSETS) {
+                int32_t cellX = entry.cellX + offset[0];
+                int32_t cellY = entry.cellY + offset[1];
+                uint32_t neighbourBucket = this->getBucket(cellX, cellY);
+                uint32_t neighbourEnd = this->bucketStarts[neighbourBucket + 1];
+                for (uint32_t other = this->bucketStarts[neighbourBucket]; other < neighbourEnd; other++) {
+                    const Entry& candidate = this->entries[other];
+                    if (candidate.cellX == cellX && candidate.cellY == cellY
+                        && overlaps(entry.minX, entry.minY, entry.maxX, entry.maxY, candidate.minX, candidate.minY, candidate.maxX, candidate.maxY)) {
+                        pairs.push_back({ std::min(entry.item, candidate.item), std::max(entry.item, candidate.item) });
+                    }
+                }
+            }
+        }
+    }
+}
+
+uint32_t SpatialHash::getBucketCount() const
+{
+    return this->bucketMask + 1;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include <vector>
+#include <cstdint>
+
+#pragma once
+// Two items whose boxes overlap, a < b.
+struct CollisionPair {
+	uint32_t a;
+	uint32_t b;
+};
+// Broadphase over axis aligned boxes: a uniform grid whose cells are hashed into a power of two bucket table, rebuilt
+// from scratch every tick. Items go into the cell of their box's center and are laid out bucket by bucket with a
+// counting sort, so a bucket's boxes are contiguous and pair tests walk memory in order. No item may be larger than
+// a cell, then overlapping items are at most one cell apart and each pair is found from exactly one of the cells.
+// Allocates nothing once the item count has stopped growing.
+class SpatialHash
+{
+private:
+	// the box next to its cell, what the pair tests read
+	struct Entry {
+		float minX;
+		float minY;
+		float maxX;
+		float maxY;
+		int32_t cellX;
+		int32_t cellY;
+		uint32_t item;
+	};
+	float inverseCellSize = 1.0f;
+	uint32_t bucketMask = 0;
+	std::vector<uint32_t> itemBuckets;
+	// bucket b's entries are [bucketStarts[b], bucketStarts[b + 1])
+	std::vector<uint32_t> bucketStarts;
+	std::vector<uint32_t> bucketCursors;
+	std::vector<Entry> entries;
+
+	uint32_t getBucket(int32_t cellX, int32_t cellY) const;
+public:
+	// Sorts count boxes, item i spanning [minX[i], maxX[i]] x [minY[i], maxY[i]], into cells of cellSize.
+	void build(const float* minX, const float* minY, const float* maxX, const float* maxY, uint32_t count, float cellSize);
+	// appends every overlapping pair of the boxes built last to pairs
+	void findPairs(std::vector<CollisionPair>& pairs) const;
+	uint32_t getBucketCount() const;
+};
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+#include "VertexInput.h"
+#include <cstdint>
+
+// head circle as a line list plus five limbs (body, two arms, two legs), see shaders/stickfigure.vert
+const uint32_t STICK_FIGURE_HEAD_SEGMENTS = 12;
+const uint32_t STICK_FIGURE_VERTEX_COUNT = STICK_FIGURE_HEAD_SEGMENTS * 2 + 5 * 2;
+const uint32_t STICK_FIGURE_POSE_COUNT = 4;
+
+// One figure; all of its vertices read the same instance.
+struct StickFigureInstance {
+    float position[2];
+    float scale;
+    uint32_t pose;
+    // RGBA8, red in the lowest byte
+    uint32_t color;
+};
+template <>
+struct VertexLayout<StickFigureInstance> {
+    static constexpr VkVertexInputBindingDescription binding = { 0, sizeof(StickFigureInstance), VK_VERTEX_INPUT_RATE_INSTANCE };
+    static constexpr VkVertexInputAttributeDescription attributes[] = {
+        { 0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(StickFigureInstance, position) },
+        { 1, 0, VK_FORMAT_R32_SFLOAT, offsetof(StickFigureInstance, scale) },
+        { 2, 0, VK_FORMAT_R32_UINT, offsetof(StickFigureInstance, pose) },
+        { 3, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(StickFigureInstance, color) },
+    };
+};
\ No newline at end of file
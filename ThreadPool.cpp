@@ -0,0 +1,269 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <stdexcept>
+
+// which pool's worker the current thread is, if any
+static thread_local ThreadPool* currentPool = nullptr;
+static thread_local size_t currentWorkerIndex = 0;
+
+Task::Task(std::function<void()> work)
+{
+    this->work = std::move(work);
+}
+void Task::setWork(std::function<void()> work)
+{
+    this->work = std::move(work);
+}
+void Task::dependsOn(Task& before)
+{
+    before.successors.push_back(this);
+    this->dependencyCount++;
+}
+bool Task::isDone() const
+{
+    return this->done.load(std::memory_order_acquire);
+}
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // the thread calling parallelFor takes part in the work, so it counts as one of the threads
+    for (size_t i = 1; i < threadCount; i++) {
+        this->workers.push_back(new Worker());
+    }
+    // every deque exists before any worker steals from it
+    for (size_t i = 0; i < this->workers.size(); i++) {
+        this->workers[i]->thread = std::thread(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->workAvailable.notify_all();
+    for (Worker* worker : this->workers) {
+        worker->thread.join();
+    }
+    for (Worker* worker : this->workers) {
+        delete worker;
+    }
+}
+
+size_t ThreadPool::getThreadCount()
+{
+    return this->workers.size() + 1;
+}
+
+size_t ThreadPool::getCurrentWorker() const
+{
+    return currentPool == this ? currentWorkerIndex : NO_WORKER;
+}
+
+void ThreadPool::queue(Task* task)
+{
+    size_t workerIndex = this->getCurrentWorker();
+    if (workerIndex == NO_WORKER || !this->workers[workerIndex]->deque.push(task)) {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->injected.push_back(task);
+        this->injectedSize.fetch_add(1, std::memory_order_relaxed);
+    }
+    this->queuedTasks.fetch_add(1, std::memory_order_seq_cst);
+}
+
+// A worker counts itself as sleeping under the mutex before it checks queuedTasks, and queue counts the task before
+// this reads sleepingWorkers, so either the worker sees the task or this sees the worker.
+void ThreadPool::wake(size_t taskCount)
+{
+    if (taskCount == 0 || this->sleepingWorkers.load(std::memory_order_seq_cst) == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (taskCount == 1) {
+        this->workAvailable.notify_one();
+    }
+    else {
+        this->workAvailable.notify_all();
+    }
+}
+
+Task* ThreadPool::findTask(size_t workerIndex, uint32_t& randomState)
+{
+    Task* task = nullptr;
+    if (workerIndex != NO_WORKER) {
+        task = this->workers[workerIndex]->deque.pop();
+    }
+    if (!task && this->injectedSize.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->injectedHead < this->injected.size()) {
+            task = this->injected[this->injectedHead++];
+            this->injectedSize.fetch_sub(1, std::memory_order_relaxed);
+            if (this->injectedHead == this->injected.size()) {
+                this->injected.clear();
+                this->injectedHead = 0;
+            }
+        }
+    }
+    if (!task && !this->workers.empty()) {
+        // xorshift, so thieves don't all start at the same victim
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        size_t first = randomState % this->workers.size();
+        for (size_t i = 0; i < this->workers.size() && !task; i++) {
+            size_t victim = (first + i) % this->workers.size();
+            if (victim != workerIndex) {
+                task = this->workers[victim]->deque.steal();
+            }
+        }
+    }
+    if (task) {
+        this->queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+void ThreadPool::execute(Task* task)
+{
+    try {
+        task->work();
+    }
+    catch (...) {
+        task->exception = std::current_exception();
+    }
+    size_t readyCount = 0;
+    for (Task* successor : task->successors) {
+        if (successor->pendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->queue(successor);
+            readyCount++;
+        }
+    }
+    // last, the owner may submit it again right after
+    task->done.store(true, std::memory_order_release);
+    this->wake(readyCount);
+}
+
+void ThreadPool::workerLoop(size_t workerIndex)
+{
+    currentPool = this;
+    currentWorkerIndex = workerIndex;
+    uint32_t randomState = (uint32_t)workerIndex * 2654435761u + 1;
+    uint32_t idleRounds = 0;
+    while (true) {
+        Task* task = this->findTask(workerIndex, randomState);
+        if (task) {
+            this->execute(task);
+            idleRounds = 0;
+            continue;
+        }
+        if (++idleRounds < IDLE_ROUNDS) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+        this->workAvailable.wait(lock, [&] { return this->stopping || this->queuedTasks.load(std::memory_order_seq_cst) > 0; });
+        this->sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+        if (this->stopping) {
+            return;
+        }
+        idleRounds = 0;
+    }
+}
+
+void ThreadPool::submit(size_t count, Task* const* tasks)
+{
+    // every task is reset before any is queued, a quick one could otherwise release a successor not reset yet
+    for (size_t i = 0; i < count; i++) {
+        if (!tasks[i]->done.load(std::memory_order_acquire)) {
+            throw std::runtime_error("task submitted again before it finished!");
+        }
+        tasks[i]->done.store(false, std::memory_order_relaxed);
+        tasks[i]->exception = nullptr;
+        tasks[i]->pendingDependencies.store(tasks[i]->dependencyCount, std::memory_order_relaxed);
+    }
+    size_t readyCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (tasks[i]->dependencyCount == 0) {
+            this->queue(tasks[i]);
+            readyCount++;
+        }
+    }
+    this->wake(readyCount);
+}
+
+void ThreadPool::wait(Task& task)
+{
+    size_t workerIndex = this->getCurrentWorker();
+    uint32_t randomState = (uint32_t)(uintptr_t)&task | 1;
+    while (!task.done.load(std::memory_order_acquire)) {
+        Task* next = this->findTask(workerIndex, randomState);
+        if (next) {
+            this->execute(next);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    if (task.exception) {
+        std::rethrow_exception(task.exception);
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& task)
+{
+    if (count == 0) {
+        return;
+    }
+    if (this->workers.empty() || count == 1) {
+        for (size_t index = 0; index < count; index++) {
+            task(index);
+        }
+        return;
+    }
+    // Indices are claimed one at a time from a shared counter by this thread and by helper tasks that other threads
+    // pick up; everything lives on this stack frame, so a call allocates nothing.
+    struct Indices {
+        const std::function<void(size_t)>* task;
+        size_t count;
+        std::atomic<size_t> next{ 0 };
+        std::atomic<bool> failed{ false };
+        std::exception_ptr firstException;
+
+        void run() {
+            for (size_t index = this->next++; index < this->count; index = this->next++) {
+                try {
+                    (*this->task)(index);
+                }
+                catch (...) {
+                    if (!this->failed.exchange(true)) {
+                        this->firstException = std::current_exception();
+                    }
+                }
+            }
+        }
+    } indices;
+    indices.task = &task;
+    indices.count = count;
+
+    size_t helperCount = std::min(std::min(this->workers.size(), count - 1), MAX_PARALLEL_FOR_HELPERS);
+    Task helpers[MAX_PARALLEL_FOR_HELPERS];
+    Task* helperPointers[MAX_PARALLEL_FOR_HELPERS];
+    for (size_t i = 0; i < helperCount; i++) {
+        helpers[i].setWork([&indices] { indices.run(); });
+        helperPointers[i] = &helpers[i];
+    }
+    this->submit(helperCount, helperPointers);
+    indices.run();
+    // helpers nobody picked up yet are run here, and find no index left
+    for (size_t i = 0; i < helperCount; i++) {
+        this->wait(helpers[i]);
+    }
+    if (indices.firstException) {
+        std::rethrow_exception(indices.firstException);
+    }
+}
\ No newline at end of file
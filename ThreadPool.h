@@ -0,0 +1,83 @@
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+#include <cstdint>
+#include "WorkStealingDeque.h"
+
+#pragma once
+// A unit of work for ThreadPool, owned by the caller and submitted again once it has finished, so running a graph
+// of tasks every frame allocates nothing. Dependencies are set up before the first submit.
+class Task
+{
+private:
+	std::function<void()> work;
+	// tasks waiting on this one
+	std::vector<Task*> successors;
+	uint32_t dependencyCount = 0;
+	std::atomic<uint32_t> pendingDependencies{ 0 };
+	std::atomic<bool> done{ true };
+	std::exception_ptr exception;
+	friend class ThreadPool;
+public:
+	Task() = default;
+	Task(std::function<void()> work);
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	void setWork(std::function<void()> work);
+	// this task starts only after before finished; both have to be submitted in the same call
+	void dependsOn(Task& before);
+	bool isDone() const;
+};
+// Work-stealing scheduler. Every worker thread owns a Chase-Lev deque: tasks made ready on a worker go to its own
+// deque and it runs the newest first, idle workers steal the oldest from others. Tasks submitted from outside the
+// pool go through one shared queue. Threads that wait take part in the work, and so does the thread calling
+// parallelFor, which counts as one of the threads.
+class ThreadPool
+{
+private:
+	struct Worker {
+		WorkStealingDeque<Task> deque;
+		std::thread thread;
+	};
+	static const size_t NO_WORKER = SIZE_MAX;
+	// tasks parallelFor hands out to other threads, at most
+	static const size_t MAX_PARALLEL_FOR_HELPERS = 64;
+	// rounds of looking for work before a worker sleeps
+	static const uint32_t IDLE_ROUNDS = 64;
+	std::vector<Worker*> workers;
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	// from threads outside the pool and from full deques; a queue in a vector that is reset whenever it runs empty
+	std::vector<Task*> injected;
+	size_t injectedHead = 0;
+	std::atomic<size_t> injectedSize{ 0 };
+	// ready tasks in every queue, what sleeping workers wake up for; briefly off while a task is being queued
+	std::atomic<int64_t> queuedTasks{ 0 };
+	std::atomic<uint32_t> sleepingWorkers{ 0 };
+	bool stopping = false;
+
+	void workerLoop(size_t workerIndex);
+	size_t getCurrentWorker() const;
+	Task* findTask(size_t workerIndex, uint32_t& randomState);
+	// queues a ready task without waking anyone
+	void queue(Task* task);
+	void wake(size_t taskCount);
+	void execute(Task* task);
+public:
+	ThreadPool(size_t threadCount);
+	~ThreadPool();
+	size_t getThreadCount();
+	// Queues tasks to run once their dependencies finished. Every dependency of a submitted task is submitted in the
+	// same call, and none of the tasks may still be running from an earlier submit.
+	void submit(size_t count, Task* const* tasks);
+	// Runs other tasks on this thread until task finished, then rethrows what it threw. A task that throws still
+	// releases its successors.
+	void wait(Task& task);
+	// Calls task for every index in [0, count) and blocks until all returned, rethrowing the first exception.
+	// May be called from inside tasks.
+	void parallelFor(size_t count, const std::function<void(size_t)>& task);
+};
\ No newline at end of file
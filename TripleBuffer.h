@@ -0,0 +1,47 @@
+#include <atomic>
+#include <cstdint>
+
+#pragma once
+// Hands values from one writer thread to one reader thread without locks and without either waiting on the other.
+// The writer fills the back slot and publishes it, the reader takes the newest published slot as its front; the
+// third slot sits in the middle between them. Only the middle index is shared, swapped with one atomic exchange per
+// publish and per take. A value the reader never took is overwritten by the next publish.
+template <typename T>
+class TripleBuffer
+{
+private:
+	static const uint32_t INDEX_MASK = 3;
+	// set in middle when the writer published it after the reader last took a slot
+	static const uint32_t FRESH_BIT = 4;
+	T slots[3];
+	std::atomic<uint32_t> middle{ 1 };
+	// only touched by the writer
+	uint32_t back = 0;
+	// only touched by the reader
+	uint32_t front = 2;
+public:
+	// for sizing the slots before either thread starts
+	T& getSlot(uint32_t index) {
+		return this->slots[index];
+	}
+	// writer side
+	T& getBack() {
+		return this->slots[this->back];
+	}
+	void publish() {
+		uint32_t previous = this->middle.exchange(this->back | FRESH_BIT, std::memory_order_acq_rel);
+		this->back = previous & INDEX_MASK;
+	}
+	// reader side; returns false and keeps the front when nothing was published since the last take
+	bool take() {
+		if ((this->middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0) {
+			return false;
+		}
+		uint32_t previous = this->middle.exchange(this->front, std::memory_order_acq_rel);
+		this->front = previous & INDEX_MASK;
+		return true;
+	}
+	const T& getFront() const {
+		return this->slots[this->front];
+	}
+};
\ No newline at end of file
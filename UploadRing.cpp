@@ -0,0 +1,329 @@
+#include "UploadRing.h"
+#include "Counters.h"
+#include "CreateCommandPool.h"
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <string>
+
+// keeps every staged upload 16 byte aligned for memcpy
+static const VkDeviceSize UPLOAD_ALIGNMENT = 16;
+
+UploadRing::UploadRing(VkDevice device, GpuAllocator* allocator, VkQueue transferQueue, uint32_t transferFamilyIndex, uint32_t graphicsFamilyIndex, VkDeviceSize capacity)
+{
+    this->device = device;
+    this->allocator = allocator;
+    this->transferQueue = transferQueue;
+    this->transferFamilyIndex = transferFamilyIndex;
+    this->graphicsFamilyIndex = graphicsFamilyIndex;
+    this->capacity = capacity;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = capacity;
+    bufferInfo.usage = VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VkSharingMode::VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(this->device, &bufferInfo, nullptr, &this->stagingBuffer) != VkResult::VK_SUCCESS) {
+        throw std::runtime_error("failed to create staging buffer!");
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(this->device, this->stagingBuffer, &memRequirements);
+    this->stagingMemory = this->allocator->allocate(memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, GpuResourceKind::Linear);
+    vkBindBufferMemory(this->device, this->stagingBuffer, this->stagingMemory.memory, this->stagingMemory.offset);
+
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VkSemaphoreType::VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineInfo;
+    if (vkCreateSemaphore(this->device, &semaphoreInfo, nullptr, &this->timeline) != VkResult::VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload timeline semaphore!");
+    }
+
+    createCommandPool(this->device, transferFamilyIndex, &this->transferCommandPool, VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    if (this->ownershipTransferNeeded()) {
+        createCommandPool(this->device, graphicsFamilyIndex, &this->graphicsCommandPool, VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    }
+}
+
+UploadRing::~UploadRing()
+{
+    // graphics submits are waited for by whoever owns the device, the transfer queue is ours
+    if (this->lastTransferValue > 0) {
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &this->timeline;
+        waitInfo.pValues = &this->lastTransferValue;
+        vkWaitSemaphores(this->device, &waitInfo, UINT64_MAX);
+    }
+    vkDestroyCommandPool(this->device, this->transferCommandPool, nullptr);
+    if (this->graphicsCommandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(this->device, this->graphicsCommandPool, nullptr);
+    }
+    if (this->queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(this->device, this->queryPool, nullptr);
+    }
+    vkDestroySemaphore(this->device, this->timeline, nullptr);
+    vkDestroyBuffer(this->device, this->stagingBuffer, nullptr);
+    this->allocator->free(this->stagingMemory);
+}
+
+bool UploadRing::ownershipTransferNeeded()
+{
+    return this->transferFamilyIndex != this->graphicsFamilyIndex;
+}
+
+void UploadRing::retire(bool waitForOldestTransfer)
+{
+    if (waitForOldestTransfer && !this->inFlightTransfers.empty()) {
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &this->timeline;
+        waitInfo.pValues = &this->inFlightTransfers.front().retireValue;
+        if (vkWaitSemaphores(this->device, &waitInfo, UINT64_MAX) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to wait for upload timeline semaphore!");
+        }
+    }
+
+    uint64_t completedValue;
+    if (vkGetSemaphoreCounterValue(this->device, this->timeline, &completedValue) != VkResult::VK_SUCCESS) {
+        throw std::runtime_error("failed to read upload timeline semaphore!");
+    }
+    while (!this->inFlightTransfers.empty() && this->inFlightTransfers.front().retireValue <= completedValue) {
+        uint32_t querySlot = this->inFlightTransfers.front().querySlot;
+        if (querySlot != NO_QUERY) {
+            // the batch has completed, so its timestamps are available without waiting
+            uint64_t timestamps[2];
+            if (vkGetQueryPoolResults(this->device, this->queryPool, querySlot * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VkQueryResultFlagBits::VK_QUERY_RESULT_64_BIT) == VkResult::VK_SUCCESS) {
+                this->profiler->addGpuScope(this->transferScope, timestamps[0], timestamps[1], this->timestampMask);
+            }
+            this->freeQuerySlots.push_back(querySlot);
+        }
+        this->tail = this->inFlightTransfers.front().ringEnd;
+        this->freeTransferCommandBuffers.push_back(this->inFlightTransfers.front().commandBuffer);
+        this->inFlightTransfers.erase(this->inFlightTransfers.begin());
+    }
+    while (!this->inFlightAcquires.empty() && this->inFlightAcquires.front().retireValue <= completedValue) {
+        this->freeGraphicsCommandBuffers.push_back(this->inFlightAcquires.front().commandBuffer);
+        this->inFlightAcquires.erase(this->inFlightAcquires.begin());
+    }
+}
+
+VkDeviceSize UploadRing::reserve(VkDeviceSize size)
+{
+    VkDeviceSize position = (this->head + UPLOAD_ALIGNMENT - 1) / UPLOAD_ALIGNMENT * UPLOAD_ALIGNMENT;
+    // an upload never wraps around the end of the buffer, it starts over at the beginning instead
+    if (position % this->capacity + size > this->capacity) {
+        position = (position + this->capacity - 1) / this->capacity * this->capacity;
+    }
+    this->retire(false);
+    while (position + size - this->tail > this->capacity) {
+        if (this->inFlightTransfers.empty() && this->pendingCopies.empty()) {
+            // everything written so far has been copied out, the gap skipped at the end of the lap is free as well
+            this->tail = position;
+            if (size > this->capacity) {
+                throw std::runtime_error("upload of " + std::to_string(size) + " bytes does not fit into the upload ring!");
+            }
+            break;
+        }
+        // the ring is full; only now does the CPU wait for the GPU
+        if (this->inFlightTransfers.empty()) {
+            this->flushTransfers();
+        }
+        this->retire(true);
+    }
+    this->head = position + size;
+    return position % this->capacity;
+}
+
+void UploadRing::upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+    Counters::add(Counter::UploadedBytes, size);
+    const char* source = static_cast<const char*>(data);
+    while (size > 0) {
+        VkDeviceSize chunkSize = std::min(size, this->capacity);
+        VkDeviceSize ringOffset = this->reserve(chunkSize);
+        memcpy(static_cast<char*>(this->stagingMemory.mappedData) + ringOffset, source, chunkSize);
+
+        PendingCopy copy{};
+        copy.dstBuffer = dstBuffer;
+        copy.region.srcOffset = ringOffset;
+        copy.region.dstOffset = dstOffset;
+        copy.region.size = chunkSize;
+        this->pendingCopies.push_back(copy);
+
+        source += chunkSize;
+        dstOffset += chunkSize;
+        size -= chunkSize;
+    }
+}
+
+VkCommandBuffer UploadRing::beginCommandBuffer(VkCommandPool commandPool, std::vector<VkCommandBuffer>& freeCommandBuffers)
+{
+    VkCommandBuffer commandBuffer;
+    if (freeCommandBuffers.empty()) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = commandPool;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(this->device, &allocInfo, &commandBuffer) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate upload command buffer!");
+        }
+    }
+    else {
+        commandBuffer = freeCommandBuffers.back();
+        freeCommandBuffers.pop_back();
+        vkResetCommandBuffer(commandBuffer, 0);
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VkResult::VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording upload command buffer!");
+    }
+    return commandBuffer;
+}
+
+void UploadRing::flushTransfers()
+{
+    if (this->pendingCopies.empty()) {
+        return;
+    }
+    VkCommandBuffer commandBuffer = this->beginCommandBuffer(this->transferCommandPool, this->freeTransferCommandBuffers);
+    uint32_t querySlot = NO_QUERY;
+    if (!this->freeQuerySlots.empty()) {
+        querySlot = this->freeQuerySlots.back();
+        this->freeQuerySlots.pop_back();
+        vkResetQueryPool(this->device, this->queryPool, querySlot * 2, 2);
+        vkCmdWriteTimestamp(commandBuffer, VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, this->queryPool, querySlot * 2);
+    }
+
+    // earlier transfer submits may still be writing the same buffers
+    VkMemoryBarrier writeAfterWrite{};
+    writeAfterWrite.sType = VkStructureType::VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    writeAfterWrite.srcAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_WRITE_BIT;
+    writeAfterWrite.dstAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &writeAfterWrite, 0, nullptr, 0, nullptr);
+
+    std::pmr::vector<VkBufferMemoryBarrier> releases(this->transientMemory);
+    for (const auto& copy : this->pendingCopies) {
+        vkCmdCopyBuffer(commandBuffer, this->stagingBuffer, copy.dstBuffer, 1, &copy.region);
+        if (this->ownershipTransferNeeded()) {
+            VkBufferMemoryBarrier barrier{};
+            barrier.sType = VkStructureType::VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = this->transferFamilyIndex;
+            barrier.dstQueueFamilyIndex = this->graphicsFamilyIndex;
+            barrier.buffer = copy.dstBuffer;
+            barrier.offset = copy.region.dstOffset;
+            barrier.size = copy.region.size;
+            releases.push_back(barrier);
+
+            // the matching acquire has to use the same ranges and families
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = CONSUMER_ACCESS;
+            this->pendingAcquires.push_back(barrier);
+        }
+    }
+    if (!releases.empty()) {
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, static_cast<uint32_t>(releases.size()), releases.data(), 0, nullptr);
+    }
+    if (querySlot != NO_QUERY) {
+        vkCmdWriteTimestamp(commandBuffer, VkPipelineStageFlagBits::VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, this->queryPool, querySlot * 2 + 1);
+    }
+    if (vkEndCommandBuffer(commandBuffer) != VkResult::VK_SUCCESS) {
+        throw std::runtime_error("failed to record upload command buffer!");
+    }
+
+    // The graphics queue only reads these buffers, so the transfer queue overwrites them without acquiring them back.
+    // It still has to wait until the graphics work submitted so far is done reading the old contents.
+    uint64_t signalValue = ++this->lastValue;
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = this->lastGraphicsValue > 0 ? 1 : 0;
+    timelineInfo.pWaitSemaphoreValues = &this->lastGraphicsValue;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = timelineInfo.waitSemaphoreValueCount;
+    submitInfo.pWaitSemaphores = &this->timeline;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &this->timeline;
+    if (vkQueueSubmit(this->transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VkResult::VK_SUCCESS) {
+        throw std::runtime_error("failed to submit upload command buffer!");
+    }
+
+    this->inFlightTransfers.push_back({ commandBuffer, signalValue, this->head, querySlot });
+    this->lastTransferValue = signalValue;
+    this->pendingCopies.clear();
+}
+
+UploadSubmission UploadRing::submit()
+{
+    CpuScope scope(this->profiler, this->submitScope);
+    this->flushTransfers();
+    this->retire(false);
+
+    UploadSubmission submission{};
+    submission.timeline = this->timeline;
+    if (this->lastTransferValue > this->lastConsumedTransferValue) {
+        submission.waitValue = this->lastTransferValue;
+        this->lastConsumedTransferValue = this->lastTransferValue;
+    }
+    submission.signalValue = ++this->lastValue;
+    this->lastGraphicsValue = submission.signalValue;
+
+    if (!this->pendingAcquires.empty()) {
+        VkCommandBuffer commandBuffer = this->beginCommandBuffer(this->graphicsCommandPool, this->freeGraphicsCommandBuffers);
+        vkCmdPipelineBarrier(commandBuffer, CONSUMER_STAGES, CONSUMER_STAGES, 0, 0, nullptr, static_cast<uint32_t>(this->pendingAcquires.size()), this->pendingAcquires.data(), 0, nullptr);
+        if (vkEndCommandBuffer(commandBuffer) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to record upload acquire command buffer!");
+        }
+        this->inFlightAcquires.push_back({ commandBuffer, submission.signalValue, 0, NO_QUERY });
+        this->pendingAcquires.clear();
+        submission.acquireCommands = commandBuffer;
+    }
+    return submission;
+}
+
+
+void UploadRing::setProfiler(Profiler* profiler, bool hostQueryReset)
+{
+    this->profiler = profiler;
+    this->submitScope = profiler->registerName("upload submit");
+    this->transferScope = profiler->registerName("uploads");
+    this->timestampMask = profiler->getTimestampMask(this->transferFamilyIndex);
+    if (!profiler->isTracing() || !hostQueryReset || this->timestampMask == 0 || this->queryPool != VK_NULL_HANDLE) {
+        return;
+    }
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VkQueryType::VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = QUERY_SLOTS * 2;
+    if (vkCreateQueryPool(this->device, &queryPoolInfo, nullptr, &this->queryPool) != VkResult::VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload timestamp query pool!");
+    }
+    // more batches in flight than slots just go untimed
+    for (uint32_t slot = 0; slot < QUERY_SLOTS; slot++) {
+        this->freeQuerySlots.push_back(QUERY_SLOTS - 1 - slot);
+    }
+}
+
+void UploadRing::setTransientMemory(std::pmr::memory_resource* transientMemory)
+{
+    this->transientMemory = transientMemory;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <memory_resource>
+#include "GpuAllocator.h"
+#include "Profiler.h"
+
+#pragma once
+// What the next graphics submit has to add so it sees everything uploaded so far.
+struct UploadSubmission {
+	VkSemaphore timeline = VK_NULL_HANDLE;
+	// wait for this value at UploadRing::CONSUMER_STAGES; 0 when nothing new was uploaded
+	uint64_t waitValue = 0;
+	// signal this value when the submit completes, it tells the ring the graphics queue is done reading
+	uint64_t signalValue = 0;
+	// queue family ownership acquire barriers, submit before the frame's own command buffers;
+	// VK_NULL_HANDLE when there is nothing to acquire or transfer and graphics share a family
+	VkCommandBuffer acquireCommands = VK_NULL_HANDLE;
+};
+// A persistently mapped staging buffer used as a ring. Uploads are copied into it and recorded as buffer copies;
+// all copies collected between two graphics submits go to the transfer queue in one submit that signals a
+// timeline semaphore, so the CPU never waits on the transfer unless the ring is full.
+class UploadRing
+{
+public:
+	static const VkPipelineStageFlags CONSUMER_STAGES = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	static const VkAccessFlags CONSUMER_ACCESS = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+private:
+	struct PendingCopy {
+		VkBuffer dstBuffer;
+		VkBufferCopy region;
+	};
+	struct InFlightCommands {
+		VkCommandBuffer commandBuffer;
+		uint64_t retireValue;
+		// ring position right after this batch's data, 0 for acquire command buffers
+		VkDeviceSize ringEnd;
+		// pair of timestamps around the batch's copies, NO_QUERY when it is not timed
+		uint32_t querySlot;
+	};
+	static const uint32_t NO_QUERY = UINT32_MAX;
+	static const uint32_t QUERY_SLOTS = 64;
+	VkDevice device;
+	GpuAllocator* allocator;
+	VkQueue transferQueue;
+	uint32_t transferFamilyIndex;
+	uint32_t graphicsFamilyIndex;
+	VkBuffer stagingBuffer;
+	GpuAllocation stagingMemory;
+	VkDeviceSize capacity;
+	// monotonically increasing byte positions, the physical offset is position % capacity
+	VkDeviceSize head = 0;
+	VkDeviceSize tail = 0;
+	VkSemaphore timeline;
+	uint64_t lastValue = 0;
+	uint64_t lastTransferValue = 0;
+	uint64_t lastConsumedTransferValue = 0;
+	uint64_t lastGraphicsValue = 0;
+	VkCommandPool transferCommandPool;
+	VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> freeTransferCommandBuffers;
+	std::vector<VkCommandBuffer> freeGraphicsCommandBuffers;
+	// oldest first; a handful at a time, so retiring erases from the front instead of a deque allocating blocks as it goes
+	std::vector<InFlightCommands> inFlightTransfers;
+	std::vector<InFlightCommands> inFlightAcquires;
+	std::vector<PendingCopy> pendingCopies;
+	std::vector<VkBufferMemoryBarrier> pendingAcquires;
+	// transfer batches are timed with a pool of their own, reset on the host as its slots are reused
+	Profiler* profiler = nullptr;
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	uint64_t timestampMask = 0;
+	std::vector<uint32_t> freeQuerySlots;
+	uint32_t transferScope = NameRegistry::INVALID_ID;
+	uint32_t submitScope = NameRegistry::INVALID_ID;
+	// lists that only live during one flush
+	std::pmr::memory_resource* transientMemory = std::pmr::get_default_resource();
+
+	VkDeviceSize reserve(VkDeviceSize size);
+	void retire(bool waitForOldestTransfer);
+	VkCommandBuffer beginCommandBuffer(VkCommandPool commandPool, std::vector<VkCommandBuffer>& freeCommandBuffers);
+	void flushTransfers();
+	bool ownershipTransferNeeded();
+public:
+	UploadRing(VkDevice device, GpuAllocator* allocator, VkQueue transferQueue, uint32_t transferFamilyIndex, uint32_t graphicsFamilyIndex, VkDeviceSize capacity = 4 * 1024 * 1024);
+	~UploadRing();
+	// Copies data into the ring right away; the GPU copy into dstBuffer happens with the next submit().
+	// dstBuffer has to be exclusively owned by the graphics family and only read there.
+	void upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+	// Submits pending copies to the transfer queue; call once right before every graphics queue submit and add the result to it.
+	UploadSubmission submit();
+	// Traces submit on the CPU and, with hostQueryReset enabled and timestamps on the transfer family, every transfer batch on the GPU.
+	void setProfiler(Profiler* profiler, bool hostQueryReset);
+	// Where submits put their short-lived lists, like the current frame's FrameArena; the global heap by default.
+	void setTransientMemory(std::pmr::memory_resource* transientMemory);
+};
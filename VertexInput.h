@@ -1,9 +1,30 @@
 #include <vulkan/vulkan.h>
-#include <vector>
+#include <cstddef>
+#include <cstdint>
 
 #pragma once
+// Vertex layout of one vertex type, specialized next to the type with constexpr members:
+//   static constexpr VkVertexInputBindingDescription binding;
+//   static constexpr VkVertexInputAttributeDescription attributes[];
+template <typename Vertex>
+struct VertexLayout;
+
+// What a pipeline needs to know about its vertex buffer. The descriptions point into the static data of a
+// VertexLayout specialization, so creating a pipeline from it calls nothing virtual and copies or allocates nothing.
 struct VertexInput {
-	virtual VkVertexInputBindingDescription getBindingDescription() = 0;
-	virtual std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() = 0;
-	virtual size_t getDataSize() = 0;
+	const VkVertexInputBindingDescription* binding;
+	const VkVertexInputAttributeDescription* attributes;
+	uint32_t attributeCount;
+	// size of the vertex buffer the pipeline owns
+	size_t dataSize;
+
+	template <typename Vertex>
+	static constexpr VertexInput of(size_t vertexCount) {
+		return VertexInput{
+			&VertexLayout<Vertex>::binding,
+			VertexLayout<Vertex>::attributes,
+			(uint32_t)(sizeof(VertexLayout<Vertex>::attributes) / sizeof(VkVertexInputAttributeDescription)),
+			vertexCount * sizeof(Vertex)
+		};
+	}
 };
\ No newline at end of file
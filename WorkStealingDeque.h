@@ -0,0 +1,66 @@
+#include <atomic>
+#include <cstdint>
+
+#pragma once
+// Chase-Lev deque of pointers with a fixed capacity (Le, Pop, Cohen, Zappa Nardelli: "Correct and Efficient
+// Work-Stealing for Weak Memory Models", 2013). The owning thread pushes and pops at the bottom like a stack, any
+// other thread steals from the top; only a pop racing a steal for the last item takes a compare and swap.
+template <typename T>
+class WorkStealingDeque
+{
+public:
+	static const int64_t CAPACITY = 4096;
+private:
+	static const int64_t MASK = CAPACITY - 1;
+	// on lines of their own, the owner writes bottom and thieves write top
+	alignas(64) std::atomic<int64_t> top{ 0 };
+	alignas(64) std::atomic<int64_t> bottom{ 0 };
+	std::atomic<T*> slots[CAPACITY];
+public:
+	// owner only; false when full
+	bool push(T* item) {
+		int64_t bottom = this->bottom.load(std::memory_order_relaxed);
+		int64_t top = this->top.load(std::memory_order_acquire);
+		if (bottom - top >= CAPACITY) {
+			return false;
+		}
+		this->slots[bottom & MASK].store(item, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		this->bottom.store(bottom + 1, std::memory_order_relaxed);
+		return true;
+	}
+	// owner only; the newest item, nullptr when empty
+	T* pop() {
+		int64_t bottom = this->bottom.load(std::memory_order_relaxed) - 1;
+		this->bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = this->top.load(std::memory_order_relaxed);
+		if (top > bottom) {
+			this->bottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		T* item = this->slots[bottom & MASK].load(std::memory_order_relaxed);
+		if (top == bottom) {
+			// the last item, a thief may be taking it as well
+			if (!this->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				item = nullptr;
+			}
+			this->bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return item;
+	}
+	// any thread; the oldest item, nullptr when empty or when another thread took it first
+	T* steal() {
+		int64_t top = this->top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t bottom = this->bottom.load(std::memory_order_acquire);
+		if (top >= bottom) {
+			return nullptr;
+		}
+		T* item = this->slots[top & MASK].load(std::memory_order_relaxed);
+		if (!this->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			return nullptr;
+		}
+		return item;
+	}
+};
\ No newline at end of file
@@ -11,15 +11,39 @@
 #include <set>
 #include <cstdint> // Necessary for UINT32_MAX
 #include <algorithm> // Necessary for std::min/std::max
+#include <chrono>
+#include <random>
+#include <cmath>
 #include "Families.h"
 #include "CreateCommandPool.h"
+#include "ShaderCode.h"
+#include "ShaderWatcher.h"
+#include "FramePacer.h"
+#include "Profiler.h"
+#include "Counters.h"
+#include "AllocationCounter.h"
 #include "PipelineManager.h"
 #include "CircleVertexInput.h"
+#include "StickFigureVertexInput.h"
+#include "AppOptions.h"
+#include "Benchmark.h"
+#include "PipelineCache.h"
+#include "ThreadPool.h"
+#include "GpuAllocator.h"
+#include "CommandRecorder.h"
+#include "FigureCuller.h"
+#include "FigureScene.h"
+#include "FigureAnimator.h"
+#include "Simulation.h"
+#include "FigureCollider.h"
+#include "DebugLines.h"
+#include "FrameGraph.h"
+#include "FrameArena.h"
+#include "SegmentBatcher.h"
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 800;
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
 
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
@@ -28,12 +52,13 @@ const std::vector<const char*> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME,
     VK_KHR_SHADER_NON_SEMANTIC_INFO_EXTENSION_NAME
 };
+const std::vector<const char*> headlessDeviceExtensions = {
+    VK_KHR_SHADER_NON_SEMANTIC_INFO_EXTENSION_NAME
+};
 
-#ifdef NDEBUG
-    const bool enableValidationLayers = false;
-#else
-    const bool enableValidationLayers = true;
-#endif
+const uint32_t HEADLESS_IMAGE_COUNT = 3;
+// transient memory of one frame in flight
+const size_t FRAME_ARENA_SIZE = 1024 * 1024;
 
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
     auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
@@ -58,23 +83,78 @@ struct SwapChainSupportDetails {
 };
 class HelloTriangleApplication {
 public:
+    HelloTriangleApplication(const AppOptions& options) {
+        this->options = options;
+        this->enableValidationLayers = options.enableValidationLayers;
+        this->framesInFlight = options.pacing.framesInFlight;
+        this->framePacer = new FramePacer(options.pacing);
+    }
     void run() {
         this->initWindow();
         this->initVulkan();
-        this->mainLoop();
+        if (this->options.benchmark.empty()) {
+            this->mainLoop();
+        }
+        else if (this->options.benchmark == "pipelines") {
+            this->benchmarkPipelineCreation();
+        }
+        else if (this->options.benchmark == "allocator") {
+            this->benchmarkBufferAllocation();
+        }
+        else if (this->options.benchmark == "recording") {
+            this->benchmarkCommandRecording();
+        }
+        else if (this->options.benchmark == "figures") {
+            this->benchmarkFigures();
+        }
+        else if (this->options.benchmark == "culling") {
+            this->benchmarkCulling();
+        }
+        else if (this->options.benchmark == "commands") {
+            this->benchmarkWriteCommands();
+        }
+        else if (this->options.benchmark == "pipeline-allocations") {
+            this->benchmarkPipelineAllocations();
+        }
+        else if (this->options.benchmark == "scene") {
+            this->benchmarkScene();
+        }
+        else if (this->options.benchmark == "poses") {
+            this->benchmarkPoses();
+        }
+        else if (this->options.benchmark == "simulation") {
+            this->benchmarkSimulation();
+        }
+        else if (this->options.benchmark == "collisions") {
+            this->benchmarkCollisions();
+        }
+        else if (this->options.benchmark == "tasks") {
+            this->benchmarkTasks();
+        }
+        else if (this->options.benchmark == "frame-allocations") {
+            this->benchmarkFrameAllocations();
+        }
+        else if (this->options.benchmark == "segments") {
+            this->benchmarkSegments();
+        }
+        else {
+            throw std::runtime_error("unknown benchmark " + this->options.benchmark);
+        }
         this->cleanup();
     }
 
 private:
-    GLFWwindow* window;
+    AppOptions options;
+    bool enableValidationLayers;
+    GLFWwindow* window = nullptr;
     VkInstance instance;
     VkDebugUtilsMessengerEXT debugMessenger;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkDevice device;
     VkQueue graphicsQueue;
     VkQueue presentQueue;
-    VkSurfaceKHR surface;
-    VkSwapchainKHR swapChain;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
     std::vector<VkImage> swapChainImages;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
@@ -82,18 +162,84 @@ private:
     VkRenderPass renderPass;
     //VkPipeline graphicsPipeline;
     std::vector<VkFramebuffer> swapChainFramebuffers;
-    VkCommandPool graphicsCommandPool;
+    // one pool per frame in flight, reset as a whole once the frame's fence has signaled
+    std::vector<VkCommandPool> frameCommandPools;
     std::vector<VkCommandBuffer> commandBuffers;
+    CommandRecorder* commandRecorder;
+    size_t recordingThreads;
+    std::vector<VkCommandBuffer> frameSecondaries;
+    std::vector<DrawCommand> dynamicDraws;
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
     size_t currentFrame = 0;
+    uint32_t framesInFlight;
+    FramePacer* framePacer;
     std::vector<VkFence> inFlightFences;
+    // one arena per frame in flight for what only lives during the frame, reset like its command pool
+    std::vector<FrameArena*> frameArenas;
     std::vector<VkFence> imagesInFlight;
     bool framebufferResized = false;
     uint32_t linesInCircle = 53;
+    // create infos keep pointers to the vertex inputs, so they live as long as the app
+    VertexInput circleVertexInput = VertexInput::of<CircleVertex>(1);
+    // layout only, figure draws bind the scene's figure buffer
+    VertexInput figureVertexInput = VertexInput::of<StickFigureInstance>(0);
+    FigureScene figureScene;
+    FigureCuller* figureCuller = nullptr;
+    // layout only, animated figure draws bind the animator's buffer of the frame
+    VertexInput animatedFigureVertexInput = VertexInput::of<AnimatedFigureInstance>(0);
+    FigureAnimator* figureAnimator = nullptr;
+    std::chrono::steady_clock::time_point animationStart = std::chrono::steady_clock::now();
+    FigureCollider figureCollider;
+    VertexInput debugLineVertexInput = VertexInput::of<DebugLineVertex>(0);
+    // contacts of the animated figures, only with --collisions
+    DebugLines* debugLines = nullptr;
+    // layout only, segment draws bind the batcher's buffer of the frame
+    VertexInput segmentVertexInput = VertexInput::of<SegmentInstance>(0);
+    // the animated figures as segments limbWidth pixels wide instead of line lists, only with --limb-width
+    SegmentBatcher* segmentBatcher = nullptr;
+    float limbWidth = 0.0f;
+    // moves the first figures of the scene, which follow it one tick behind
+    Simulation* simulation = nullptr;
+    std::vector<float> interpolatedX;
+    std::vector<float> interpolatedY;
+    PipelineHandle circlePipeline = INVALID_PIPELINE_HANDLE;
+    PipelineHandle figurePipeline = INVALID_PIPELINE_HANDLE;
+    PipelineHandle animatedFigurePipeline = INVALID_PIPELINE_HANDLE;
+    PipelineHandle debugLinePipeline = INVALID_PIPELINE_HANDLE;
+    PipelineHandle segmentPipeline = INVALID_PIPELINE_HANDLE;
+    bool drawIndirectCountSupported = false;
     PipelineManager* pipelineManager;
+    ShaderWatcher* shaderWatcher = nullptr;
+    PipelineCache* pipelineCache;
+    ThreadPool* threadPool;
+    // simulation, poses, culling input and recording of a frame as dependent tasks
+    FrameGraph* frameGraph = nullptr;
+    // what the frame graph's tasks work on, set before it runs
+    uint32_t frameImageIndex = 0;
+    // host copy of this frame's poses for the collisions, when there are any
+    const AnimatedFigureInstance* posedFigures = nullptr;
+    GpuAllocator* allocator;
+    std::vector<GpuAllocation> offscreenImageMemories;
+    Profiler* profiler = nullptr;
+    bool hostQueryResetSupported = false;
+    uint32_t drawFrameScope;
+    uint32_t recordFrameScope;
+    uint32_t cullingScope;
+    uint32_t poseScope;
+    uint32_t interpolationScope;
+    uint32_t collisionScope;
+    uint32_t renderPassScope;
+    uint64_t frameCount = 0;
+    SampleSeries cpuFrameTimes{ "CPU frame time" };
+    SampleSeries gpuFrameTimes{ "GPU frame time" };
+    CounterStats counterStats;
+    std::chrono::steady_clock::time_point lastCounterLine;
 
     void initWindow() {
+        if (this->options.headless) {
+            return;
+        }
         glfwInit();
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -102,32 +248,120 @@ private:
         this->window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
         glfwSetWindowUserPointer(this->window, this);
         glfwSetFramebufferSizeCallback(this->window, this->framebufferResizeCallback);
+        glfwSetKeyCallback(this->window, this->keyCallback);
+        glfwSetCursorPosCallback(this->window, this->cursorPosCallback);
+        glfwSetMouseButtonCallback(this->window, this->mouseButtonCallback);
 
     }
     static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
         auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
         app->framebufferResized = true;
     }
+    // all input only feeds the latency measurement so far
+    static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+        reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window))->framePacer->onInput();
+    }
+    static void cursorPosCallback(GLFWwindow* window, double x, double y) {
+        reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window))->framePacer->onInput();
+    }
+    static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+        reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window))->framePacer->onInput();
+    }
     void initVulkan() {
+        // before the thread pool, whose threads check it
+        Counters::setEnabled(!this->options.statsPath.empty());
+        this->threadPool = new ThreadPool(this->options.threadCount);
+        if (this->options.hotReload) {
+            // the compiled files are what changes, the copies in the binary would hide the edits
+            ShaderCode::setPreferFiles(true);
+            this->shaderWatcher = new ShaderWatcher("shaders", "compiled_shaders");
+        }
         this->createInstance();
         this->setupDebugMessenger();
-        this->createSurface();
+        if (!this->options.headless) {
+            this->createSurface();
+        }
         this->pickPhysicalDevice();
         this->createLogicalDevice();
-        this->createSwapChain();
+        this->createProfiler();
+        this->allocator = new GpuAllocator(this->physicalDevice, this->device);
+        this->pipelineCache = new PipelineCache(this->physicalDevice, this->device, this->options.pipelineCachePath, this->options.coldPipelineCache);
+        if (this->options.headless) {
+            this->createOffscreenImages();
+        }
+        else {
+            this->createSwapChain();
+        }
         this->createImageViews();
         this->createRenderPass();
         this->createGraphicsPipeline();
         this->createFramebuffers();
-        this->createCommandPools();
-        this->createCommandBuffers();
+        this->createFrameCommandBuffers();
         this->createSyncObjects();
+        this->createFrameGraph();
+        if (this->options.simulate && this->options.figureCount > 0) {
+            this->simulation = new Simulation(this->figureScene.getPositionsX(), this->figureScene.getPositionsY(), this->options.figureCount, this->options.tickRate);
+            this->simulation->start();
+        }
+    }
+
+    // Stands in for the swapchain when there is no window: the images are plain color attachments
+    // that the render pass leaves in TRANSFER_SRC_OPTIMAL, so they can be read back if needed.
+    void createOffscreenImages() {
+        this->swapChainImageFormat = VkFormat::VK_FORMAT_B8G8R8A8_UNORM;
+        this->swapChainExtent = { WIDTH, HEIGHT };
+        this->swapChainImages.resize(HEADLESS_IMAGE_COUNT);
+        this->offscreenImageMemories.resize(HEADLESS_IMAGE_COUNT);
+
+        for (size_t i = 0; i < HEADLESS_IMAGE_COUNT; i++) {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VkImageType::VK_IMAGE_TYPE_2D;
+            imageInfo.format = this->swapChainImageFormat;
+            imageInfo.extent = { this->swapChainExtent.width, this->swapChainExtent.height, 1 };
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VkImageTiling::VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = VkImageUsageFlagBits::VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VkImageUsageFlagBits::VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            imageInfo.sharingMode = VkSharingMode::VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED;
+
+            if (vkCreateImage(this->device, &imageInfo, nullptr, &this->swapChainImages[i]) != VkResult::VK_SUCCESS) {
+                throw std::runtime_error("failed to create offscreen image!");
+            }
+
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(this->device, this->swapChainImages[i], &memRequirements);
+
+            this->offscreenImageMemories[i] = this->allocator->allocate(memRequirements, VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuResourceKind::Optimal);
+            vkBindImageMemory(this->device, this->swapChainImages[i], this->offscreenImageMemories[i].memory, this->offscreenImageMemories[i].offset);
+        }
+    }
+    void createProfiler() {
+        auto graphicsFamilyIndex = this->getFamilyIndex(this->physicalDevice, &isGraphicsFamily);
+        this->profiler = new Profiler(this->physicalDevice, this->device, graphicsFamilyIndex.value(), this->framesInFlight, !this->options.tracePath.empty());
+        this->drawFrameScope = this->profiler->registerName("drawFrame");
+        this->recordFrameScope = this->profiler->registerName("recordFrameCommands");
+        this->cullingScope = this->profiler->registerName("culling");
+        this->poseScope = this->profiler->registerName("pose evaluation");
+        this->interpolationScope = this->profiler->registerName("simulation interpolation");
+        this->collisionScope = this->profiler->registerName("collisions");
+        this->renderPassScope = this->profiler->registerName("render pass");
+    }
+    bool isMeasuring() {
+        return this->options.frameLimit > 0 && this->frameCount >= this->options.warmupFrames;
+    }
+    void collectGpuFrameTime(uint32_t frameIndex) {
+        if (this->profiler->collect(frameIndex) && this->isMeasuring()) {
+            this->gpuFrameTimes.addSample(this->profiler->getLastFrameMilliseconds());
+        }
     }
     
     void createSyncObjects() {
-        this->imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        this->renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        this->inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+        this->imageAvailableSemaphores.resize(this->framesInFlight);
+        this->renderFinishedSemaphores.resize(this->framesInFlight);
+        this->inFlightFences.resize(this->framesInFlight);
         this->imagesInFlight.resize(this->swapChainImages.size(), VK_NULL_HANDLE);
 
         VkSemaphoreCreateInfo semaphoreInfo{};
@@ -137,63 +371,107 @@ private:
         fenceInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fenceInfo.flags = VkFenceCreateFlagBits::VK_FENCE_CREATE_SIGNALED_BIT;
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < this->framesInFlight; i++) {
             if (vkCreateSemaphore(this->device, &semaphoreInfo, nullptr, &this->imageAvailableSemaphores[i]) != VkResult::VK_SUCCESS ||
                 vkCreateSemaphore(this->device, &semaphoreInfo, nullptr, &this->renderFinishedSemaphores[i]) != VkResult::VK_SUCCESS ||
                 vkCreateFence(this->device, &fenceInfo, nullptr, &this->inFlightFences[i]) != VkResult::VK_SUCCESS) {
 
                 throw std::runtime_error("failed to create synchronization objects for a frame!");
             }
+            this->frameArenas.push_back(new FrameArena(FRAME_ARENA_SIZE));
         }
     }
-    void createCommandBuffers() {
-        this->commandBuffers.resize(this->swapChainFramebuffers.size());
-
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.commandPool = this->graphicsCommandPool;
-        allocInfo.level = VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
-
-        if (vkAllocateCommandBuffers(this->device, &allocInfo, this->commandBuffers.data()) != VkResult::VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate command buffers!");
-        }
-
-        for (size_t i = 0; i < this->commandBuffers.size(); i++) {
-            VkCommandBufferBeginInfo beginInfo{};
-            beginInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            beginInfo.flags = 0; // Optional
-            beginInfo.pInheritanceInfo = nullptr; // Optional
-
-            if (vkBeginCommandBuffer(this->commandBuffers[i], &beginInfo) != VkResult::VK_SUCCESS) {
-                throw std::runtime_error("failed to begin recording command buffer!");
+    void createFrameCommandBuffers() {
+        auto graphicsFamilyIndex = this->getFamilyIndex(this->physicalDevice, &isGraphicsFamily);
+        this->frameCommandPools.resize(this->framesInFlight);
+        this->commandBuffers.resize(this->framesInFlight);
+
+        for (size_t i = 0; i < this->framesInFlight; i++) {
+            createCommandPool(this->device, graphicsFamilyIndex.value(), &this->frameCommandPools[i], VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = this->frameCommandPools[i];
+            allocInfo.level = VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(this->device, &allocInfo, &this->commandBuffers[i]) != VkResult::VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate command buffers!");
             }
+        }
 
-            VkRenderPassBeginInfo renderPassInfo{};
-            renderPassInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            renderPassInfo.renderPass = this->renderPass;
-            renderPassInfo.framebuffer = this->swapChainFramebuffers[i];
-            renderPassInfo.renderArea.offset = { 0, 0 };
-            renderPassInfo.renderArea.extent = this->swapChainExtent;
-            VkClearValue clearColor = { {{1.0f, 1.0f, 1.0f, 1.0f}} };
-            renderPassInfo.clearValueCount = 1;
-            renderPassInfo.pClearValues = &clearColor;
+        // dynamic draws are split across the thread pool, one chunk per thread at most
+        this->recordingThreads = this->threadPool->getThreadCount();
+        this->commandRecorder = new CommandRecorder(this->device, graphicsFamilyIndex.value(), this->threadPool, this->framesInFlight, this->recordingThreads);
+        this->frameSecondaries.resize(1 + this->commandRecorder->getMaxChunkCount());
+    }
+    // Re-recorded every frame: the cached secondary with the static scene, then this frame's dynamic draws
+    // recorded in parallel into one secondary per chunk.
+    void recordFrameCommands(uint32_t frameIndex, uint32_t imageIndex) {
+        CpuScope scope(this->profiler, this->recordFrameScope);
+        VkCommandBuffer commandBuffer = this->commandBuffers[frameIndex];
+        if (vkResetCommandPool(this->device, this->frameCommandPools[frameIndex], 0) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to reset command pool!");
+        }
 
-            vkCmdBeginRenderPass(this->commandBuffers[i], &renderPassInfo, VkSubpassContents::VK_SUBPASS_CONTENTS_INLINE);
-            this->pipelineManager->writeCommands(this->commandBuffers[i]);
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = nullptr; // Optional
 
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+        // before the secondaries, whose scopes come from the frame's queries
+        this->profiler->beginFrame(commandBuffer, frameIndex);
+        GpuScopeTarget scopes;
+        scopes.profiler = this->profiler;
+        scopes.frameIndex = frameIndex;
+
+        this->frameSecondaries[0] = this->pipelineManager->getStaticCommands(frameIndex, this->swapChainExtent);
+        // the animated figures come from a different buffer every frame in flight, so they can't be static
+        if (this->figureAnimator) {
+            // the batcher has them as wide segments when there is one
+            this->dynamicDraws.push_back(this->segmentBatcher ? this->segmentBatcher->getDraw(this->segmentPipeline)
+                : this->figureAnimator->getDraw(this->animatedFigurePipeline, frameIndex));
+        }
+        if (this->debugLines) {
+            this->dynamicDraws.push_back(this->debugLines->getDraw(this->debugLinePipeline));
+        }
+        uint32_t secondaryCount = 1 + (uint32_t)this->commandRecorder->record(frameIndex, this->pipelineManager, this->swapChainExtent,
+            this->dynamicDraws.size(), this->dynamicDraws.data(), this->recordingThreads, &this->frameSecondaries[1], scopes);
+        if (this->figureAnimator) {
+            this->dynamicDraws.pop_back();
+        }
+        if (this->debugLines) {
+            this->dynamicDraws.pop_back();
+        }
 
-            vkCmdDraw(this->commandBuffers[i], this->linesInCircle+1, 1, 0, 0);
-            vkCmdEndRenderPass(this->commandBuffers[i]);
-            if (vkEndCommandBuffer(this->commandBuffers[i]) != VkResult::VK_SUCCESS) {
-                throw std::runtime_error("failed to record command buffer!");
-            }
+        if (this->figureCuller) {
+            uint32_t cullingScope = this->profiler->beginGpuScope(commandBuffer, scopes, this->cullingScope);
+            this->figureCuller->writeCulling(commandBuffer);
+            this->profiler->endGpuScope(commandBuffer, scopes, cullingScope);
         }
-    }
-    void createCommandPools() {
-        auto graphicsFamilyIndex = this->getFamilyIndex(this->physicalDevice, &isGraphicsFamily);
 
-        createCommandPool(this->device, graphicsFamilyIndex.value(), &this->graphicsCommandPool);
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = this->renderPass;
+        renderPassInfo.framebuffer = this->swapChainFramebuffers[imageIndex];
+        renderPassInfo.renderArea.offset = { 0, 0 };
+        renderPassInfo.renderArea.extent = this->swapChainExtent;
+        VkClearValue clearColor = { {{1.0f, 1.0f, 1.0f, 1.0f}} };
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearColor;
+
+        // outside of the render pass, whose contents are all secondaries
+        uint32_t renderPassScope = this->profiler->beginGpuScope(commandBuffer, scopes, this->renderPassScope);
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VkSubpassContents::VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        vkCmdExecuteCommands(commandBuffer, secondaryCount, this->frameSecondaries.data());
+        vkCmdEndRenderPass(commandBuffer);
+        this->profiler->endGpuScope(commandBuffer, scopes, renderPassScope);
+        this->profiler->endFrame(commandBuffer, frameIndex);
+        if (vkEndCommandBuffer(commandBuffer) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
     }
     void createFramebuffers() {
         this->swapChainFramebuffers.resize(this->swapChainImageViews.size());
@@ -224,7 +502,12 @@ private:
         colorAttachment.loadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_CLEAR;
         colorAttachment.storeOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachment.initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        if (this->options.headless) {
+            colorAttachment.finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        }
+        else {
+            colorAttachment.finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        }
 
         VkAttachmentReference colorAttachmentRef{};
         colorAttachmentRef.attachment = 0;
@@ -259,24 +542,867 @@ private:
     }
     void createGraphicsPipeline() {
         auto graphicsFamilyIndex = this->getFamilyIndex(this->physicalDevice, &isGraphicsFamily);
-        auto transferFamilyIndex = this->getFamilyIndex(this->physicalDevice, &isTransferFamily);
-
-        this->pipelineManager = new PipelineManager(this->physicalDevice, this->device, this->renderPass, transferFamilyIndex.value(), graphicsFamilyIndex.value());
-
-        CircleVertexInput circleVertextInput;
-        
+        auto transferFamilyIndex = this->getTransferFamilyIndex(this->physicalDevice);
+
+        this->pipelineManager = new PipelineManager(this->physicalDevice, this->device, this->renderPass, this->pipelineCache->get(), this->threadPool, this->allocator, transferFamilyIndex.value(), graphicsFamilyIndex.value(), this->drawIndirectCountSupported);
+        this->pipelineManager->setProfiler(this->profiler, this->hostQueryResetSupported);
+
+        std::vector<PipelineCreateInfo> createInfos;
+        createInfos.push_back(this->makeCircleCreateInfo("circle", &this->circleVertexInput));
+        // the figure benches need room for their biggest scene even without --figures
+        bool figureBenchmark = this->options.benchmark == "figures" || this->options.benchmark == "culling" || this->options.benchmark == "scene"
+            || this->options.benchmark == "simulation";
+        size_t maxFigures = std::max<size_t>(this->options.figureCount, figureBenchmark ? 100000 : 0);
+        if (maxFigures > 0) {
+            createInfos.push_back(this->makeFigureCreateInfo("figures", &this->figureVertexInput));
+        }
+        size_t animatedFigures = std::max<size_t>(this->options.animatedFigureCount,
+            this->options.benchmark == "poses" || this->options.benchmark == "segments" ? 100000 : 0);
+        if (animatedFigures > 0) {
+            PipelineCreateInfo animatedCreateInfo = this->makeFigureCreateInfo("animated figures", &this->animatedFigureVertexInput);
+            animatedCreateInfo.vertexShaderModule = "compiled_shaders/animatedfigure.vert.spv";
+            createInfos.push_back(animatedCreateInfo);
+        }
+        bool debugLines = this->options.collisions && this->options.animatedFigureCount > 0;
+        if (debugLines) {
+            PipelineCreateInfo debugLineCreateInfo = this->makeFigureCreateInfo("debug lines", &this->debugLineVertexInput);
+            debugLineCreateInfo.vertexShaderModule = "compiled_shaders/debugline.vert.spv";
+            createInfos.push_back(debugLineCreateInfo);
+        }
+        bool segments = (this->options.limbWidth > 0 && this->options.animatedFigureCount > 0) || this->options.benchmark == "segments";
+        if (segments) {
+            PipelineCreateInfo segmentCreateInfo = this->makeFigureCreateInfo("segments", &this->segmentVertexInput);
+            segmentCreateInfo.vertexShaderModule = "compiled_shaders/segment.vert.spv";
+            // a segment's quad turns with it, so either winding can face the screen
+            segmentCreateInfo.state = PipelineState::forTopology(VkPrimitiveTopology::VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+                .withCulling(VkCullModeFlagBits::VK_CULL_MODE_NONE, VkFrontFace::VK_FRONT_FACE_CLOCKWISE);
+            createInfos.push_back(segmentCreateInfo);
+        }
 
+        bool warmCache = this->pipelineCache->isWarm();
+        auto creationStart = std::chrono::steady_clock::now();
+        this->pipelineManager->createPipelines(createInfos.size(), createInfos.data());
+        std::chrono::duration<double, std::milli> creationTime = std::chrono::steady_clock::now() - creationStart;
+        std::cout << "pipeline creation: " << creationTime.count() << " ms (" << (warmCache ? "warm" : "cold") << " pipeline cache, "
+            << (ShaderCode::hasEmbeddedShaders() ? "embedded" : "mapped") << " shaders, " << ShaderCode::getFileReadCount() << " shader files read)\n";
+        this->circlePipeline = this->pipelineManager->findPipeline("circle");
+        this->pipelineManager->writeVertexData(&this->linesInCircle, this->circlePipeline);
+
+        std::vector<DrawCommand> staticDraws;
+        DrawCommand circleDraw{};
+        circleDraw.pipeline = this->circlePipeline;
+        circleDraw.vertexCount = this->linesInCircle + 1;
+        circleDraw.instanceCount = 1;
+        staticDraws.push_back(circleDraw);
+        if (maxFigures > 0) {
+            this->figurePipeline = this->pipelineManager->findPipeline("figures");
+            // figures are culled on the GPU and drawn indirectly from the survivors, the draw itself never changes
+            this->figureCuller = new FigureCuller(this->device, this->pipelineManager, this->allocator, (uint32_t)maxFigures);
+            this->figureCuller->setFigureCount(this->options.figureCount);
+            // the scene outlives a culler re-created with the render pass, its new buffer gets every figure again
+            if (this->figureScene.size() == maxFigures) {
+                this->figureScene.markAllDirty();
+            }
+            else {
+                this->placeFigures(maxFigures, 0.95f);
+            }
+            if (this->options.figureCount > 0) {
+                staticDraws.push_back(this->figureCuller->getDraw(this->figurePipeline));
+            }
+        }
+        if (animatedFigures > 0) {
+            this->animatedFigurePipeline = this->pipelineManager->findPipeline("animated figures");
+        }
+        if (this->options.animatedFigureCount > 0) {
+            this->figureAnimator = new FigureAnimator(this->device, this->pipelineManager, this->allocator, this->options.animatedFigureCount, this->framesInFlight);
+        }
+        if (debugLines) {
+            this->debugLinePipeline = this->pipelineManager->findPipeline("debug lines");
+            this->debugLines = new DebugLines(this->device, this->pipelineManager, this->allocator, 65536, this->framesInFlight);
+            // a floor and two platforms; y points down
+            const WorldSegment world[] = {
+                { -1.0f, 0.9f, 1.0f, 0.9f },
+                { -0.8f, 0.4f, -0.2f, 0.4f },
+                { 0.2f, -0.1f, 0.8f, -0.3f },
+            };
+            this->figureCollider.setWorld(sizeof(world) / sizeof(world[0]), world);
+        }
+        if (segments) {
+            this->segmentPipeline = this->pipelineManager->findPipeline("segments");
+        }
+        if (this->options.limbWidth > 0 && this->options.animatedFigureCount > 0) {
+            this->segmentBatcher = new SegmentBatcher(this->device, this->pipelineManager, this->allocator, this->threadPool,
+                this->options.animatedFigureCount * SegmentBatcher::FIGURE_SEGMENT_COUNT, this->framesInFlight);
+            this->limbWidth = (float)this->options.limbWidth;
+        }
+        this->pipelineManager->setStaticDraws(staticDraws.size(), staticDraws.data());
+    }
+    PipelineCreateInfo makeFigureCreateInfo(const char* name, VertexInput* input) {
+        PipelineCreateInfo createInfo{};
+        createInfo.fragmentShaderModule = "compiled_shaders/shader.frag.spv";
+        createInfo.input = input;
+        createInfo.name = name;
+        createInfo.state = PipelineState::forTopology(VkPrimitiveTopology::VK_PRIMITIVE_TOPOLOGY_LINE_LIST);
+        createInfo.vertexShaderModule = "compiled_shaders/stickfigure.vert.spv";
+        return createInfo;
+    }
+    // All figures share one vertex count and read position, scale, pose and color per instance.
+    DrawCommand makeFigureDraw(uint32_t firstFigure, uint32_t figureCount) {
+        DrawCommand figureDraw{};
+        figureDraw.pipeline = this->figurePipeline;
+        figureDraw.vertexBuffer = this->figureCuller->getFigureBuffer();
+        figureDraw.vertexCount = STICK_FIGURE_VERTEX_COUNT;
+        figureDraw.instanceCount = figureCount;
+        figureDraw.firstInstance = firstFigure;
+        return figureDraw;
+    }
+    // Scatters figures over [-range, range] with a fixed seed, so runs are comparable. The screen is [-1, 1].
+    void placeFigures(size_t figureCount, float range) {
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> position(-range, range);
+        std::uniform_real_distribution<float> scale(0.02f, 0.06f);
+        std::uniform_int_distribution<uint32_t> color(0, 0xFFFFFF);
+        this->figureScene.clear();
+        for (size_t i = 0; i < figureCount; i++) {
+            float positionX = position(random);
+            float positionY = position(random);
+            float figureScale = scale(random);
+            this->figureScene.add(positionX, positionY, figureScale, (uint32_t)(i % STICK_FIGURE_POSE_COUNT), color(random) | 0xFF000000);
+        }
+    }
+    // color is 0xRRGGBB, the shader's own red when 0
+    PipelineCreateInfo makeCircleCreateInfo(const char* name, VertexInput* input, uint32_t color = 0) {
         PipelineCreateInfo createInfo{};
-        createInfo.extent = this->swapChainExtent;
         createInfo.fragmentShaderModule = "compiled_shaders/shader.frag.spv";
-        createInfo.input = &circleVertextInput;
-        createInfo.name = "circle";
-        createInfo.topology = VkPrimitiveTopology::VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        createInfo.input = input;
+        createInfo.name = name;
+        createInfo.state = PipelineState::forTopology(VkPrimitiveTopology::VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
         createInfo.vertexShaderModule = "compiled_shaders/shader.vert.spv";
+        if (color != 0) {
+            createInfo.specializationCount = 1;
+            createInfo.specializationConstants[0] = color;
+        }
+        return createInfo;
+    }
+    // Compares the serial path (one vkCreateGraphicsPipelines per pipeline on this thread) against batched creation
+    // on the thread pool. No pipeline cache is used so every run really compiles; run with
+    // MESA_SHADER_CACHE_DISABLE=true on Mesa drivers to keep the driver's own disk cache out of the numbers too.
+    void benchmarkPipelineCreation() {
+        auto graphicsFamilyIndex = this->getFamilyIndex(this->physicalDevice, &isGraphicsFamily);
+        auto transferFamilyIndex = this->getTransferFamilyIndex(this->physicalDevice);
+        const size_t pipelineCounts[] = { 1, 10, 100 };
+        VertexInput circleVertextInput = VertexInput::of<CircleVertex>(1);
+
+        for (size_t pipelineCount : pipelineCounts) {
+            std::vector<std::string> names(pipelineCount);
+            std::vector<PipelineCreateInfo> createInfos(pipelineCount);
+            for (size_t i = 0; i < pipelineCount; i++) {
+                names[i] = "circle" + std::to_string(i);
+                // a color of their own keeps the pipelines from being shared
+                createInfos[i] = this->makeCircleCreateInfo(names[i].c_str(), &circleVertextInput, (uint32_t)i + 1);
+            }
+
+            double creationTimes[2];
+            for (int parallel = 0; parallel < 2; parallel++) {
+                PipelineManager manager(this->physicalDevice, this->device, this->renderPass, VK_NULL_HANDLE, parallel ? this->threadPool : nullptr, this->allocator, transferFamilyIndex.value(), graphicsFamilyIndex.value(), this->drawIndirectCountSupported);
+                auto creationStart = std::chrono::steady_clock::now();
+                manager.createPipelines(pipelineCount, createInfos.data());
+                std::chrono::duration<double, std::milli> creationTime = std::chrono::steady_clock::now() - creationStart;
+                creationTimes[parallel] = creationTime.count();
+            }
+            std::cout << "pipeline creation, " << pipelineCount << " pipelines: serial " << creationTimes[0] << " ms, "
+                << "batched on " << this->threadPool->getThreadCount() << " threads " << creationTimes[1] << " ms, "
+                << "speedup " << creationTimes[0] / creationTimes[1] << "x\n";
+        }
+    }
+    // Creates pipelines, then creates them again under the same names while counting operator new calls outside of
+    // the driver. Re-creation has to allocate nothing, the bench fails otherwise. The names are too long for a
+    // std::string's inline buffer and the manager reports to the profiler, like the app's own pipelines.
+    void benchmarkPipelineAllocations() {
+        auto graphicsFamilyIndex = this->getFamilyIndex(this->physicalDevice, &isGraphicsFamily);
+        auto transferFamilyIndex = this->getTransferFamilyIndex(this->physicalDevice);
+        const size_t pipelineCount = 100;
+        const int rounds = 5;
+        VertexInput circleVertextInput = VertexInput::of<CircleVertex>(1);
+
+        std::vector<std::string> names(pipelineCount);
+        std::vector<PipelineCreateInfo> createInfos(pipelineCount);
+        for (size_t i = 0; i < pipelineCount; i++) {
+            names[i] = "benchmark circle pipeline " + std::to_string(i);
+            createInfos[i] = this->makeCircleCreateInfo(names[i].c_str(), &circleVertextInput);
+        }
+        PipelineManager manager(this->physicalDevice, this->device, this->renderPass, this->pipelineCache->get(), this->threadPool, this->allocator, transferFamilyIndex.value(), graphicsFamilyIndex.value(), this->drawIndirectCountSupported);
+        manager.setProfiler(this->profiler, this->hostQueryResetSupported);
+        AllocationCounter::start();
+        manager.createPipelines(pipelineCount, createInfos.data());
+        uint64_t firstAllocations = AllocationCounter::stop();
+
+        uint64_t recreationAllocations = 0;
+        for (int round = 0; round < rounds; round++) {
+            AllocationCounter::start();
+            manager.createPipelines(pipelineCount, createInfos.data());
+            recreationAllocations += AllocationCounter::stop();
+        }
+        std::cout << "pipeline creation allocations, " << pipelineCount << " pipelines: first creation " << firstAllocations
+            << ", " << rounds << " re-creations " << recreationAllocations << "\n";
+        if (recreationAllocations > 0) {
+            throw std::runtime_error("re-creating pipelines allocated " + std::to_string(recreationAllocations) + " times!");
+        }
+    }
+    // Times writeCommands for draws that each use a different one of 1000 materials. With a color per material every
+    // draw rebinds pipeline and vertex buffer; with four colors the materials share four pipelines, and the draws,
+    // sorted by color, bind only those four. For comparison the same draws are also resolved from their names first,
+    // the cost string keyed draws would add back to every frame.
+    void benchmarkWriteCommands() {
+        auto graphicsFamilyIndex = this->getFamilyIndex(this->physicalDevice, &isGraphicsFamily);
+        auto transferFamilyIndex = this->getTransferFamilyIndex(this->physicalDevice);
+        const size_t pipelineCount = 1000;
+        const size_t colorCounts[] = { pipelineCount, 4 };
+        const int iterations = 200;
+        VertexInput circleVertextInput = VertexInput::of<CircleVertex>(1);
+
+        VkCommandPool commandPool;
+        createCommandPool(this->device, graphicsFamilyIndex.value(), &commandPool, VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(this->device, &allocInfo, &commandBuffer) != VkResult::VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+
+        for (size_t colorCount : colorCounts) {
+            std::vector<std::string> names(pipelineCount);
+            std::vector<PipelineCreateInfo> createInfos(pipelineCount);
+            for (size_t i = 0; i < pipelineCount; i++) {
+                names[i] = "material" + std::to_string(i);
+                createInfos[i] = this->makeCircleCreateInfo(names[i].c_str(), &circleVertextInput, (uint32_t)(i * colorCount / pipelineCount) + 1);
+            }
+            PipelineManager manager(this->physicalDevice, this->device, this->renderPass, this->pipelineCache->get(), this->threadPool, this->allocator, transferFamilyIndex.value(), graphicsFamilyIndex.value(), this->drawIndirectCountSupported);
+            manager.createPipelines(pipelineCount, createInfos.data());
+
+            std::vector<DrawCommand> draws(pipelineCount);
+            for (size_t i = 0; i < pipelineCount; i++) {
+                draws[i] = {};
+                draws[i].pipeline = manager.findPipeline(names[i]);
+                draws[i].vertexCount = this->linesInCircle + 1;
+                draws[i].instanceCount = 1;
+            }
+
+            for (int byName = 0; byName < 2; byName++) {
+                SampleSeries recordingTimes(std::string("writeCommands, ") + std::to_string(pipelineCount) + " materials on "
+                    + std::to_string(manager.getVariantCount()) + " pipelines, " + (byName ? "resolved by name" : "by handle"));
+                for (int iteration = 0; iteration < iterations; iteration++) {
+                    vkResetCommandPool(this->device, commandPool, 0);
+                    manager.beginSecondary(commandBuffer, VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+                    auto recordingStart = std::chrono::steady_clock::now();
+                    if (byName) {
+                        for (size_t i = 0; i < pipelineCount; i++) {
+                            draws[i].pipeline = manager.findPipeline(names[i]);
+                        }
+                    }
+                    manager.writeCommands(commandBuffer, this->swapChainExtent, draws.size(), draws.data());
+                    std::chrono::duration<double, std::micro> recordingTime = std::chrono::steady_clock::now() - recordingStart;
+                    recordingTimes.addSample(recordingTime.count());
+                    if (vkEndCommandBuffer(commandBuffer) != VkResult::VK_SUCCESS) {
+                        throw std::runtime_error("failed to record command buffer!");
+                    }
+                }
+                recordingTimes.report(std::cout, "us");
+            }
+        }
+        vkDestroyCommandPool(this->device, commandPool, nullptr);
+    }
+    // Creates and destroys small vertex buffers the way PipelineManager does, once with a vkAllocateMemory per buffer
+    // and once through the sub-allocator, then frees every other buffer to show how fragmented the pools get.
+    void benchmarkBufferAllocation() {
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(this->physicalDevice, &deviceProperties);
+        const size_t bufferCounts[] = { 100, 1000, 10000 };
+
+        for (size_t bufferCount : bufferCounts) {
+            std::vector<VkBuffer> buffers(bufferCount);
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.usage = VkBufferUsageFlagBits::VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            bufferInfo.sharingMode = VkSharingMode::VK_SHARING_MODE_EXCLUSIVE;
+            for (size_t i = 0; i < bufferCount; i++) {
+                // sizes vary between 256 bytes and 16 KiB so the free lists see some mixing
+                bufferInfo.size = 256 << (i % 7);
+                if (vkCreateBuffer(this->device, &bufferInfo, nullptr, &buffers[i]) != VkResult::VK_SUCCESS) {
+                    throw std::runtime_error("failed to create vertex buffer!");
+                }
+            }
+
+            std::string dedicatedResult = "skipped, above maxMemoryAllocationCount";
+            if (bufferCount + 16 <= deviceProperties.limits.maxMemoryAllocationCount) {
+                std::vector<VkDeviceMemory> memories(bufferCount);
+                auto dedicatedStart = std::chrono::steady_clock::now();
+                for (size_t i = 0; i < bufferCount; i++) {
+                    VkMemoryRequirements memRequirements;
+                    vkGetBufferMemoryRequirements(this->device, buffers[i], &memRequirements);
+                    VkMemoryAllocateInfo allocInfo{};
+                    allocInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+                    allocInfo.allocationSize = memRequirements.size;
+                    allocInfo.memoryTypeIndex = this->allocator->findMemoryType(memRequirements.memoryTypeBits, VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                    if (vkAllocateMemory(this->device, &allocInfo, nullptr, &memories[i]) != VkResult::VK_SUCCESS) {
+                        throw std::runtime_error("failed to allocate vertex buffer memory!");
+                    }
+                }
+                for (size_t i = 0; i < bufferCount; i++) {
+                    vkFreeMemory(this->device, memories[i], nullptr);
+                }
+                std::chrono::duration<double, std::milli> dedicatedTime = std::chrono::steady_clock::now() - dedicatedStart;
+                dedicatedResult = std::to_string(dedicatedTime.count()) + " ms";
+            }
+
+            GpuAllocator allocator(this->physicalDevice, this->device);
+            std::vector<GpuAllocation> allocations(bufferCount);
+            auto subAllocationStart = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < bufferCount; i++) {
+                VkMemoryRequirements memRequirements;
+                vkGetBufferMemoryRequirements(this->device, buffers[i], &memRequirements);
+                allocations[i] = allocator.allocate(memRequirements, VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuResourceKind::Linear);
+            }
+            std::chrono::duration<double, std::milli> subAllocationTime = std::chrono::steady_clock::now() - subAllocationStart;
 
+            std::cout << "buffer allocation, " << bufferCount << " buffers: vkAllocateMemory per buffer " << dedicatedResult << ", "
+                << "sub-allocated " << subAllocationTime.count() << " ms\n";
+            for (size_t i = 0; i < bufferCount; i += 2) {
+                allocator.free(allocations[i]);
+            }
+            std::cout << "  after freeing every other buffer: ";
+            allocator.printStats(std::cout);
+            for (size_t i = 1; i < bufferCount; i += 2) {
+                allocator.free(allocations[i]);
+            }
 
-        this->pipelineManager->createPipelines(1, &createInfo);
-        this->pipelineManager->writeVertexData(&this->linesInCircle, "circle");
+            for (auto buffer : buffers) {
+                vkDestroyBuffer(this->device, buffer, nullptr);
+            }
+        }
+    }
+    // Records frames with many dynamic circle draws and no submit, splitting them over 1 to N threads.
+    void benchmarkCommandRecording() {
+        const size_t drawCounts[] = { 1000, 10000, 100000 };
+        const int iterations = 100;
+        size_t maxThreads = this->commandRecorder->getMaxChunkCount();
+        // doubling thread counts, always ending with all of them
+        std::vector<size_t> threadCounts;
+        for (size_t threads = 1; threads < maxThreads; threads *= 2) {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(maxThreads);
+
+        for (size_t drawCount : drawCounts) {
+            DrawCommand circleDraw{};
+            circleDraw.pipeline = this->circlePipeline;
+            circleDraw.vertexCount = this->linesInCircle + 1;
+            circleDraw.instanceCount = 1;
+            this->dynamicDraws.assign(drawCount, circleDraw);
+
+            double singleThreadMean = 0.0;
+            for (size_t threads : threadCounts) {
+                this->recordingThreads = threads;
+                SampleSeries recordingTimes("recording, " + std::to_string(drawCount) + " draws, " + std::to_string(threads) + " threads");
+                for (int iteration = 0; iteration < iterations; iteration++) {
+                    auto recordingStart = std::chrono::steady_clock::now();
+                    this->recordFrameCommands(0, 0);
+                    std::chrono::duration<double, std::milli> recordingTime = std::chrono::steady_clock::now() - recordingStart;
+                    recordingTimes.addSample(recordingTime.count());
+                }
+                if (threads == 1) {
+                    singleThreadMean = recordingTimes.mean();
+                }
+                recordingTimes.report(std::cout, "ms");
+                std::cout << "  speedup over 1 thread " << singleThreadMean / recordingTimes.mean() << "x\n";
+            }
+        }
+        this->dynamicDraws.clear();
+        this->recordingThreads = maxThreads;
+        this->profiler->discardFrame(0);
+    }
+    // Renders the same figures once with a single instanced draw and once with one draw per figure.
+    // Each frame is waited for, so the numbers include recording, submit and GPU time.
+    void benchmarkFigures() {
+        const uint32_t figureCounts[] = { 1000, 10000, 100000 };
+        const int frames = 20;
+        // only the figures, the circle would be the same in both
+        this->pipelineManager->setStaticDraws(0, nullptr);
+
+        for (uint32_t figureCount : figureCounts) {
+            double figuresPerSecond[2];
+            for (int instanced = 1; instanced >= 0; instanced--) {
+                if (instanced) {
+                    this->dynamicDraws.assign(1, this->makeFigureDraw(0, figureCount));
+                }
+                else {
+                    this->dynamicDraws.resize(figureCount);
+                    for (uint32_t figure = 0; figure < figureCount; figure++) {
+                        this->dynamicDraws[figure] = this->makeFigureDraw(figure, 1);
+                    }
+                }
+                SampleSeries frameTimes(std::string(instanced ? "instanced, " : "draw per figure, ") + std::to_string(figureCount) + " figures");
+                for (int frame = 0; frame < frames; frame++) {
+                    auto frameStart = std::chrono::steady_clock::now();
+                    this->drawFrame();
+                    vkDeviceWaitIdle(this->device);
+                    std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+                    frameTimes.addSample(frameTime.count());
+                    this->frameCount++;
+                }
+                frameTimes.report(std::cout, "ms");
+                figuresPerSecond[instanced] = figureCount / (frameTimes.mean() / 1000.0);
+            }
+            std::cout << "  figures/s: instanced " << figuresPerSecond[1] << ", draw per figure " << figuresPerSecond[0]
+                << ", " << figuresPerSecond[1] / figuresPerSecond[0] << "x\n";
+        }
+        this->dynamicDraws.clear();
+    }
+    // Moves a growing number of random figures out of 100000 every frame and measures what flushing the scene uploads
+    // and how long it takes; whole frames are drawn in between so the ring keeps being drained.
+    void benchmarkScene() {
+        const uint32_t changedCounts[] = { 0, 10, 100, 1000, 10000, 100000 };
+        const int frames = 20;
+        const uint32_t figureCount = this->figureScene.size();
+        std::mt19937 random(7);
+        std::uniform_int_distribution<uint32_t> figures(0, figureCount - 1);
+        std::uniform_real_distribution<float> offset(-0.01f, 0.01f);
+        UploadRing* uploadRing = this->pipelineManager->getUploadRing();
+        VkBuffer figureBuffer = this->figureCuller->getFigureBuffer();
+        this->figureScene.flush(uploadRing, figureBuffer);
+
+        for (uint32_t changedCount : changedCounts) {
+            SampleSeries flushTimes("scene flush, " + std::to_string(changedCount) + " of " + std::to_string(figureCount) + " figures changed");
+            uint64_t uploadedBytes = 0;
+            uint64_t uploadedRanges = 0;
+            for (int frame = 0; frame < frames; frame++) {
+                const float* positionsX = this->figureScene.getPositionsX();
+                const float* positionsY = this->figureScene.getPositionsY();
+                for (uint32_t i = 0; i < changedCount; i++) {
+                    FigureId figure = changedCount == figureCount ? i : figures(random);
+                    this->figureScene.setPosition(figure, positionsX[figure] + offset(random), positionsY[figure] + offset(random));
+                }
+                auto flushStart = std::chrono::steady_clock::now();
+                SceneFlushStats stats = this->figureScene.flush(uploadRing, figureBuffer);
+                std::chrono::duration<double, std::micro> flushTime = std::chrono::steady_clock::now() - flushStart;
+                flushTimes.addSample(flushTime.count());
+                uploadedBytes += stats.uploadedBytes;
+                uploadedRanges += stats.uploadedRanges;
+                this->drawFrame();
+                this->frameCount++;
+            }
+            flushTimes.report(std::cout, "us");
+            std::cout << "  uploaded per frame: " << uploadedBytes / frames << " bytes in " << uploadedRanges / frames << " copies\n";
+        }
+        vkDeviceWaitIdle(this->device);
+    }
+    // Poses animated figures on every path the CPU has, checks each against the scalar one and reports figures per
+    // millisecond; then draws frames with the widest path posing every frame.
+    void benchmarkPoses() {
+        const uint32_t figureCounts[] = { 1000, 10000, 100000 };
+        const int iterations = 50;
+        const int frames = 20;
+        const PoseEvaluationPath paths[] = { PoseEvaluationPath::Scalar, PoseEvaluationPath::Sse, PoseEvaluationPath::Avx2 };
+        std::cout << "widest pose evaluation path: " << PoseEvaluator::getName(PoseEvaluator::getWidestPath()) << "\n";
+
+        for (uint32_t figureCount : figureCounts) {
+            FigureAnimator* animator = new FigureAnimator(this->device, this->pipelineManager, this->allocator, figureCount, this->framesInFlight);
+            animator->animate(0.25);
+            std::vector<AnimatedFigureInstance> scalarInstances;
+            double scalarFiguresPerMs = 0.0;
+            for (PoseEvaluationPath path : paths) {
+                if (!PoseEvaluator::isSupported(path)) {
+                    std::cout << PoseEvaluator::getName(path) << " is not supported on this CPU\n";
+                    continue;
+                }
+                animator->setPath(path);
+                SampleSeries evaluationTimes(std::string(PoseEvaluator::getName(path)) + ", " + std::to_string(figureCount) + " figures");
+                for (int iteration = 0; iteration < iterations; iteration++) {
+                    auto evaluationStart = std::chrono::steady_clock::now();
+                    // straight into the mapped buffer, like a frame does
+                    animator->evaluate(0);
+                    std::chrono::duration<double, std::micro> evaluationTime = std::chrono::steady_clock::now() - evaluationStart;
+                    evaluationTimes.addSample(evaluationTime.count());
+                }
+                evaluationTimes.report(std::cout, "us");
+                double figuresPerMs = figureCount / (evaluationTimes.mean() / 1000.0);
+
+                const AnimatedFigureInstance* instances = animator->getInstances(0);
+                if (path == PoseEvaluationPath::Scalar) {
+                    scalarInstances.assign(instances, instances + figureCount);
+                    scalarFiguresPerMs = figuresPerMs;
+                    std::cout << "  " << figuresPerMs << " figures/ms\n";
+                    continue;
+                }
+                float maxDifference = 0.0f;
+                for (uint32_t figure = 0; figure < figureCount; figure++) {
+                    for (uint32_t joint = 0; joint < SKELETON_JOINT_COUNT; joint++) {
+                        for (uint32_t axis = 0; axis < 2; axis++) {
+                            float difference = std::abs(instances[figure].joints[joint][axis] - scalarInstances[figure].joints[joint][axis]);
+                            maxDifference = std::max(maxDifference, difference);
+                        }
+                    }
+                }
+                if (maxDifference > 1e-5f) {
+                    throw std::runtime_error(std::string(PoseEvaluator::getName(path)) + " poses differ from the scalar ones by " + std::to_string(maxDifference) + "!");
+                }
+                std::cout << "  " << figuresPerMs << " figures/ms, " << figuresPerMs / scalarFiguresPerMs << "x scalar, max difference " << maxDifference << "\n";
+            }
+
+            animator->setPath(PoseEvaluator::getWidestPath());
+            FigureAnimator* appAnimator = this->figureAnimator;
+            this->figureAnimator = animator;
+            SampleSeries frameTimes("animated frames, " + std::to_string(figureCount) + " figures");
+            for (int frame = 0; frame < frames; frame++) {
+                auto frameStart = std::chrono::steady_clock::now();
+                this->drawFrame();
+                std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+                frameTimes.addSample(frameTime.count());
+                this->frameCount++;
+            }
+            frameTimes.report(std::cout, "ms");
+            vkDeviceWaitIdle(this->device);
+            this->figureAnimator = appAnimator;
+            delete animator;
+        }
+    }
+    // Times pair generation of the spatial hash from 1000 to 100000 figures, spread so that every count has about as
+    // many neighbours per figure, against testing all pairs up to 10000 figures, whose pairs it has to match; then the
+    // capsule narrowphase on the pairs found.
+    void benchmarkCollisions() {
+        const uint32_t figureCounts[] = { 1000, 3000, 10000, 30000, 100000 };
+        const uint32_t bruteForceLimit = 10000;
+        const int iterations = 20;
+        FigureCollider collider;
+        std::vector<AnimatedFigureInstance> figures;
+        for (uint32_t figureCount : figureCounts) {
+            FigureAnimator animator(this->device, this->pipelineManager, this->allocator, figureCount, 1);
+            FigurePoses& poses = animator.getPoses();
+            float spread = std::sqrt(figureCount / 1000.0f);
+            for (uint32_t figure = 0; figure < figureCount; figure++) {
+                poses.positionsX[figure] *= spread;
+                poses.positionsY[figure] *= spread;
+            }
+            animator.animate(0.25);
+            figures.resize(figureCount);
+            PoseEvaluator::evaluate(poses, 0, figureCount, figures.data(), PoseEvaluator::getWidestPath());
+
+            SampleSeries pairTimes("spatial hash pairs, " + std::to_string(figureCount) + " figures");
+            for (int iteration = 0; iteration < iterations; iteration++) {
+                auto pairStart = std::chrono::steady_clock::now();
+                collider.findPairs(figures.data(), figureCount);
+                std::chrono::duration<double, std::micro> pairTime = std::chrono::steady_clock::now() - pairStart;
+                pairTimes.addSample(pairTime.count());
+            }
+            pairTimes.report(std::cout, "us");
+            std::vector<CollisionPair> pairs = collider.getPairs();
+            std::cout << "  " << pairs.size() << " pairs\n";
+
+            auto contactStart = std::chrono::steady_clock::now();
+            size_t contactCount = collider.findContacts(figures.data(), figureCount);
+            std::chrono::duration<double, std::micro> contactTime = std::chrono::steady_clock::now() - contactStart;
+            std::cout << "  narrowphase: " << contactCount << " contacts in " << contactTime.count() << " us\n";
+
+            if (figureCount > bruteForceLimit) {
+                continue;
+            }
+            auto bruteForceStart = std::chrono::steady_clock::now();
+            collider.findPairsBruteForce(figures.data(), figureCount);
+            std::chrono::duration<double, std::micro> bruteForceTime = std::chrono::steady_clock::now() - bruteForceStart;
+            std::vector<CollisionPair> expectedPairs = collider.getPairs();
+            auto pairOrder = [](const CollisionPair& first, const CollisionPair& second) {
+                return first.a != second.a ? first.a < second.a : first.b < second.b;
+            };
+            std::sort(pairs.begin(), pairs.end(), pairOrder);
+            std::sort(expectedPairs.begin(), expectedPairs.end(), pairOrder);
+            bool samePairs = pairs.size() == expectedPairs.size() && std::equal(pairs.begin(), pairs.end(), expectedPairs.begin(),
+                [](const CollisionPair& first, const CollisionPair& second) { return first.a == second.a && first.b == second.b; });
+            if (!samePairs) {
+                throw std::runtime_error("spatial hash found " + std::to_string(pairs.size()) + " pairs, all pairs testing " + std::to_string(expectedPairs.size()) + "!");
+            }
+            std::cout << "  all pairs: " << bruteForceTime.count() << " us, " << bruteForceTime.count() / pairTimes.mean() << "x the spatial hash\n";
+        }
+    }
+    // Task system microbenchmarks on pools of their own: what spawning an empty task and a dependency cost and how
+    // long an empty parallelFor takes, then pose evaluation of a million figures split by parallelFor on 1 to all
+    // hardware threads.
+    void benchmarkTasks() {
+        const size_t spawnCount = 100000;
+        const size_t chainLength = 10000;
+        const int parallelForCalls = 1000;
+        size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<Task*> tasks;
+        for (size_t i = 0; i < spawnCount; i++) {
+            tasks.push_back(new Task([] {}));
+        }
+        std::vector<Task*> chain;
+        for (size_t i = 0; i < chainLength; i++) {
+            chain.push_back(new Task([] {}));
+            if (i > 0) {
+                chain[i]->dependsOn(*chain[i - 1]);
+            }
+        }
+        for (size_t threadCount : { (size_t)1, hardwareThreads }) {
+            ThreadPool pool(threadCount);
+            auto spawnStart = std::chrono::steady_clock::now();
+            pool.submit(tasks.size(), tasks.data());
+            for (Task* task : tasks) {
+                pool.wait(*task);
+            }
+            std::chrono::duration<double, std::nano> spawnTime = std::chrono::steady_clock::now() - spawnStart;
+
+            auto chainStart = std::chrono::steady_clock::now();
+            pool.submit(chain.size(), chain.data());
+            pool.wait(*chain.back());
+            std::chrono::duration<double, std::nano> chainTime = std::chrono::steady_clock::now() - chainStart;
+
+            auto parallelForStart = std::chrono::steady_clock::now();
+            for (int call = 0; call < parallelForCalls; call++) {
+                pool.parallelFor(threadCount, [](size_t) {});
+            }
+            std::chrono::duration<double, std::micro> parallelForTime = std::chrono::steady_clock::now() - parallelForStart;
+            std::cout << threadCount << " threads: " << spawnTime.count() / spawnCount << " ns per independent task, "
+                << chainTime.count() / chainLength << " ns per dependent task, " << parallelForTime.count() / parallelForCalls << " us per empty parallelFor\n";
+        }
+        for (Task* task : tasks) {
+            delete task;
+        }
+        for (Task* task : chain) {
+            delete task;
+        }
+
+        const size_t figureCount = 1000000;
+        const size_t chunkSize = 4096;
+        const int iterations = 10;
+        FigurePoses poses;
+        poses.resize(figureCount);
+        for (size_t figure = 0; figure < figureCount; figure++) {
+            poses.positionsX[figure] = (figure % 1000) * 0.002f - 1.0f;
+            poses.positionsY[figure] = (figure / 1000) * 0.002f - 1.0f;
+            poses.scales[figure] = 0.04f;
+            poses.colors[figure] = 0xFF000000;
+            for (uint32_t bone = 0; bone < SKELETON_BONE_COUNT; bone++) {
+                poses.boneAngles[bone][figure] = 0.001f * (figure % 997) + 0.1f * bone;
+            }
+        }
+        std::vector<AnimatedFigureInstance> instances(figureCount);
+        size_t chunkCount = (figureCount + chunkSize - 1) / chunkSize;
+        PoseEvaluationPath path = PoseEvaluator::getWidestPath();
+        double singleThreadMean = 0.0;
+        for (size_t threadCount = 1; threadCount <= hardwareThreads; threadCount = threadCount < hardwareThreads ? std::min(threadCount * 2, hardwareThreads) : threadCount + 1) {
+            ThreadPool pool(threadCount);
+            SampleSeries evaluationTimes("poses of " + std::to_string(figureCount) + " figures, " + std::to_string(threadCount) + " threads");
+            for (int iteration = 0; iteration < iterations; iteration++) {
+                auto evaluationStart = std::chrono::steady_clock::now();
+                pool.parallelFor(chunkCount, [&](size_t chunk) {
+                    size_t first = chunk * chunkSize;
+                    size_t count = std::min(chunkSize, figureCount - first);
+                    PoseEvaluator::evaluate(poses, first, count, instances.data() + first, path);
+                });
+                std::chrono::duration<double, std::milli> evaluationTime = std::chrono::steady_clock::now() - evaluationStart;
+                evaluationTimes.addSample(evaluationTime.count());
+            }
+            evaluationTimes.report(std::cout, "ms");
+            if (threadCount == 1) {
+                singleThreadMean = evaluationTimes.mean();
+            }
+            std::cout << "  " << singleThreadMean / evaluationTimes.mean() << "x one thread\n";
+        }
+    }
+    // Draws frames with whatever the options set up until everything reached its largest size, then counts operator
+    // new calls on every thread over the next frames. A steady frame has to allocate nothing outside of the driver;
+    // what only lives during a frame goes to the frame's arena. The bench fails otherwise.
+    void benchmarkFrameAllocations() {
+        const int warmupFrames = 200;
+        const int countedFrames = 500;
+        {
+            // a container on an arena never calls operator new
+            FrameArena arena(64 * 1024);
+            AllocationCounter::start();
+            std::pmr::vector<uint32_t> values(&arena);
+            for (uint32_t value = 0; value < 10000; value++) {
+                values.push_back(value);
+            }
+            uint64_t arenaAllocations = AllocationCounter::stop();
+            if (arenaAllocations > 0 || values[9999] != 9999 || arena.getUsedBytes() == 0) {
+                throw std::runtime_error("a vector on a frame arena went to the global heap!");
+            }
+        }
+
+        for (int frame = 0; frame < warmupFrames; frame++) {
+            this->drawFrame();
+            this->frameCount++;
+        }
+        AllocationCounter::start();
+        for (int frame = 0; frame < countedFrames; frame++) {
+            this->drawFrame();
+            this->frameCount++;
+        }
+        uint64_t frameAllocations = AllocationCounter::stop();
+        vkDeviceWaitIdle(this->device);
+
+        size_t highWater = 0;
+        uint64_t overflows = 0;
+        for (FrameArena* frameArena : this->frameArenas) {
+            highWater = std::max(highWater, frameArena->getHighWaterBytes());
+            overflows += frameArena->getOverflowCount();
+        }
+#ifdef FRAME_ARENA_CHECKS
+        const char* arenaMode = "checked";
+#else
+        const char* arenaMode = "unchecked";
+#endif
+        std::cout << "heap allocations over " << countedFrames << " steady frames: " << frameAllocations
+            << ", " << arenaMode << " frame arena high water " << highWater << " of " << FRAME_ARENA_SIZE << " bytes, " << overflows << " overflows\n";
+        if (frameAllocations > 0) {
+            throw std::runtime_error("steady frames allocated " + std::to_string(frameAllocations) + " times!");
+        }
+    }
+    // Draws 20000 animated figures as one pixel line lists, then through the segment batcher at rising widths, and
+    // reports CPU and GPU frame times. The batcher's draw is one instanced draw at any width.
+    void benchmarkSegments() {
+        const uint32_t figureCount = 20000;
+        const float widths[] = { 1.0f, 3.0f, 8.0f };
+        const int frames = 300;
+        FigureAnimator* appAnimator = this->figureAnimator;
+        SegmentBatcher* appBatcher = this->segmentBatcher;
+        float appLimbWidth = this->limbWidth;
+        this->figureAnimator = new FigureAnimator(this->device, this->pipelineManager, this->allocator, figureCount, this->framesInFlight);
+        SegmentBatcher* batcher = new SegmentBatcher(this->device, this->pipelineManager, this->allocator, this->threadPool,
+            figureCount * SegmentBatcher::FIGURE_SEGMENT_COUNT, this->framesInFlight);
+
+        // the first run draws line lists
+        for (int run = -1; run < (int)(sizeof(widths) / sizeof(widths[0])); run++) {
+            this->segmentBatcher = run < 0 ? nullptr : batcher;
+            this->limbWidth = run < 0 ? 0.0f : widths[run];
+            std::string name = run < 0 ? std::string("line lists") : "segments " + std::to_string((int)widths[run]) + " px";
+            SampleSeries cpuTimes(name + ", CPU frame time");
+            SampleSeries gpuTimes(name + ", GPU frame time");
+            for (int frame = 0; frame < frames; frame++) {
+                auto frameStart = std::chrono::steady_clock::now();
+                this->drawFrame();
+                std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+                cpuTimes.addSample(frameTime.count());
+                if (this->profiler->hasGpuTimestamps()) {
+                    gpuTimes.addSample(this->profiler->getLastFrameMilliseconds());
+                }
+                this->frameCount++;
+            }
+            cpuTimes.report(std::cout, "ms");
+            if (this->profiler->hasGpuTimestamps()) {
+                gpuTimes.report(std::cout, "ms");
+            }
+            if (run >= 0 && (batcher->getSegmentCount() != figureCount * SegmentBatcher::FIGURE_SEGMENT_COUNT || batcher->getDroppedSegmentCount() > 0)) {
+                throw std::runtime_error("the segment batcher lost segments of " + std::to_string(figureCount) + " figures!");
+            }
+        }
+        vkDeviceWaitIdle(this->device);
+        this->segmentBatcher = appBatcher;
+        this->limbWidth = appLimbWidth;
+        delete batcher;
+        delete this->figureAnimator;
+        this->figureAnimator = appAnimator;
+    }
+    // Runs the simulation thread with 10000 entities at rising tick rates while drawing frames as fast as they go, and
+    // reports both rates: each is set by its own thread, the frame rate doesn't follow the tick rate.
+    void benchmarkSimulation() {
+        const uint32_t entityCount = 10000;
+        const uint32_t tickRates[] = { 30, 60, 240, 1000 };
+        const double seconds = 2.0;
+        this->placeFigures(entityCount, 0.95f);
+        this->figureCuller->setFigureCount(entityCount);
+        DrawCommand figureDraw = this->figureCuller->getDraw(this->figurePipeline);
+        this->pipelineManager->setStaticDraws(1, &figureDraw);
+        Simulation* appSimulation = this->simulation;
+
+        {
+            Simulation simulation(this->figureScene.getPositionsX(), this->figureScene.getPositionsY(), entityCount, 60);
+            SampleSeries tickTimes("simulation tick, " + std::to_string(entityCount) + " entities");
+            for (int i = 0; i < 1000; i++) {
+                auto tickStart = std::chrono::steady_clock::now();
+                simulation.tick(tickStart);
+                std::chrono::duration<double, std::micro> tickTime = std::chrono::steady_clock::now() - tickStart;
+                tickTimes.addSample(tickTime.count());
+            }
+            tickTimes.report(std::cout, "us");
+            std::cout << "  at most " << (uint64_t)(1000000.0 / tickTimes.mean()) << " ticks per second on one thread\n";
+        }
+
+        for (uint32_t tickRate : tickRates) {
+            this->simulation = new Simulation(this->figureScene.getPositionsX(), this->figureScene.getPositionsY(), entityCount, tickRate);
+            this->simulation->start();
+            auto runStart = std::chrono::steady_clock::now();
+            uint64_t frames = 0;
+            std::chrono::duration<double> runTime(0.0);
+            while (runTime.count() < seconds) {
+                this->drawFrame();
+                this->frameCount++;
+                frames++;
+                runTime = std::chrono::steady_clock::now() - runStart;
+            }
+            this->simulation->stop();
+            std::cout << tickRate << " Hz simulation: " << this->simulation->getPublishedTickCount() / runTime.count() << " ticks/s, "
+                << this->simulation->getDroppedTickCount() << " ticks dropped, " << frames / runTime.count() << " frames/s\n";
+            vkDeviceWaitIdle(this->device);
+            delete this->simulation;
+        }
+        this->simulation = appSimulation;
+    }
+    // Places figures over twice the screen size so about three quarters are culled, then checks the GPU's visible count
+    // against the same test on the CPU and times frames with culling against drawing every figure.
+    void benchmarkCulling() {
+        const uint32_t figureCounts[] = { 1000, 10000, 100000 };
+        const int frames = 20;
+        std::cout << "culled draws use " << (this->drawIndirectCountSupported ? "vkCmdDrawIndirectCount" : "vkCmdDrawIndirect") << "\n";
+
+        for (uint32_t figureCount : figureCounts) {
+            this->placeFigures(figureCount, 2.0f);
+            this->figureCuller->setFigureCount(figureCount);
+
+            const float* positionsX = this->figureScene.getPositionsX();
+            const float* positionsY = this->figureScene.getPositionsY();
+            const float* scales = this->figureScene.getScales();
+            uint32_t expectedVisible = 0;
+            for (uint32_t i = 0; i < figureCount; i++) {
+                float distanceX = std::abs(positionsX[i]) - 0.5f * scales[i];
+                float distanceY = std::abs(positionsY[i]) - 1.0f * scales[i];
+                if (distanceX <= 1.0f && distanceY <= 1.0f) {
+                    expectedVisible++;
+                }
+            }
+
+            double frameTimeMeans[2];
+            uint32_t gpuVisible = 0;
+            for (int culled = 1; culled >= 0; culled--) {
+                DrawCommand figureDraw = culled ? this->figureCuller->getDraw(this->figurePipeline) : this->makeFigureDraw(0, figureCount);
+                this->pipelineManager->setStaticDraws(1, &figureDraw);
+                SampleSeries frameTimes(std::string(culled ? "GPU culled, " : "all drawn, ") + std::to_string(figureCount) + " figures");
+                for (int frame = 0; frame < frames; frame++) {
+                    auto frameStart = std::chrono::steady_clock::now();
+                    this->drawFrame();
+                    vkDeviceWaitIdle(this->device);
+                    std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+                    frameTimes.addSample(frameTime.count());
+                    this->frameCount++;
+                }
+                frameTimes.report(std::cout, "ms");
+                frameTimeMeans[culled] = frameTimes.mean();
+                if (culled) {
+                    // the culling pass still runs every frame, with nothing to cull it does not dispatch
+                    gpuVisible = this->figureCuller->readVisibleCount();
+                    this->figureCuller->setFigureCount(0);
+                }
+            }
+
+            std::cout << "  visible: GPU " << gpuVisible << ", CPU " << expectedVisible << ", culled frames "
+                << frameTimeMeans[0] / frameTimeMeans[1] << "x faster\n";
+            if (gpuVisible != expectedVisible) {
+                throw std::runtime_error("GPU culling result does not match the CPU reference!");
+            }
+        }
     }
     void createImageViews() {
         this->swapChainImageViews.resize(this->swapChainImages.size());
@@ -343,7 +1469,8 @@ private:
         createInfo.compositeAlpha = VkCompositeAlphaFlagBitsKHR::VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        // on recreation the retired swapchain is handed over, so images it already acquired can still be presented
+        createInfo.oldSwapchain = this->swapChain;
 
         if (vkCreateSwapchainKHR(this->device, &createInfo, nullptr, &this->swapChain) != VkResult::VK_SUCCESS) {
             throw std::runtime_error("failed to create swap chain!");
@@ -365,8 +1492,8 @@ private:
 
     void createLogicalDevice() {
         auto graphicsFamilyIndex = this->getFamilyIndex(this->physicalDevice, &isGraphicsFamily);
-        auto presentFamilyIndex = this->getFamilyIndex(this->physicalDevice, &isPresentFamily);
-        auto transferFamilyIndex = this->getFamilyIndex(this->physicalDevice, &isTransferFamily);
+        auto presentFamilyIndex = this->getPresentFamilyIndex(this->physicalDevice);
+        auto transferFamilyIndex = this->getTransferFamilyIndex(this->physicalDevice);
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies = { graphicsFamilyIndex.value(), presentFamilyIndex.value(), transferFamilyIndex.value() };
@@ -381,18 +1508,30 @@ private:
             queueCreateInfos.push_back(queueCreateInfo);
         }
         VkPhysicalDeviceFeatures deviceFeatures{};
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VkStructureType::VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12Features.timelineSemaphore = VK_TRUE;
+        VkPhysicalDeviceVulkan12Features supportedFeatures = this->getVulkan12Features(this->physicalDevice);
+        // optional, PipelineManager falls back to vkCmdDrawIndirect without it
+        this->drawIndirectCountSupported = supportedFeatures.drawIndirectCount == VK_TRUE;
+        vulkan12Features.drawIndirectCount = supportedFeatures.drawIndirectCount;
+        // optional, the upload ring's transfers go untimed in traces without it
+        this->hostQueryResetSupported = supportedFeatures.hostQueryReset == VK_TRUE;
+        vulkan12Features.hostQueryReset = supportedFeatures.hostQueryReset;
 
         VkDeviceCreateInfo vkDeviceCreateInfo{};
         vkDeviceCreateInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        vkDeviceCreateInfo.pNext = &vulkan12Features;
         vkDeviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
         vkDeviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());;
 
         vkDeviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
-        vkDeviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        vkDeviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        const std::vector<const char*>& requiredExtensions = this->getRequiredDeviceExtensions();
+        vkDeviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(requiredExtensions.size());
+        vkDeviceCreateInfo.ppEnabledExtensionNames = requiredExtensions.data();
 
-        if (enableValidationLayers) {
+        if (this->enableValidationLayers) {
             vkDeviceCreateInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
             vkDeviceCreateInfo.ppEnabledLayerNames = validationLayers.data();
         }
@@ -418,20 +1557,11 @@ private:
         std::cout << "\n\n\nPhysical devices:\n";
 
         VkPhysicalDeviceProperties deviceProperties;
-        VkPhysicalDeviceFeatures deviceFeatures;
 
         for (const auto& device : devices) {
             vkGetPhysicalDeviceProperties(device, &deviceProperties);
-            vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 
             std::cout << '\t' << deviceProperties.deviceName << '\n';
-            //std::cout << "\t\tWide lines are ";
-            //if (deviceFeatures.wideLines) {
-            //    std::cout << "supported\n";
-            //}
-            //else {
-            //    std::cout << "not supported\n";
-            //}
             if (this->isDeviceSuitable(device)) {
                 this->physicalDevice = device;
                 break;
@@ -443,63 +1573,260 @@ private:
         }
     }
 
+    bool shouldStop() {
+        if (this->options.frameLimit > 0 && this->frameCount >= this->options.frameLimit) {
+            return true;
+        }
+        return !this->options.headless && glfwWindowShouldClose(this->window);
+    }
+
     void mainLoop() {
-        while (!glfwWindowShouldClose(this->window)) {
-            glfwPollEvents();
+        this->lastCounterLine = std::chrono::steady_clock::now();
+        while (!this->shouldStop()) {
+            this->framePacer->limitFrameRate();
+            auto frameStart = std::chrono::steady_clock::now();
+            if (!this->options.headless) {
+                glfwPollEvents();
+            }
+            else {
+                // without a window every frame counts as having input at its start, which measures the CPU side
+                this->framePacer->onInput();
+            }
             this->drawFrame();
+            if (this->isMeasuring()) {
+                std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+                this->cpuFrameTimes.addSample(frameTime.count());
+            }
+            if (Counters::isEnabled()) {
+                this->updateCounters();
+            }
+            this->frameCount++;
         }
         vkDeviceWaitIdle(this->device);
+
+        if (this->options.frameLimit > 0) {
+            for (uint32_t frameIndex = 0; frameIndex < this->framesInFlight; frameIndex++) {
+                this->collectGpuFrameTime(frameIndex);
+            }
+            this->cpuFrameTimes.report(std::cout, "ms");
+            if (this->profiler->hasGpuTimestamps()) {
+                this->gpuFrameTimes.report(std::cout, "ms");
+            }
+            this->allocator->printStats(std::cout);
+        }
+        this->framePacer->report(std::cout);
+        if (Counters::isEnabled()) {
+            this->counterStats.writeJson(this->options.statsPath);
+        }
     }
 
+    // Every task checks for its subsystem itself, so the graph stays the same when they come and go. The scene's
+    // upload feeds the culling dispatch and the simulation moves the scene first; the poses feed the collisions,
+    // whose lines are drawn, and the wide segments; recording comes last.
+    void createFrameGraph() {
+        this->frameGraph = new FrameGraph();
+        Task* simulation = this->frameGraph->add([this] {
+            if (this->simulation) {
+                this->updateSimulatedFigures();
+            }
+        });
+        Task* cullingInput = this->frameGraph->add([this] {
+            if (this->figureCuller) {
+                this->figureScene.flush(this->pipelineManager->getUploadRing(), this->figureCuller->getFigureBuffer());
+            }
+        });
+        cullingInput->dependsOn(*simulation);
+        Task* poses = this->frameGraph->add([this] {
+            if (this->figureAnimator) {
+                this->poseFigures();
+            }
+        });
+        Task* collisions = this->frameGraph->add([this] {
+            if (this->debugLines) {
+                this->collideFigures(this->posedFigures, this->figureAnimator->getFigureCount());
+            }
+        });
+        collisions->dependsOn(*poses);
+        Task* segments = this->frameGraph->add([this] {
+            if (this->segmentBatcher) {
+                this->segmentBatcher->begin((uint32_t)this->currentFrame);
+                this->segmentBatcher->addFigures(this->posedFigures, this->figureAnimator->getFigureCount(), this->limbWidth);
+            }
+        });
+        segments->dependsOn(*poses);
+        Task* recording = this->frameGraph->add([this] {
+            this->recordFrameCommands((uint32_t)this->currentFrame, this->frameImageIndex);
+        });
+        recording->dependsOn(*cullingInput);
+        recording->dependsOn(*collisions);
+        recording->dependsOn(*segments);
+    }
+    void poseFigures() {
+        CpuScope poseScope(this->profiler, this->poseScope);
+        std::chrono::duration<double> animationTime = std::chrono::steady_clock::now() - this->animationStart;
+        this->figureAnimator->animate(animationTime.count());
+        if (this->debugLines || this->segmentBatcher) {
+            this->posedFigures = this->figureAnimator->evaluateToHost((uint32_t)this->currentFrame);
+        }
+        else {
+            this->figureAnimator->evaluate((uint32_t)this->currentFrame);
+        }
+    }
+    // Collides the animated figures and puts the world and the contacts on the frame's debug lines.
+    void collideFigures(const AnimatedFigureInstance* figures, uint32_t figureCount) {
+        CpuScope collisionScope(this->profiler, this->collisionScope);
+        this->figureCollider.findPairs(figures, figureCount);
+        this->figureCollider.findContacts(figures, figureCount);
+        this->debugLines->begin((uint32_t)this->currentFrame);
+        this->debugLines->addWorld(this->figureCollider.getWorld(), 0xFF808080);
+        this->debugLines->addContacts(this->figureCollider.getContacts(), 0xFF0000FF);
+    }
+    // Moves the simulated figures to where the simulation was one tick ago, blended between its last two ticks.
+    void updateSimulatedFigures() {
+        CpuScope interpolationScope(this->profiler, this->interpolationScope);
+        uint32_t entityCount = this->simulation->getEntityCount();
+        this->interpolatedX.resize(entityCount);
+        this->interpolatedY.resize(entityCount);
+        if (this->simulation->interpolate(std::chrono::steady_clock::now(), this->interpolatedX.data(), this->interpolatedY.data()) == 0) {
+            return;
+        }
+        for (FigureId figure = 0; figure < entityCount; figure++) {
+            this->figureScene.setPosition(figure, this->interpolatedX[figure], this->interpolatedY[figure]);
+        }
+    }
+    // Merges this frame's counters and once a second prints their per-frame means, in the window title as well.
+    void updateCounters() {
+        this->counterStats.endFrame();
+        auto now = std::chrono::steady_clock::now();
+        if (now - this->lastCounterLine < std::chrono::seconds(1)) {
+            return;
+        }
+        this->lastCounterLine = now;
+        std::string line = this->counterStats.takeIntervalLine();
+        std::cout << line << "\n";
+        if (!this->options.headless) {
+            glfwSetWindowTitle(this->window, ("Vulkan - " + line).c_str());
+        }
+    }
+    void waitForFence(VkFence fence) {
+        if (!Counters::isEnabled()) {
+            vkWaitForFences(this->device, 1, &fence, VK_TRUE, UINT64_MAX);
+            return;
+        }
+        auto waitStart = std::chrono::steady_clock::now();
+        vkWaitForFences(this->device, 1, &fence, VK_TRUE, UINT64_MAX);
+        Counters::add(Counter::FenceWaits);
+        Counters::add(Counter::FenceWaitMicroseconds, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - waitStart).count());
+    }
     void drawFrame() {
-        vkWaitForFences(this->device, 1, &this->inFlightFences[this->currentFrame], VK_TRUE, UINT64_MAX);
+        CpuScope scope(this->profiler, this->drawFrameScope);
+        this->framePacer->beginFrame((uint32_t)this->currentFrame);
+        this->waitForFence(this->inFlightFences[this->currentFrame]);
+        this->collectGpuFrameTime((uint32_t)this->currentFrame);
+        FrameArena* frameArena = this->frameArenas[this->currentFrame];
+        frameArena->reset();
+        this->pipelineManager->getUploadRing()->setTransientMemory(frameArena);
 
         uint32_t imageIndex;
-        VkResult result = vkAcquireNextImageKHR(this->device, this->swapChain, UINT64_MAX, this->imageAvailableSemaphores[this->currentFrame], VK_NULL_HANDLE, &imageIndex);
-        if (result == VkResult::VK_ERROR_OUT_OF_DATE_KHR || result == VkResult::VK_SUBOPTIMAL_KHR) {
-            this->recreateSwapChain();
-            return;
+        VkResult result;
+        if (this->options.headless) {
+            imageIndex = (uint32_t)(this->frameCount % this->swapChainImages.size());
         }
-        else if (result != VkResult::VK_SUCCESS) {
-            throw std::runtime_error("failed to acquire swap chain image!");
+        else {
+            result = vkAcquireNextImageKHR(this->device, this->swapChain, UINT64_MAX, this->imageAvailableSemaphores[this->currentFrame], VK_NULL_HANDLE, &imageIndex);
+            if (result == VkResult::VK_ERROR_OUT_OF_DATE_KHR || result == VkResult::VK_SUBOPTIMAL_KHR) {
+                this->framePacer->cancelFrame((uint32_t)this->currentFrame);
+                this->recreateSwapChain();
+                return;
+            }
+            else if (result != VkResult::VK_SUCCESS) {
+                throw std::runtime_error("failed to acquire swap chain image!");
+            }
         }
 
         if (this->imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-            vkWaitForFences(device, 1, &this->imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+            this->waitForFence(this->imagesInFlight[imageIndex]);
         }
         this->imagesInFlight[imageIndex] = this->inFlightFences[this->currentFrame];
+        if (this->shaderWatcher) {
+            std::vector<std::string> compiledShaders = this->shaderWatcher->takeCompiledShaders();
+            this->pipelineManager->rebuildPipelinesUsing(compiledShaders.size(), compiledShaders.data());
+        }
+        // a frame is submitted after every call, which the retirement of swapped out pipelines relies on
+        size_t swappedPipelines = this->pipelineManager->swapRebuiltPipelines(this->framesInFlight);
+        if (swappedPipelines > 0) {
+            std::cout << "swapped in " << swappedPipelines << " rebuilt pipelines\n";
+        }
+        this->frameImageIndex = imageIndex;
+        this->frameGraph->run(this->threadPool);
+
+        // uploads made since the last frame go to the transfer queue now; the frame waits for them on the GPU
+        UploadSubmission uploads = this->pipelineManager->submitUploads();
 
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        VkSemaphore waitSemaphores[] = { this->imageAvailableSemaphores[this->currentFrame] };
-        VkPipelineStageFlags waitStages[] = { VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        submitInfo.waitSemaphoreCount = 1;
+        VkSemaphore waitSemaphores[2];
+        uint64_t waitValues[2];
+        VkPipelineStageFlags waitStages[2];
+        uint32_t waitCount = 0;
+        if (!this->options.headless) {
+            waitSemaphores[waitCount] = this->imageAvailableSemaphores[this->currentFrame];
+            waitValues[waitCount] = 0;
+            waitStages[waitCount++] = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        }
+        if (uploads.waitValue > 0) {
+            waitSemaphores[waitCount] = uploads.timeline;
+            waitValues[waitCount] = uploads.waitValue;
+            waitStages[waitCount++] = UploadRing::CONSUMER_STAGES;
+        }
+        submitInfo.waitSemaphoreCount = waitCount;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &this->commandBuffers[imageIndex];
 
-        VkSemaphore signalSemaphores[] = { this->renderFinishedSemaphores[this->currentFrame] };
-        submitInfo.signalSemaphoreCount = 1;
+        VkCommandBuffer submitCommandBuffers[] = { uploads.acquireCommands, this->commandBuffers[this->currentFrame] };
+        bool acquiring = uploads.acquireCommands != VK_NULL_HANDLE;
+        submitInfo.commandBufferCount = acquiring ? 2 : 1;
+        submitInfo.pCommandBuffers = acquiring ? submitCommandBuffers : &submitCommandBuffers[1];
+
+        // the binary renderFinished value is ignored, the timeline one tells the upload ring when this frame is done
+        VkSemaphore signalSemaphores[] = { uploads.timeline, this->renderFinishedSemaphores[this->currentFrame] };
+        uint64_t signalValues[] = { uploads.signalValue, 0 };
+        submitInfo.signalSemaphoreCount = this->options.headless ? 1 : 2;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+        timelineInfo.pWaitSemaphoreValues = waitValues;
+        timelineInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount;
+        timelineInfo.pSignalSemaphoreValues = signalValues;
+        submitInfo.pNext = &timelineInfo;
+
         vkResetFences(this->device, 1, &this->inFlightFences[this->currentFrame]);
 
         if (vkQueueSubmit(this->graphicsQueue, 1, &submitInfo, this->inFlightFences[this->currentFrame]) != VkResult::VK_SUCCESS) {
             throw std::runtime_error("failed to submit draw command buffer!");
         }
+        this->profiler->markSubmitted((uint32_t)this->currentFrame);
+
+        if (this->options.headless) {
+            this->framePacer->presented((uint32_t)this->currentFrame);
+            this->currentFrame = (this->currentFrame + 1) % this->framesInFlight;
+            return;
+        }
 
         VkPresentInfoKHR presentInfo{};
         presentInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores;
+        presentInfo.pWaitSemaphores = &this->renderFinishedSemaphores[this->currentFrame];
         VkSwapchainKHR swapChains[] = { this->swapChain };
         presentInfo.swapchainCount = 1;
         presentInfo.pSwapchains = swapChains;
         presentInfo.pImageIndices = &imageIndex;
         presentInfo.pResults = nullptr; // Optional
         result = vkQueuePresentKHR(this->presentQueue, &presentInfo);
+        this->framePacer->presented((uint32_t)this->currentFrame);
         if (result == VkResult::VK_ERROR_OUT_OF_DATE_KHR || result == VkResult::VK_SUBOPTIMAL_KHR || this->framebufferResized) {
             this->framebufferResized = false;
             this->recreateSwapChain();
@@ -507,38 +1834,69 @@ private:
         else if (result != VkResult::VK_SUCCESS) {
             throw std::runtime_error("failed to present swap chain image!");
         }
-        this->currentFrame = (this->currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        this->currentFrame = (this->currentFrame + 1) % this->framesInFlight;
     }
 
     void cleanup() {
         this->cleanupSwapChain();
+        if (!this->options.headless) {
+            vkDestroySwapchainKHR(this->device, this->swapChain, nullptr);
+        }
+        delete this->shaderWatcher;
+        delete this->simulation;
+        delete this->figureCuller;
+        delete this->figureAnimator;
+        delete this->debugLines;
+        delete this->segmentBatcher;
+        delete this->pipelineManager;
+        vkDestroyRenderPass(this->device, this->renderPass, nullptr);
 
 
-
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < this->framesInFlight; i++) {
             vkDestroySemaphore(this->device, this->renderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(this->device, this->imageAvailableSemaphores[i], nullptr);
             vkDestroyFence(this->device, this->inFlightFences[i], nullptr);
         }
+        for (FrameArena* frameArena : this->frameArenas) {
+            delete frameArena;
+        }
 
-        vkDestroyCommandPool(this->device, this->graphicsCommandPool, nullptr);
+        this->pipelineCache->save();
+        delete this->pipelineCache;
+
+        if (!this->options.tracePath.empty()) {
+            this->profiler->writeChromeTrace(this->options.tracePath);
+        }
+        delete this->profiler;
+        for (auto commandPool : this->frameCommandPools) {
+            vkDestroyCommandPool(this->device, commandPool, nullptr);
+        }
+        delete this->commandRecorder;
+
+        delete this->allocator;
 
         vkDestroyDevice(this->device, nullptr);
 
-        if (enableValidationLayers) {
+        if (this->enableValidationLayers) {
             DestroyDebugUtilsMessengerEXT(this->instance, this->debugMessenger, nullptr);
         }
 
-        vkDestroySurfaceKHR(this->instance, this->surface, nullptr);
+        if (this->surface != VK_NULL_HANDLE) {
+            vkDestroySurfaceKHR(this->instance, this->surface, nullptr);
+        }
         vkDestroyInstance(this->instance, nullptr);
+        delete this->frameGraph;
+        delete this->threadPool;
+        delete this->framePacer;
 
-        glfwDestroyWindow(this->window);
-
-        glfwTerminate();
+        if (this->window != nullptr) {
+            glfwDestroyWindow(this->window);
+            glfwTerminate();
+        }
     }
     void createInstance() {
 
-        if (enableValidationLayers && !this->checkValidationLayerSupport()) {
+        if (this->enableValidationLayers && !this->checkValidationLayerSupport()) {
             throw std::runtime_error("validation layers requested, but not available!");
         }
 
@@ -554,7 +1912,7 @@ private:
         vkInstanceCreateInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
         vkInstanceCreateInfo.pApplicationInfo = &appInfo;
         VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
-        if (enableValidationLayers) {
+        if (this->enableValidationLayers) {
             vkInstanceCreateInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
             vkInstanceCreateInfo.ppEnabledLayerNames = validationLayers.data();
 
@@ -632,13 +1990,16 @@ private:
         return true;
     }
     std::vector<const char*> getRequiredExtensions() {
-        uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        std::vector<const char*> extensions;
 
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        if (!this->options.headless) {
+            uint32_t glfwExtensionCount = 0;
+            const char** glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
-        if (enableValidationLayers) {
+        if (this->enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
         }
 
@@ -655,7 +2016,7 @@ private:
         return VK_FALSE;
     }
     void setupDebugMessenger() {
-        if (!enableValidationLayers) return;
+        if (!this->enableValidationLayers) return;
 
         VkDebugUtilsMessengerCreateInfoEXT createInfo{};
         this->populateDebugMessengerCreateInfo(createInfo);
@@ -679,19 +2040,46 @@ private:
         
         auto graphicsFamilyIndex = this->getFamilyIndex(device, &isGraphicsFamily);
 
-        auto presentFamilyIndex = this->getFamilyIndex(device, &isPresentFamily);
+        auto presentFamilyIndex = this->getPresentFamilyIndex(device);
 
-        auto transferFamilyIndex = this->getFamilyIndex(device, &isTransferFamily);
+        auto transferFamilyIndex = this->getTransferFamilyIndex(device);
 
         auto extensionsSupported = this->checkDeviceExtensionSupport(device);
 
         bool swapChainAdequate = false;
-        if (extensionsSupported) {
+        if (extensionsSupported && this->options.headless) {
+            swapChainAdequate = true;
+        }
+        else if (extensionsSupported) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
         }
 
-        return graphicsFamilyIndex.has_value() && presentFamilyIndex.has_value() && transferFamilyIndex.has_value() && swapChainAdequate;
+        return graphicsFamilyIndex.has_value() && presentFamilyIndex.has_value() && transferFamilyIndex.has_value() && swapChainAdequate && this->checkTimelineSemaphoreSupport(device);
+    }
+    VkPhysicalDeviceVulkan12Features getVulkan12Features(VkPhysicalDevice device) {
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VkStructureType::VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VkStructureType::VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &vulkan12Features;
+        vkGetPhysicalDeviceFeatures2(device, &features);
+        vulkan12Features.pNext = nullptr;
+        return vulkan12Features;
+    }
+    bool checkTimelineSemaphoreSupport(VkPhysicalDevice device) {
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+        if (deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+            return false;
+        }
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VkStructureType::VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VkStructureType::VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &vulkan12Features;
+        vkGetPhysicalDeviceFeatures2(device, &features);
+        return vulkan12Features.timelineSemaphore == VK_TRUE;
     }
 
     std::optional<uint32_t> getFamilyIndex(VkPhysicalDevice device, bool(*checker)(VkQueueFamilyProperties, uint32_t, VkPhysicalDevice, VkSurfaceKHR)) {
@@ -713,6 +2101,27 @@ private:
         }
         return familyIndex;
     }
+    // Without a surface there is nothing to present to, so presentation happens on the graphics queue by definition.
+    std::optional<uint32_t> getPresentFamilyIndex(VkPhysicalDevice device) {
+        if (this->options.headless) {
+            return this->getFamilyIndex(device, &isGraphicsFamily);
+        }
+        return this->getFamilyIndex(device, &isPresentFamily);
+    }
+    // Software drivers such as lavapipe expose a single queue family, so uploads fall back to the graphics family.
+    std::optional<uint32_t> getTransferFamilyIndex(VkPhysicalDevice device) {
+        auto transferFamilyIndex = this->getFamilyIndex(device, &isTransferFamily);
+        if (transferFamilyIndex.has_value()) {
+            return transferFamilyIndex;
+        }
+        return this->getFamilyIndex(device, &isGraphicsFamily);
+    }
+    const std::vector<const char*>& getRequiredDeviceExtensions() {
+        if (this->options.headless) {
+            return headlessDeviceExtensions;
+        }
+        return deviceExtensions;
+    }
     bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
         uint32_t extensionCount;
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -720,6 +2129,7 @@ private:
         std::vector<VkExtensionProperties> availableExtensions(extensionCount);
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
+        const std::vector<const char*>& deviceExtensions = this->getRequiredDeviceExtensions();
         std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
         for (const auto& extension : availableExtensions) {
@@ -760,13 +2170,7 @@ private:
         return availableFormats[0];
     }
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-        for (const auto& availablePresentMode : availablePresentModes) {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                return availablePresentMode;
-            }
-        }
-
-        return VK_PRESENT_MODE_FIFO_KHR;
+        return this->framePacer->choosePresentMode(availablePresentModes);
     }
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
         if (capabilities.currentExtent.width != UINT32_MAX) {
@@ -787,7 +2191,10 @@ private:
             return actualExtent;
         }
     }
+    // Pipelines take viewport and scissor as dynamic state, so a resize only rebuilds what depends on the images.
+    // The render pass and pipelines are rebuilt only if the surface format changed as well.
     void recreateSwapChain() {
+        Counters::add(Counter::SwapchainRecreations);
         int width = 0, height = 0;
         glfwGetFramebufferSize(this->window, &width, &height);
         while (width == 0 || height == 0) {
@@ -796,32 +2203,50 @@ private:
         }
         vkDeviceWaitIdle(this->device);
         this->cleanupSwapChain();
+
+        VkSwapchainKHR oldSwapChain = this->swapChain;
+        VkFormat oldImageFormat = this->swapChainImageFormat;
         this->createSwapChain();
+        vkDestroySwapchainKHR(this->device, oldSwapChain, nullptr);
+
         this->createImageViews();
-        this->createRenderPass();
-        this->createGraphicsPipeline();
+        if (this->swapChainImageFormat != oldImageFormat) {
+            delete this->figureCuller;
+            this->figureCuller = nullptr;
+            delete this->figureAnimator;
+            this->figureAnimator = nullptr;
+            delete this->debugLines;
+            this->debugLines = nullptr;
+            delete this->segmentBatcher;
+            this->segmentBatcher = nullptr;
+            delete this->pipelineManager;
+            vkDestroyRenderPass(this->device, this->renderPass, nullptr);
+            this->createRenderPass();
+            this->createGraphicsPipeline();
+        }
         this->createFramebuffers();
-        this->createCommandBuffers();
+        this->imagesInFlight.assign(this->swapChainImages.size(), VK_NULL_HANDLE);
     }
     void cleanupSwapChain() {
         for (auto framebuffer : this->swapChainFramebuffers) {
             vkDestroyFramebuffer(this->device, framebuffer, nullptr);
         }
-        vkFreeCommandBuffers(this->device, this->graphicsCommandPool, static_cast<uint32_t>(this->commandBuffers.size()), this->commandBuffers.data());
-        delete this->pipelineManager;
-        vkDestroyRenderPass(this->device, this->renderPass, nullptr);
 
         for (auto imageView : this->swapChainImageViews) {
             vkDestroyImageView(this->device, imageView, nullptr);
         }
-        vkDestroySwapchainKHR(this->device, this->swapChain, nullptr);
+        if (this->options.headless) {
+            for (size_t i = 0; i < this->swapChainImages.size(); i++) {
+                vkDestroyImage(this->device, this->swapChainImages[i], nullptr);
+                this->allocator->free(this->offscreenImageMemories[i]);
+            }
+        }
     }
 };
 
-int main() {
-    HelloTriangleApplication app;
-
+int main(int argc, char** argv) {
     try {
+        HelloTriangleApplication app(parseOptions(argc, argv));
         app.run();
     }
     catch (const std::exception& e) {
@@ -2,4 +2,22 @@ Get-ChildItem "$($PSScriptRoot)\shaders" |
 Foreach-Object { 
     Write-Output($_.Name)
     Start-Process -Wait -NoNewWindow -FilePath "C:\VulkanSDK\1.2.189.2\Bin\glslc.exe" -ArgumentList "$($_.FullName) -o $($PSScriptRoot)\compiled_shaders\$($_.Name).spv" 
-}
\ No newline at end of file
+}
+# Same header tools/EmbedShaders writes for the Makefile, ShaderCode picks it up unless SHADER_DEV_MODE is defined
+$lines = @("// Generated by shaders.ps1 from the compiled SPIR-V, do not edit.", "#pragma once")
+$entries = @()
+Get-ChildItem "$($PSScriptRoot)\shaders" |
+Foreach-Object {
+    $path = "compiled_shaders/$($_.Name).spv"
+    $symbol = $path -replace '[^A-Za-z0-9]', '_'
+    $bytes = [System.IO.File]::ReadAllBytes("$($PSScriptRoot)\compiled_shaders\$($_.Name).spv")
+    $words = for ($i = 0; $i -lt $bytes.Length; $i += 4) { "0x{0:x8}u," -f [System.BitConverter]::ToUInt32($bytes, $i) }
+    $lines += "constexpr uint32_t $($symbol)[] = {"
+    $lines += "    " + ($words -join " ")
+    $lines += "};"
+    $entries += "    { `"$path`", $symbol, sizeof($symbol) },"
+}
+$lines += "constexpr EmbeddedShader EMBEDDED_SHADERS[] = {"
+$lines += $entries
+$lines += "};"
+Set-Content -Path "$($PSScriptRoot)\compiled_shaders\EmbeddedShaders.h" -Value $lines
\ No newline at end of file
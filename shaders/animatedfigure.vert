@@ -0,0 +1,34 @@
+#version 450
+#define M_PI 3.1415926535897932384626433832795
+// two joints per attribute, already on screen
+layout(location = 0) in vec4 joints01;
+layout(location = 1) in vec4 joints23;
+layout(location = 2) in vec4 joints45;
+layout(location = 3) in vec4 joints67;
+layout(location = 4) in vec4 joints89;
+layout(location = 5) in float headRadius;
+layout(location = 6) in vec4 figureColor;
+layout(location = 0) out vec3 fragColor;
+
+// keep in sync with AnimatedFigureVertexInput.h and PoseKernel.h
+const int HEAD_SEGMENTS = 12;
+// start and end joint of every bone as line list endpoints
+const int BONE_JOINTS[18] = int[](0, 1, 1, 2, 2, 3, 1, 4, 4, 5, 0, 6, 6, 7, 0, 8, 8, 9);
+
+void main() {
+    vec2 joints[10] = vec2[](joints01.xy, joints01.zw, joints23.xy, joints23.zw, joints45.xy, joints45.zw,
+        joints67.xy, joints67.zw, joints89.xy, joints89.zw);
+    vec2 point;
+    if (gl_VertexIndex < HEAD_SEGMENTS * 2) {
+        // segment i of the head runs from circle point i to point i + 1, the head sits on the neck in line with the spine
+        int pointIndex = (gl_VertexIndex + 1) / 2;
+        float angle = (pointIndex / float(HEAD_SEGMENTS)) * 2 * M_PI;
+        vec2 headCenter = joints[1] + normalize(joints[1] - joints[0]) * headRadius;
+        point = headCenter + headRadius * vec2(cos(angle), sin(angle));
+    }
+    else {
+        point = joints[BONE_JOINTS[gl_VertexIndex - HEAD_SEGMENTS * 2]];
+    }
+    gl_Position = vec4(point, 0, 1);
+    fragColor = figureColor.rgb;
+}
\ No newline at end of file
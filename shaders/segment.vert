@@ -0,0 +1,31 @@
+#version 450
+// keep in sync with SegmentVertexInput.h
+layout(location = 0) in vec4 endpoints;
+layout(location = 1) in float width;
+layout(location = 2) in vec4 color;
+layout(location = 0) out vec3 fragColor;
+// set by PipelineManager::writeCommands, see ViewportConstants
+layout(push_constant) uniform Viewport {
+    vec2 pixelSize;
+} viewport;
+
+// corners of the quad as (along, across): along runs from the start (0) to the end (1), across from one side (-1)
+// to the other (1)
+const vec2 CORNERS[6] = vec2[](vec2(0, -1), vec2(1, -1), vec2(1, 1), vec2(0, -1), vec2(1, 1), vec2(0, 1));
+
+void main() {
+    vec2 corner = CORNERS[gl_VertexIndex];
+    vec2 start = endpoints.xy;
+    vec2 end = endpoints.zw;
+    // in pixels, so the width is the same whatever the direction and the aspect ratio
+    vec2 direction = (end - start) / viewport.pixelSize;
+    float pixelLength = length(direction);
+    vec2 along = pixelLength > 0.0 ? direction / pixelLength : vec2(1, 0);
+    vec2 across = vec2(-along.y, along.x);
+    // the ends reach half the width past the endpoints, so limbs meeting at a joint leave no notch, and a segment of
+    // length 0 is a square dot
+    float halfWidth = 0.5 * width;
+    vec2 offset = (across * corner.y + along * (corner.x * 2.0 - 1.0)) * halfWidth;
+    gl_Position = vec4(mix(start, end, corner.x) + offset * viewport.pixelSize, 0, 1);
+    fragColor = color.rgb;
+}
\ No newline at end of file
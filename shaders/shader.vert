@@ -3,6 +3,8 @@
 #define M_PI 3.1415926535897932384626433832795
 layout(location = 0) in int vertexCount;
 layout(location = 0) out vec3 fragColor;
+// 0xRRGGBB, set per pipeline through PipelineCreateInfo::specializationConstants
+layout(constant_id = 0) const uint COLOR = 0xFF0000;
 
 void main() {
     const float radius = 0.3;
@@ -11,5 +13,5 @@ void main() {
     float YOffset = radius * sin(currentAngle);
     float XOffset = radius * cos(currentAngle);
     gl_Position = vec4(XOffset, -YOffset, 0, 1);
-    fragColor = vec3(1.0, 0.0, 0.0);
+    fragColor = vec3((COLOR >> 16) & 0xFF, (COLOR >> 8) & 0xFF, COLOR & 0xFF) / 255.0;
 }
\ No newline at end of file
@@ -0,0 +1,42 @@
+#version 450
+#define M_PI 3.1415926535897932384626433832795
+layout(location = 0) in vec2 figurePosition;
+layout(location = 1) in float figureScale;
+layout(location = 2) in uint figurePose;
+layout(location = 3) in vec4 figureColor;
+layout(location = 0) out vec3 fragColor;
+
+// keep in sync with StickFigureVertexInput.h
+const int HEAD_SEGMENTS = 12;
+const float HEAD_RADIUS = 0.25;
+const int JOINTS_PER_POSE = 6;
+// neck, hip, left hand, right hand, left foot, right foot; y points down, the head is above the neck
+const vec2 POSES[4 * JOINTS_PER_POSE] = vec2[](
+    // standing
+    vec2(0.0, -0.5), vec2(0.0, 0.3), vec2(-0.4, 0.1), vec2(0.4, 0.1), vec2(-0.25, 1.0), vec2(0.25, 1.0),
+    // walking, left foot forward
+    vec2(0.0, -0.5), vec2(0.0, 0.3), vec2(-0.35, 0.2), vec2(0.3, -0.05), vec2(-0.4, 1.0), vec2(0.35, 0.95),
+    // walking, right foot forward
+    vec2(0.0, -0.5), vec2(0.0, 0.3), vec2(-0.3, -0.05), vec2(0.35, 0.2), vec2(-0.35, 0.95), vec2(0.4, 1.0),
+    // jumping
+    vec2(0.0, -0.5), vec2(0.0, 0.3), vec2(-0.45, -0.9), vec2(0.45, -0.9), vec2(-0.35, 0.85), vec2(0.35, 0.85)
+);
+// body, left arm, right arm, left leg, right leg as line list endpoints
+const int LIMB_JOINTS[10] = int[](0, 1, 0, 2, 0, 3, 1, 4, 1, 5);
+
+void main() {
+    int poseBase = int(figurePose) * JOINTS_PER_POSE;
+    vec2 point;
+    if (gl_VertexIndex < HEAD_SEGMENTS * 2) {
+        // segment i of the head runs from circle point i to point i + 1
+        int pointIndex = (gl_VertexIndex + 1) / 2;
+        float angle = (pointIndex / float(HEAD_SEGMENTS)) * 2 * M_PI;
+        vec2 headCenter = POSES[poseBase] - vec2(0.0, HEAD_RADIUS);
+        point = headCenter + HEAD_RADIUS * vec2(cos(angle), sin(angle));
+    }
+    else {
+        point = POSES[poseBase + LIMB_JOINTS[gl_VertexIndex - HEAD_SEGMENTS * 2]];
+    }
+    gl_Position = vec4(figurePosition + point * figureScale, 0, 1);
+    fragColor = figureColor.rgb;
+}
\ No newline at end of file
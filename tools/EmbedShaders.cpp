@@ -0,0 +1,70 @@
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Writes compiled SPIR-V files into a header of constexpr word arrays plus an EMBEDDED_SHADERS table that ShaderCode
+// looks paths up in. The paths are stored exactly as given, so pass them the way the pipelines name them.
+// usage: EmbedShaders <header> <file.spv>...
+static std::string toSymbol(const std::string& path)
+{
+    std::string symbol = path;
+    for (char& c : symbol) {
+        bool alphanumeric = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        if (!alphanumeric) {
+            c = '_';
+        }
+    }
+    return symbol;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <header> <file.spv>...\n";
+        return 1;
+    }
+    std::ofstream header(argv[1], std::ios::trunc);
+    if (!header.is_open()) {
+        std::cerr << "failed to open " << argv[1] << "\n";
+        return 1;
+    }
+    header << "// Generated by tools/EmbedShaders from the compiled SPIR-V, do not edit.\n";
+    header << "#pragma once\n";
+
+    std::vector<std::string> paths;
+    for (int argIndex = 2; argIndex < argc; argIndex++) {
+        std::string path = argv[argIndex];
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "failed to open " << path << "\n";
+            return 1;
+        }
+        size_t fileSize = (size_t)file.tellg();
+        if (fileSize == 0 || fileSize % sizeof(uint32_t) != 0) {
+            std::cerr << path << " is not SPIR-V\n";
+            return 1;
+        }
+        std::vector<uint32_t> words(fileSize / sizeof(uint32_t));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(words.data()), fileSize);
+
+        header << "constexpr uint32_t " << toSymbol(path) << "[] = {";
+        char word[16];
+        for (size_t wordIndex = 0; wordIndex < words.size(); wordIndex++) {
+            snprintf(word, sizeof(word), "0x%08xu,", words[wordIndex]);
+            header << (wordIndex % 8 == 0 ? "\n    " : " ") << word;
+        }
+        header << "\n};\n";
+        paths.push_back(path);
+    }
+
+    header << "constexpr EmbeddedShader EMBEDDED_SHADERS[] = {\n";
+    for (const std::string& path : paths) {
+        header << "    { \"" << path << "\", " << toSymbol(path) << ", sizeof(" << toSymbol(path) << ") },\n";
+    }
+    header << "};\n";
+    return header.good() ? 0 : 1;
+}
\ No newline at end of file